@@ -396,6 +396,35 @@ static inline bool check_for_breakpoints(CPUState *cpu, vaddr pc,
         check_for_breakpoints_slow(cpu, pc, cflags);
 }
 
+/*
+ * Count down the lookups of a quick (unoptimized) TB.  Returns true
+ * once it is time for the main loop to retranslate it.  The count stops
+ * at 1 until one vCPU claims the retranslation with tb_tier_up_claim().
+ */
+static inline bool tb_tier_up_due(TranslationBlock *tb)
+{
+    uint32_t n = qatomic_read(&tb->tier_countdown);
+
+    if (likely(n == 0)) {
+        return false;
+    }
+    if (n > 1) {
+        qatomic_set(&tb->tier_countdown, n - 1);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Several vCPUs can find the same TB due at once; only the one that
+ * clears the count invalidates and retranslates it.  The others keep
+ * running the quick TB until it is invalidated.
+ */
+static inline bool tb_tier_up_claim(TranslationBlock *tb)
+{
+    return qatomic_cmpxchg(&tb->tier_countdown, 1, 0) == 1;
+}
+
 /**
  * helper_lookup_tb_ptr: quick check for next tb
  * @env: current cpu state
@@ -420,7 +449,7 @@ const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
     }
 
     tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
-    if (tb == NULL) {
+    if (tb == NULL || unlikely(tb_tier_up_due(tb))) {
         return tcg_code_gen_epilogue;
     }
 
@@ -595,7 +624,7 @@ void cpu_exec_step_atomic(CPUState *cpu)
         tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
         if (tb == NULL) {
             mmap_lock();
-            tb = tb_gen_code(cpu, pc, cs_base, flags, cflags);
+            tb = tb_gen_code(cpu, pc, cs_base, flags, cflags, false);
             mmap_unlock();
         }
 
@@ -997,12 +1026,19 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
             }
 
             tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
-            if (tb == NULL) {
+            if (tb == NULL ||
+                unlikely(tb_tier_up_due(tb) && tb_tier_up_claim(tb))) {
                 CPUJumpCache *jc;
                 uint32_t h;
 
                 mmap_lock();
-                tb = tb_gen_code(cpu, pc, cs_base, flags, cflags);
+                if (tb) {
+                    /* Replace the quick translation with an optimized one. */
+                    tb_phys_invalidate(tb, -1);
+                    tb = tb_gen_code(cpu, pc, cs_base, flags, cflags, false);
+                } else {
+                    tb = tb_gen_code(cpu, pc, cs_base, flags, cflags, true);
+                }
                 mmap_unlock();
 
                 /*
@@ -1032,8 +1068,11 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
                 last_tb = NULL;
             }
 #endif
-            /* See if we can patch the calling TB. */
-            if (last_tb) {
+            /*
+             * See if we can patch the calling TB.  Quick TBs are only
+             * entered through a lookup, so that their lookups count.
+             */
+            if (last_tb && !qatomic_read(&tb->tier_countdown)) {
                 tb_add_jump(last_tb, tb_exit, tb);
             }
 
@@ -45,6 +45,7 @@ struct TCGState {
 
     bool mttcg_enabled;
     bool one_insn_per_tb;
+    uint32_t tb_tier_threshold;
     int splitwx_enabled;
     unsigned long tb_size;
 };
@@ -99,6 +100,7 @@ static void tcg_accel_instance_init(Object *obj)
 
 bool mttcg_enabled;
 bool one_insn_per_tb;
+unsigned tb_tier_threshold;
 
 static int tcg_init_machine(MachineState *ms)
 {
@@ -111,6 +113,7 @@ static int tcg_init_machine(MachineState *ms)
 
     tcg_allowed = true;
     mttcg_enabled = s->mttcg_enabled;
+    tb_tier_threshold = s->tb_tier_threshold;
 
     page_init();
     tb_htable_init();
@@ -181,6 +184,30 @@ static void tcg_set_tb_size(Object *obj, Visitor *v,
     s->tb_size = value;
 }
 
+static void tcg_get_tb_tier_threshold(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->tb_tier_threshold;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_tb_tier_threshold(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+
+    s->tb_tier_threshold = value;
+}
+
 static bool tcg_get_splitwx(Object *obj, Error **errp)
 {
     TCGState *s = TCG_STATE(obj);
@@ -240,6 +267,13 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
     object_class_property_set_description(oc, "tb-size",
         "TCG translation block cache size");
 
+    object_class_property_add(oc, "tb-tier-threshold", "uint32",
+        tcg_get_tb_tier_threshold, tcg_set_tb_tier_threshold,
+        NULL, NULL);
+    object_class_property_set_description(oc, "tb-tier-threshold",
+        "Translate new TBs without optimization and retranslate them "
+        "after this many lookups (0 = disabled)");
+
     object_class_property_add_bool(oc, "split-wx",
         tcg_get_splitwx, tcg_set_splitwx);
     object_class_property_set_description(oc, "split-wx",
@@ -284,9 +284,14 @@ static int setjmp_gen_code(CPUArchState *env, TranslationBlock *tb,
 }
 
 /* Called with mmap_lock held for user mode emulation.  */
+/*
+ * Translate a new TB.  If @quick and tiered translation is enabled,
+ * skip the optimizer: once it has been looked up tb_tier_threshold times,
+ * tb_tier_up_due() and tb_tier_up_claim() make the main loop retranslate it.
+ */
 TranslationBlock *tb_gen_code(CPUState *cpu,
                               vaddr pc, uint64_t cs_base,
-                              uint32_t flags, int cflags)
+                              uint32_t flags, int cflags, bool quick)
 {
     CPUArchState *env = cpu->env_ptr;
     TranslationBlock *tb, *existing_tb;
@@ -332,6 +337,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     tb->cs_base = cs_base;
     tb->flags = flags;
     tb->cflags = cflags;
+    tb->tier_countdown = quick && phys_pc != -1 ? tb_tier_threshold : 0;
     tb_set_page_addr0(tb, phys_pc);
     tb_set_page_addr1(tb, -1);
     if (phys_pc != -1) {
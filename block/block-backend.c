@@ -1389,6 +1389,89 @@ int coroutine_fn blk_co_preadv_part(BlockBackend *blk, int64_t offset,
     return ret;
 }
 
+/* To be called between exactly one pair of blk_inc/dec_in_flight() */
+static int coroutine_fn
+blk_co_do_preadv_batch(BlockBackend *blk, BdrvBatchRequest *reqs, int nb_reqs)
+{
+    g_autofree BdrvBatchRequest *valid = NULL;
+    g_autofree int *valid_idx = NULL;
+    BlockDriverState *bs;
+    int nb_valid = 0;
+    int i, j;
+    IO_CODE();
+
+    blk_wait_while_drained(blk);
+    GRAPH_RDLOCK_GUARD();
+
+    /* Call blk_bs() only after waiting, the graph may have changed */
+    bs = blk_bs(blk);
+    trace_blk_co_preadv_batch(blk, bs, nb_reqs);
+
+    for (i = 0; i < nb_reqs; i++) {
+        reqs[i].ret = blk_check_byte_request(blk, reqs[i].offset,
+                                             reqs[i].bytes);
+        if (reqs[i].ret == 0) {
+            nb_valid++;
+        }
+    }
+
+    if (nb_valid) {
+        bdrv_inc_in_flight(bs);
+
+        /* throttling disk I/O */
+        if (blk->public.throttle_group_member.throttle_state) {
+            for (i = 0; i < nb_reqs; i++) {
+                if (reqs[i].ret == 0) {
+                    throttle_group_co_io_limits_intercept(
+                        &blk->public.throttle_group_member,
+                        reqs[i].bytes, false);
+                }
+            }
+        }
+
+        if (nb_valid == nb_reqs) {
+            bdrv_co_preadv_batch(blk->root, reqs, nb_reqs);
+        } else {
+            /* Leave out the requests that failed the checks above */
+            valid = g_new(BdrvBatchRequest, nb_valid);
+            valid_idx = g_new(int, nb_valid);
+            for (i = 0, j = 0; i < nb_reqs; i++) {
+                if (reqs[i].ret == 0) {
+                    valid[j] = reqs[i];
+                    valid_idx[j++] = i;
+                }
+            }
+
+            bdrv_co_preadv_batch(blk->root, valid, nb_valid);
+            for (j = 0; j < nb_valid; j++) {
+                reqs[valid_idx[j]].ret = valid[j].ret;
+            }
+        }
+
+        bdrv_dec_in_flight(bs);
+    }
+
+    for (i = 0; i < nb_reqs; i++) {
+        if (reqs[i].ret < 0) {
+            return reqs[i].ret;
+        }
+    }
+    return 0;
+}
+
+int coroutine_fn blk_co_preadv_batch(BlockBackend *blk,
+                                     BdrvBatchRequest *reqs, int nb_reqs)
+{
+    int ret;
+    IO_OR_GS_CODE();
+
+    blk_inc_in_flight(blk);
+    ret = blk_co_do_preadv_batch(blk, reqs, nb_reqs);
+    blk_dec_in_flight(blk);
+
+    return ret;
+}
+
 /* To be called between exactly one pair of blk_inc/dec_in_flight() */
 static int coroutine_fn
 blk_co_do_pwritev_part(BlockBackend *blk, int64_t offset, int64_t bytes,
@@ -1573,14 +1656,12 @@ static void blk_aio_complete_bh(void *opaque)
     blk_aio_complete(acb);
 }
 
-static BlockAIOCB *blk_aio_prwv(BlockBackend *blk, int64_t offset,
-                                int64_t bytes,
-                                void *iobuf, CoroutineEntry co_entry,
-                                BdrvRequestFlags flags,
-                                BlockCompletionFunc *cb, void *opaque)
+static BlkAioEmAIOCB *blk_aio_em_new(BlockBackend *blk, int64_t offset,
+                                     int64_t bytes, void *iobuf,
+                                     BdrvRequestFlags flags,
+                                     BlockCompletionFunc *cb, void *opaque)
 {
     BlkAioEmAIOCB *acb;
-    Coroutine *co;
 
     blk_inc_in_flight(blk);
     acb = blk_aio_get(&blk_aio_em_aiocb_info, blk, cb, opaque);
@@ -1594,8 +1675,23 @@ static BlockAIOCB *blk_aio_prwv(BlockBackend *blk, int64_t offset,
     acb->bytes = bytes;
     acb->has_returned = false;
 
-    co = qemu_coroutine_create(co_entry, acb);
-    aio_co_enter(blk_get_aio_context(blk), co);
+    return acb;
+}
+
+/*
+ * Run @co_entry for @acb in a coroutine.  If @co_entry is NULL, the request
+ * has already completed and only its callback is left to call.
+ */
+static BlockAIOCB *blk_aio_em_submit(BlkAioEmAIOCB *acb,
+                                     CoroutineEntry co_entry)
+{
+    BlockBackend *blk = acb->rwco.blk;
+    Coroutine *co;
+
+    if (co_entry) {
+        co = qemu_coroutine_create(co_entry, acb);
+        aio_co_enter(blk_get_aio_context(blk), co);
+    }
 
     acb->has_returned = true;
     if (acb->rwco.ret != NOT_DONE) {
@@ -1606,6 +1702,18 @@ static BlockAIOCB *blk_aio_prwv(BlockBackend *blk, int64_t offset,
     return &acb->common;
 }
 
+static BlockAIOCB *blk_aio_prwv(BlockBackend *blk, int64_t offset,
+                                int64_t bytes,
+                                void *iobuf, CoroutineEntry co_entry,
+                                BdrvRequestFlags flags,
+                                BlockCompletionFunc *cb, void *opaque)
+{
+    BlkAioEmAIOCB *acb = blk_aio_em_new(blk, offset, bytes, iobuf, flags,
+                                        cb, opaque);
+
+    return blk_aio_em_submit(acb, co_entry);
+}
+
 static void coroutine_fn blk_aio_read_entry(void *opaque)
 {
     BlkAioEmAIOCB *acb = opaque;
@@ -1618,6 +1726,51 @@ static void coroutine_fn blk_aio_read_entry(void *opaque)
     blk_aio_complete(acb);
 }
 
+/*
+ * Try to complete a read without entering a coroutine.  Only requests that
+ * blk_co_do_preadv_part() would pass straight to the graph qualify, and
+ * only if the drivers can complete them immediately.
+ *
+ * Returns -EAGAIN if the request must go through blk_aio_read_entry().
+ *
+ * To be called between exactly one pair of blk_inc/dec_in_flight()
+ */
+static int blk_preadv_nowait(BlockBackend *blk, int64_t offset, int64_t bytes,
+                             QEMUIOVector *qiov, BdrvRequestFlags flags)
+{
+    BlockDriverState *bs;
+    int ret = -EAGAIN;
+
+    /*
+     * The in-flight counter was incremented before this check, so a drained
+     * section that begins afterwards waits for the request.  Graph changes
+     * only happen in drained sections, so blk_bs() stays valid from here on.
+     */
+    if (flags || qatomic_read(&blk->quiesce_counter) ||
+        blk->public.throttle_group_member.throttle_state ||
+        offset < 0 || blk_dev_is_tray_open(blk)) {
+        return -EAGAIN;
+    }
+
+    /*
+     * Most graphs never complete reads without a coroutine; do not make
+     * them pay for the graph lock on every request.
+     */
+    bs = blk_bs(blk);
+    if (!bs || !bs->drv || !bs->bl.preadv_nowait) {
+        return -EAGAIN;
+    }
+
+    if (!bdrv_graph_rdlock_nowait()) {
+        return -EAGAIN;
+    }
+    trace_blk_preadv_nowait(blk, bs, offset, bytes);
+    ret = bdrv_preadv_nowait(blk->root, offset, bytes, qiov);
+    bdrv_graph_rdunlock_nowait();
+
+    return ret;
+}
+
 static void coroutine_fn blk_aio_write_entry(void *opaque)
 {
     BlkAioEmAIOCB *acb = opaque;
@@ -1704,10 +1857,19 @@ BlockAIOCB *blk_aio_preadv(BlockBackend *blk, int64_t offset,
                            QEMUIOVector *qiov, BdrvRequestFlags flags,
                            BlockCompletionFunc *cb, void *opaque)
 {
+    BlkAioEmAIOCB *acb;
+    int ret;
     IO_CODE();
+
     assert((uint64_t)qiov->size <= INT64_MAX);
-    return blk_aio_prwv(blk, offset, qiov->size, qiov,
-                        blk_aio_read_entry, flags, cb, opaque);
+    acb = blk_aio_em_new(blk, offset, qiov->size, qiov, flags, cb, opaque);
+
+    ret = blk_preadv_nowait(blk, offset, qiov->size, qiov, flags);
+    if (ret != -EAGAIN) {
+        acb->rwco.ret = ret;
+        return blk_aio_em_submit(acb, NULL);
+    }
+    return blk_aio_em_submit(acb, blk_aio_read_entry);
 }
 
 BlockAIOCB *blk_aio_pwritev(BlockBackend *blk, int64_t offset,
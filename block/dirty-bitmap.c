@@ -33,6 +33,8 @@
 struct BdrvDirtyBitmap {
     BlockDriverState *bs;
     HBitmap *bitmap;            /* Dirty bitmap implementation */
+    HBitmap *meta;              /* Tracks changed chunks of @bitmap, owned
+                                   by @bitmap */
     bool busy;                  /* Bitmap is busy, it can't be used via QMP */
     BdrvDirtyBitmap *successor; /* Anonymous child, if any. */
     char *name;                 /* Optional non-empty unique ID */
@@ -202,6 +204,34 @@ int bdrv_dirty_bitmap_check(const BdrvDirtyBitmap *bitmap, uint32_t flags,
     return 0;
 }
 
+/*
+ * A persistent bitmap may have a stored copy that the driver considers up to
+ * date (see qcow2's bitmap-sync-interval). Guest writes invalidate it in the
+ * driver's write path; everything else that changes a persistent bitmap must
+ * call this first, so that a crash never leaves a stale copy that looks valid.
+ * Must not be called with the dirty bitmap mutex held.
+ */
+static int bdrv_dirty_bitmap_prepare_change(BdrvDirtyBitmap *bitmap,
+                                            Error **errp)
+{
+    BlockDriverState *bs = bitmap->bs;
+    int ret;
+
+    if (!bdrv_dirty_bitmap_get_persistence(bitmap) || !bs->drv ||
+        !bs->drv->bdrv_co_mark_persistent_dirty_bitmaps_in_use) {
+        return 0;
+    }
+
+    ret = bdrv_mark_persistent_dirty_bitmaps_in_use(bs);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret,
+                         "Failed to mark persistent bitmaps of '%s' in use",
+                         bdrv_get_device_or_node_name(bs));
+    }
+
+    return ret;
+}
+
 /**
  * Create a successor bitmap destined to replace this bitmap after an operation.
  * Requires that the bitmap is not marked busy and has no successor.
@@ -260,6 +290,9 @@ static void bdrv_release_dirty_bitmap_locked(BdrvDirtyBitmap *bitmap)
     assert(!bdrv_dirty_bitmap_busy(bitmap));
     assert(!bdrv_dirty_bitmap_has_successor(bitmap));
     QLIST_REMOVE(bitmap, list);
+    if (bitmap->meta) {
+        hbitmap_free_meta(bitmap->bitmap);
+    }
     hbitmap_free(bitmap->bitmap);
     g_free(bitmap->name);
     g_free(bitmap);
@@ -327,6 +360,8 @@ BdrvDirtyBitmap *bdrv_reclaim_dirty_bitmap(BdrvDirtyBitmap *parent,
 {
     BdrvDirtyBitmap *ret;
 
+    bdrv_dirty_bitmap_prepare_change(parent, &error_warn);
+
     bdrv_dirty_bitmaps_lock(parent->bs);
     ret = bdrv_reclaim_dirty_bitmap_locked(parent, errp);
     bdrv_dirty_bitmaps_unlock(parent->bs);
@@ -402,6 +437,17 @@ bdrv_co_remove_persistent_dirty_bitmap(BlockDriverState *bs, const char *name,
     return 0;
 }
 
+int coroutine_fn
+bdrv_co_mark_persistent_dirty_bitmaps_in_use(BlockDriverState *bs)
+{
+    assert_bdrv_graph_readable();
+    if (bs->drv && bs->drv->bdrv_co_mark_persistent_dirty_bitmaps_in_use) {
+        return bs->drv->bdrv_co_mark_persistent_dirty_bitmaps_in_use(bs);
+    }
+
+    return 0;
+}
+
 bool
 bdrv_supports_persistent_dirty_bitmap(BlockDriverState *bs)
 {
@@ -437,6 +483,8 @@ bdrv_co_can_store_new_dirty_bitmap(BlockDriverState *bs, const char *name,
 
 void bdrv_disable_dirty_bitmap(BdrvDirtyBitmap *bitmap)
 {
+    bdrv_dirty_bitmap_prepare_change(bitmap, &error_warn);
+
     bdrv_dirty_bitmaps_lock(bitmap->bs);
     bitmap->disabled = true;
     bdrv_dirty_bitmaps_unlock(bitmap->bs);
@@ -444,6 +492,8 @@ void bdrv_disable_dirty_bitmap(BdrvDirtyBitmap *bitmap)
 
 void bdrv_enable_dirty_bitmap(BdrvDirtyBitmap *bitmap)
 {
+    bdrv_dirty_bitmap_prepare_change(bitmap, &error_warn);
+
     bdrv_dirty_bitmaps_lock(bitmap->bs);
     bdrv_enable_dirty_bitmap_locked(bitmap);
     bdrv_dirty_bitmaps_unlock(bitmap->bs);
@@ -550,6 +600,8 @@ void bdrv_set_dirty_bitmap_locked(BdrvDirtyBitmap *bitmap,
 void bdrv_set_dirty_bitmap(BdrvDirtyBitmap *bitmap,
                            int64_t offset, int64_t bytes)
 {
+    bdrv_dirty_bitmap_prepare_change(bitmap, &error_warn);
+
     bdrv_dirty_bitmaps_lock(bitmap->bs);
     bdrv_set_dirty_bitmap_locked(bitmap, offset, bytes);
     bdrv_dirty_bitmaps_unlock(bitmap->bs);
@@ -566,6 +618,8 @@ void bdrv_reset_dirty_bitmap_locked(BdrvDirtyBitmap *bitmap,
 void bdrv_reset_dirty_bitmap(BdrvDirtyBitmap *bitmap,
                              int64_t offset, int64_t bytes)
 {
+    bdrv_dirty_bitmap_prepare_change(bitmap, &error_warn);
+
     bdrv_dirty_bitmaps_lock(bitmap->bs);
     bdrv_reset_dirty_bitmap_locked(bitmap, offset, bytes);
     bdrv_dirty_bitmaps_unlock(bitmap->bs);
@@ -575,6 +629,8 @@ void bdrv_clear_dirty_bitmap(BdrvDirtyBitmap *bitmap, HBitmap **out)
 {
     IO_CODE();
     assert(!bdrv_dirty_bitmap_readonly(bitmap));
+    bdrv_dirty_bitmap_prepare_change(bitmap, &error_warn);
+
     bdrv_dirty_bitmaps_lock(bitmap->bs);
     if (!out) {
         hbitmap_reset_all(bitmap->bitmap);
@@ -582,6 +638,7 @@ void bdrv_clear_dirty_bitmap(BdrvDirtyBitmap *bitmap, HBitmap **out)
         HBitmap *backup = bitmap->bitmap;
         bitmap->bitmap = hbitmap_alloc(bitmap->size,
                                        hbitmap_granularity(backup));
+        hbitmap_transfer_meta(bitmap->bitmap, backup);
         *out = backup;
     }
     bdrv_dirty_bitmaps_unlock(bitmap->bs);
@@ -593,9 +650,62 @@ void bdrv_restore_dirty_bitmap(BdrvDirtyBitmap *bitmap, HBitmap *backup)
     assert(!bdrv_dirty_bitmap_readonly(bitmap));
     GLOBAL_STATE_CODE();
     bitmap->bitmap = backup;
+    hbitmap_transfer_meta(backup, tmp);
     hbitmap_free(tmp);
 }
 
+/**
+ * Track which chunks of the serialized form of @bitmap change from now on.
+ * @chunk_size is the number of serialized bytes covered by one bit of the
+ * meta bitmap; this lets image formats rewrite only the changed parts of a
+ * persistent bitmap.
+ */
+void bdrv_create_meta_dirty_bitmap(BdrvDirtyBitmap *bitmap, int chunk_size)
+{
+    assert(!bitmap->meta);
+    bdrv_dirty_bitmaps_lock(bitmap->bs);
+    bitmap->meta = hbitmap_create_meta(bitmap->bitmap,
+                                       chunk_size * BITS_PER_BYTE);
+    bdrv_dirty_bitmaps_unlock(bitmap->bs);
+}
+
+void bdrv_release_meta_dirty_bitmap(BdrvDirtyBitmap *bitmap)
+{
+    assert(bitmap->meta);
+    bdrv_dirty_bitmaps_lock(bitmap->bs);
+    hbitmap_free_meta(bitmap->bitmap);
+    bitmap->meta = NULL;
+    bdrv_dirty_bitmaps_unlock(bitmap->bs);
+}
+
+bool bdrv_dirty_bitmap_has_meta(BdrvDirtyBitmap *bitmap)
+{
+    return bitmap->meta;
+}
+
+/* Return whether any chunk covering [@offset, @offset + @bytes) changed */
+bool bdrv_dirty_bitmap_get_meta(BdrvDirtyBitmap *bitmap, int64_t offset,
+                                int64_t bytes)
+{
+    bool dirty;
+
+    assert(bitmap->meta);
+    bdrv_dirty_bitmaps_lock(bitmap->bs);
+    dirty = hbitmap_next_dirty(bitmap->meta, offset, bytes) >= 0;
+    bdrv_dirty_bitmaps_unlock(bitmap->bs);
+
+    return dirty;
+}
+
+void bdrv_dirty_bitmap_reset_meta(BdrvDirtyBitmap *bitmap, int64_t offset,
+                                  int64_t bytes)
+{
+    assert(bitmap->meta);
+    bdrv_dirty_bitmaps_lock(bitmap->bs);
+    hbitmap_reset(bitmap->meta, offset, bytes);
+    bdrv_dirty_bitmaps_unlock(bitmap->bs);
+}
+
 uint64_t bdrv_dirty_bitmap_serialization_size(const BdrvDirtyBitmap *bitmap,
                                               uint64_t offset, uint64_t bytes)
 {
@@ -815,6 +925,11 @@ bool bdrv_merge_dirty_bitmap(BdrvDirtyBitmap *dest, const BdrvDirtyBitmap *src,
 {
     bool ret = false;
 
+    if (!bdrv_dirty_bitmap_readonly(dest) &&
+        bdrv_dirty_bitmap_prepare_change(dest, errp) < 0) {
+        return false;
+    }
+
     bdrv_dirty_bitmaps_lock(dest->bs);
     if (src->bs != dest->bs) {
         bdrv_dirty_bitmaps_lock(src->bs);
@@ -876,6 +991,7 @@ void bdrv_dirty_bitmap_merge_internal(BdrvDirtyBitmap *dest,
     if (backup) {
         *backup = dest->bitmap;
         dest->bitmap = hbitmap_alloc(dest->size, hbitmap_granularity(*backup));
+        hbitmap_transfer_meta(dest->bitmap, *backup);
         hbitmap_merge(*backup, src->bitmap, dest->bitmap);
     } else {
         hbitmap_merge(dest->bitmap, src->bitmap, dest->bitmap);
@@ -2548,6 +2548,33 @@ static int coroutine_fn raw_co_pwritev(BlockDriverState *bs, int64_t offset,
     return raw_co_prw(bs, offset, bytes, qiov, QEMU_AIO_WRITE);
 }
 
+static int coroutine_fn raw_co_preadv_batch(BlockDriverState *bs,
+                                            BdrvBatchRequest *reqs,
+                                            int nb_reqs)
+{
+#ifdef CONFIG_LINUX_IO_URING
+    BDRVRawState *s = bs->opaque;
+    int i;
+
+    if (!s->use_linux_io_uring || fd_open(bs) < 0) {
+        return -ENOTSUP;
+    }
+
+    /* Misaligned buffers need the thread pool, see raw_co_prw() */
+    if (s->needs_alignment) {
+        for (i = 0; i < nb_reqs; i++) {
+            if (!bdrv_qiov_is_aligned(bs, reqs[i].qiov)) {
+                return -ENOTSUP;
+            }
+        }
+    }
+
+    return luring_co_preadv_batch(bs, s->fd, reqs, nb_reqs);
+#else
+    return -ENOTSUP;
+#endif
+}
+
 static int coroutine_fn raw_co_flush_to_disk(BlockDriverState *bs)
 {
     BDRVRawState *s = bs->opaque;
@@ -3891,6 +3918,7 @@ BlockDriver bdrv_file = {
     .bdrv_co_delete_file = raw_co_delete_file,
 
     .bdrv_co_preadv         = raw_co_preadv,
+    .bdrv_co_preadv_batch   = raw_co_preadv_batch,
     .bdrv_co_pwritev        = raw_co_pwritev,
     .bdrv_co_flush_to_disk  = raw_co_flush_to_disk,
     .bdrv_co_pdiscard       = raw_co_pdiscard,
@@ -4261,6 +4289,7 @@ static BlockDriver bdrv_host_device = {
     .bdrv_co_pwrite_zeroes = hdev_co_pwrite_zeroes,
 
     .bdrv_co_preadv         = raw_co_preadv,
+    .bdrv_co_preadv_batch   = raw_co_preadv_batch,
     .bdrv_co_pwritev        = raw_co_pwritev,
     .bdrv_co_flush_to_disk  = raw_co_flush_to_disk,
     .bdrv_co_pdiscard       = hdev_co_pdiscard,
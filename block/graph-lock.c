@@ -239,7 +239,7 @@ void coroutine_fn bdrv_graph_co_rdlock(void)
     }
 }
 
-void coroutine_fn bdrv_graph_co_rdunlock(void)
+static void bdrv_graph_do_rdunlock(void)
 {
     BdrvGraphRWlock *bdrv_graph;
     bdrv_graph = qemu_get_current_aio_context()->bdrv_graph;
@@ -260,6 +260,34 @@ void coroutine_fn bdrv_graph_co_rdunlock(void)
     }
 }
 
+void coroutine_fn bdrv_graph_co_rdunlock(void)
+{
+    bdrv_graph_do_rdunlock();
+}
+
+bool bdrv_graph_rdlock_nowait(void)
+{
+    BdrvGraphRWlock *bdrv_graph;
+    bdrv_graph = qemu_get_current_aio_context()->bdrv_graph;
+
+    qatomic_set(&bdrv_graph->reader_count, bdrv_graph->reader_count + 1);
+    /* make sure writer sees reader_count before we check has_writer */
+    smp_mb();
+
+    if (!qatomic_read(&has_writer)) {
+        return true;
+    }
+
+    /* A writer is active or waiting for readers, let it proceed */
+    bdrv_graph_do_rdunlock();
+    return false;
+}
+
+void bdrv_graph_rdunlock_nowait(void)
+{
+    bdrv_graph_do_rdunlock();
+}
+
 void bdrv_graph_rdlock_main_loop(void)
 {
     GLOBAL_STATE_CODE();
@@ -26,6 +26,7 @@
 #include "trace.h"
 #include "sysemu/block-backend.h"
 #include "block/aio-wait.h"
+#include "block/aio_task.h"
 #include "block/blockjob.h"
 #include "block/blockjob_int.h"
 #include "block/block_int.h"
@@ -203,6 +204,9 @@ void bdrv_refresh_limits(BlockDriverState *bs, Transaction *tran, Error **errp)
         bs->bl.max_iov = IOV_MAX;
     }
 
+    bs->bl.preadv_nowait = drv->bdrv_preadv_nowait &&
+                           !drv->bdrv_co_is_inserted;
+
     /* Then let the driver override it */
     if (drv->bdrv_refresh_limits) {
         drv->bdrv_refresh_limits(bs, errp);
@@ -1824,6 +1828,244 @@ fail:
     return ret;
 }
 
+typedef struct BdrvBatchTask {
+    AioTask task;
+
+    BdrvChild *child;
+    BdrvBatchRequest *req;
+    bool direct; /* already aligned and tracked by bdrv_co_preadv_batch() */
+} BdrvBatchTask;
+
+/*
+ * This function can count as GRAPH_RDLOCK because bdrv_co_preadv_batch()
+ * holds the graph lock and keeps it until this coroutine has terminated.
+ */
+static int coroutine_fn GRAPH_RDLOCK bdrv_co_preadv_batch_entry(AioTask *task)
+{
+    BdrvBatchTask *t = container_of(task, BdrvBatchTask, task);
+    BdrvBatchRequest *req = t->req;
+
+    if (t->direct) {
+        req->ret = bdrv_driver_preadv(t->child->bs, req->offset, req->bytes,
+                                      req->qiov, 0, req->flags);
+    } else {
+        req->ret = bdrv_co_preadv_part(t->child, req->offset, req->bytes,
+                                       req->qiov, req->qiov_offset,
+                                       req->flags);
+    }
+
+    return req->ret;
+}
+
+static void coroutine_fn
+bdrv_co_preadv_batch_add_task(AioTaskPool *pool, BdrvChild *child,
+                              BdrvBatchRequest *req, bool direct)
+{
+    BdrvBatchTask *t = g_new(BdrvBatchTask, 1);
+
+    *t = (BdrvBatchTask) {
+        .task.func = bdrv_co_preadv_batch_entry,
+        .child = child,
+        .req = req,
+        .direct = direct,
+    };
+    aio_task_pool_start_task(pool, &t->task);
+}
+
+/*
+ * Whether a request can be passed to .bdrv_co_preadv_batch as is, i.e. it
+ * needs no padding, fragmentation, zeroing after EOF or copy-on-read.
+ */
+static bool bdrv_batch_request_is_direct(BlockDriverState *bs,
+                                         BdrvBatchRequest *req,
+                                         int64_t total_bytes)
+{
+    int64_t align = bs->bl.request_alignment;
+    int64_t max_transfer =
+        QEMU_ALIGN_DOWN(MIN_NON_ZERO(bs->bl.max_transfer, INT_MAX), align);
+
+    return req->bytes > 0 &&
+           QEMU_IS_ALIGNED(req->offset, align) &&
+           QEMU_IS_ALIGNED(req->bytes, align) &&
+           req->bytes <= max_transfer &&
+           req->offset + req->bytes <= total_bytes &&
+           !(req->flags & ~BDRV_REQ_REGISTERED_BUF);
+}
+
+/*
+ * Read a vector of requests from @child in one pass through the block layer.
+ *
+ * Requests that need no special handling are tracked here and handed to the
+ * driver's .bdrv_co_preadv_batch together; the others are submitted as
+ * concurrent bdrv_co_preadv_part() calls.  All requests are started before
+ * waiting for any of them.
+ *
+ * The result of each request is stored in its @ret field.  Returns 0 if all
+ * requests succeeded, or the first error otherwise.
+ */
+int coroutine_fn bdrv_co_preadv_batch(BdrvChild *child,
+                                      BdrvBatchRequest *reqs, int nb_reqs)
+{
+    BlockDriverState *bs = child->bs;
+    BlockDriver *drv = bs->drv;
+    g_autofree BdrvBatchRequest *direct = NULL;
+    g_autofree BdrvTrackedRequest *tracked = NULL;
+    g_autofree QEMUIOVector *local_qiov = NULL;
+    g_autofree int *direct_idx = NULL;
+    AioTaskPool *pool = NULL;
+    int64_t total_bytes = -1;
+    int nb_direct = 0;
+    int i, ret;
+    IO_CODE();
+    assert_bdrv_graph_readable();
+
+    if (!bdrv_co_is_inserted(bs)) {
+        for (i = 0; i < nb_reqs; i++) {
+            reqs[i].ret = -ENOMEDIUM;
+        }
+        return nb_reqs ? -ENOMEDIUM : 0;
+    }
+
+    bdrv_inc_in_flight(bs);
+
+    if (drv->bdrv_co_preadv_batch && !qatomic_read(&bs->copy_on_read)) {
+        total_bytes = bdrv_co_getlength(bs);
+    }
+    if (total_bytes > 0) {
+        direct = g_new(BdrvBatchRequest, nb_reqs);
+        direct_idx = g_new(int, nb_reqs);
+        tracked = g_new(BdrvTrackedRequest, nb_reqs);
+        local_qiov = g_new(QEMUIOVector, nb_reqs);
+    }
+
+    for (i = 0; i < nb_reqs; i++) {
+        BdrvBatchRequest *req = &reqs[i];
+        BdrvBatchRequest *d;
+
+        req->ret = bdrv_check_request32(req->offset, req->bytes, req->qiov,
+                                        req->qiov_offset);
+        if (req->ret < 0 || !direct ||
+            !bdrv_batch_request_is_direct(bs, req, total_bytes)) {
+            continue;
+        }
+
+        d = &direct[nb_direct];
+        *d = *req;
+        if (req->qiov_offset || req->qiov->size != req->bytes) {
+            qemu_iovec_init_slice(&local_qiov[nb_direct], req->qiov,
+                                  req->qiov_offset, req->bytes);
+            d->qiov = &local_qiov[nb_direct];
+            d->qiov_offset = 0;
+        } else {
+            local_qiov[nb_direct].iov = NULL;
+        }
+        direct_idx[nb_direct] = i;
+        req->ret = 1; /* completed below */
+
+        tracked_request_begin(&tracked[nb_direct], bs, d->offset, d->bytes,
+                              BDRV_TRACKED_READ);
+        nb_direct++;
+    }
+
+    trace_bdrv_co_preadv_batch(bs, nb_reqs, nb_direct);
+
+    /* This can yield, so do it before any request is plugged */
+    for (i = 0; i < nb_direct; i++) {
+        bdrv_wait_serialising_requests(&tracked[i]);
+    }
+
+    /* Start everything the driver can't take in one go */
+    if (nb_direct < nb_reqs) {
+        pool = aio_task_pool_new(nb_reqs);
+        blk_io_plug();
+        for (i = 0; i < nb_reqs; i++) {
+            if (reqs[i].ret == 0) {
+                bdrv_co_preadv_batch_add_task(pool, child, &reqs[i], false);
+            }
+        }
+        blk_io_unplug();
+    }
+
+    if (nb_direct) {
+        ret = drv->bdrv_co_preadv_batch(bs, direct, nb_direct);
+        if (ret == -ENOTSUP) {
+            if (!pool) {
+                pool = aio_task_pool_new(nb_reqs);
+            }
+            blk_io_plug();
+            for (i = 0; i < nb_direct; i++) {
+                bdrv_co_preadv_batch_add_task(pool, child, &direct[i], true);
+            }
+            blk_io_unplug();
+        }
+    }
+
+    if (pool) {
+        aio_task_pool_wait_all(pool);
+        g_free(pool);
+    }
+
+    for (i = 0; i < nb_direct; i++) {
+        reqs[direct_idx[i]].ret = direct[i].ret;
+        tracked_request_end(&tracked[i]);
+        if (local_qiov[i].iov) {
+            qemu_iovec_destroy(&local_qiov[i]);
+        }
+    }
+
+    bdrv_dec_in_flight(bs);
+
+    for (i = 0; i < nb_reqs; i++) {
+        if (reqs[i].ret < 0) {
+            return reqs[i].ret;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Read from @child without a coroutine.  This only works if the request
+ * needs none of the work done by bdrv_co_preadv_part() (alignment,
+ * serialisation, copy-on-read, reads past the end of the node) and the
+ * driver can complete it immediately.
+ *
+ * Returns -EAGAIN without side effects if the request must be submitted
+ * with bdrv_co_preadv() instead.
+ */
+int bdrv_preadv_nowait(BdrvChild *child, int64_t offset, int64_t bytes,
+                       QEMUIOVector *qiov)
+{
+    BlockDriverState *bs = child->bs;
+    BlockDriver *drv = bs->drv;
+    int64_t align, max_transfer;
+    int ret;
+    IO_CODE();
+    assert_bdrv_graph_readable();
+
+    if (!drv || !bs->bl.preadv_nowait || drv->has_variable_length ||
+        (bs->open_flags & BDRV_O_NO_IO) || qatomic_read(&bs->copy_on_read) ||
+        qatomic_read(&bs->serialising_in_flight)) {
+        return -EAGAIN;
+    }
+
+    align = bs->bl.request_alignment;
+    max_transfer =
+        QEMU_ALIGN_DOWN(MIN_NON_ZERO(bs->bl.max_transfer, INT_MAX), align);
+    if (bytes <= 0 || bytes > max_transfer || qiov->size != bytes ||
+        !QEMU_IS_ALIGNED(offset, align) || !QEMU_IS_ALIGNED(bytes, align) ||
+        bdrv_check_request32(offset, bytes, qiov, 0) < 0 ||
+        offset + bytes > bs->total_sectors * BDRV_SECTOR_SIZE) {
+        return -EAGAIN;
+    }
+
+    bdrv_inc_in_flight(bs);
+    ret = drv->bdrv_preadv_nowait(bs, offset, bytes, qiov);
+    bdrv_dec_in_flight(bs);
+
+    trace_bdrv_preadv_nowait(bs, offset, bytes, ret);
+    return ret;
+}
+
 static int coroutine_fn GRAPH_RDLOCK
 bdrv_co_do_pwrite_zeroes(BlockDriverState *bs, int64_t offset, int64_t bytes,
                          BdrvRequestFlags flags)
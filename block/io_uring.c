@@ -39,6 +39,12 @@ typedef struct LuringAIOCB {
      */
     int total_read;
     QEMUIOVector resubmit_qiov;
+
+    /*
+     * Requests submitted by luring_co_preadv_batch() count down this
+     * counter and only wake up the coroutine once all of them completed.
+     */
+    unsigned int *batch_pending;
 } LuringAIOCB;
 
 typedef struct LuringQueue {
@@ -205,6 +211,10 @@ end:
         luringcb->ret = ret;
         qemu_iovec_destroy(&luringcb->resubmit_qiov);
 
+        if (luringcb->batch_pending && --*luringcb->batch_pending > 0) {
+            continue;
+        }
+
         /*
          * If the coroutine is already entered it must be in ioq_submit()
          * and will notice luringcb->ret has been filled in when it
@@ -398,6 +408,53 @@ int coroutine_fn luring_co_submit(BlockDriverState *bs, int fd, uint64_t offset,
     return luringcb.ret;
 }
 
+/**
+ * luring_co_preadv_batch:
+ *
+ * Queue reads for all requests of a batch, submit them with a single
+ * io_uring_submit() and wait for all of them in one yield.
+ */
+int coroutine_fn luring_co_preadv_batch(BlockDriverState *bs, int fd,
+                                        BdrvBatchRequest *reqs, int nb_reqs)
+{
+    AioContext *ctx = qemu_get_current_aio_context();
+    LuringState *s = aio_get_linux_io_uring(ctx);
+    g_autofree LuringAIOCB *luringcbs = g_new(LuringAIOCB, nb_reqs);
+    unsigned int pending = nb_reqs;
+    int i;
+
+    trace_luring_co_preadv_batch(bs, s, fd, nb_reqs);
+
+    blk_io_plug();
+    for (i = 0; i < nb_reqs; i++) {
+        luringcbs[i] = (LuringAIOCB) {
+            .co             = qemu_coroutine_self(),
+            .ret            = -EINPROGRESS,
+            .qiov           = reqs[i].qiov,
+            .is_read        = true,
+            .batch_pending  = &pending,
+        };
+
+        /*
+         * Unlike luring_co_submit() we can't return early on a submission
+         * error, because the other requests are already queued.  Failed
+         * submissions stay in the queue and are retried, so just wait.
+         */
+        luring_do_submit(fd, &luringcbs[i], s, reqs[i].offset, QEMU_AIO_READ);
+    }
+    blk_io_unplug();
+
+    if (pending > 0) {
+        qemu_coroutine_yield();
+    }
+    assert(pending == 0);
+
+    for (i = 0; i < nb_reqs; i++) {
+        reqs[i].ret = luringcbs[i].ret;
+    }
+    return 0;
+}
+
 void luring_detach_aio_context(LuringState *s, AioContext *old_context)
 {
     aio_set_fd_handler(old_context, s->ring.ring_fd,
@@ -91,6 +91,7 @@ typedef struct Qcow2Bitmap {
     char *name;
 
     BdrvDirtyBitmap *dirty_bitmap;
+    bool update_in_place; /* only rewrite the changed clusters on store */
 
     QSIMPLEQ_ENTRY(Qcow2Bitmap) entry;
 } Qcow2Bitmap;
@@ -953,6 +954,20 @@ static void set_readonly_helper(gpointer bitmap, gpointer value)
     bdrv_dirty_bitmap_set_readonly(bitmap, (bool)value);
 }
 
+/*
+ * Start tracking which clusters of the stored bitmap differ from @bitmap.
+ * Must only be called while the image holds the current bitmap data.
+ */
+static void track_changes_helper(gpointer bitmap, gpointer bs)
+{
+    BDRVQcow2State *s = ((BlockDriverState *)bs)->opaque;
+
+    if (!bdrv_dirty_bitmap_has_meta(bitmap) &&
+        !bdrv_dirty_bitmap_inconsistent(bitmap)) {
+        bdrv_create_meta_dirty_bitmap(bitmap, s->cluster_size);
+    }
+}
+
 /*
  * Return true on success, false on failure.
  * If header_updated is not NULL then it is set appropriately regardless of
@@ -1038,6 +1053,8 @@ qcow2_load_dirty_bitmaps(BlockDriverState *bs,
     if (!can_write(bs)) {
         g_slist_foreach(created_dirty_bitmaps, set_readonly_helper,
                         (gpointer)true);
+    } else {
+        g_slist_foreach(created_dirty_bitmaps, track_changes_helper, bs);
     }
 
     g_slist_free(created_dirty_bitmaps);
@@ -1154,7 +1171,8 @@ int qcow2_reopen_bitmaps_rw(BlockDriverState *bs, Error **errp)
         }
 
         if (!(bm->flags & BME_FLAG_IN_USE)) {
-            if (!bdrv_dirty_bitmap_readonly(bitmap)) {
+            /* After a checkpoint, writable bitmaps are not IN_USE on disk */
+            if (!bdrv_dirty_bitmap_readonly(bitmap) && !s->bitmaps_clean) {
                 error_setg(errp, "Corruption: bitmap '%s' is not marked IN_USE "
                            "in the image '%s' and not marked readonly in RAM",
                            bm->name, bs->filename);
@@ -1210,9 +1228,11 @@ int qcow2_reopen_bitmaps_rw(BlockDriverState *bs, Error **errp)
             error_setg_errno(errp, -ret, "Cannot update bitmap directory");
             goto out;
         }
+        qatomic_set(&s->bitmaps_clean, false);
     }
 
     g_slist_foreach(ro_dirty_bitmaps, set_readonly_helper, (gpointer)false);
+    g_slist_foreach(ro_dirty_bitmaps, track_changes_helper, bs);
     ret = 0;
 
 out:
@@ -1434,6 +1454,160 @@ fail:
     return ret;
 }
 
+/*
+ * The table of @bm can be updated in place if its geometry still matches
+ * bm->dirty_bitmap and all changes since the last store were tracked.
+ */
+static bool can_update_in_place(BlockDriverState *bs, Qcow2Bitmap *bm)
+{
+    BDRVQcow2State *s = bs->opaque;
+    BdrvDirtyBitmap *bitmap = bm->dirty_bitmap;
+    uint64_t bm_size = bdrv_dirty_bitmap_size(bitmap);
+
+    return bm->table.offset != 0 &&
+           bdrv_dirty_bitmap_has_meta(bitmap) &&
+           bm->granularity_bits ==
+               ctz32(bdrv_dirty_bitmap_granularity(bitmap)) &&
+           bm->table.size ==
+               size_to_clusters(s, bdrv_dirty_bitmap_serialization_size(
+                                       bitmap, 0, bm_size));
+}
+
+/* store_bitmap_changes()
+ * Rewrite the clusters of bm->dirty_bitmap that changed since it was last
+ * stored, allocating and freeing bitmap clusters as needed. The bitmap table
+ * is updated in place, so bm->table stays valid.
+ */
+static int store_bitmap_changes(BlockDriverState *bs, Qcow2Bitmap *bm,
+                                Error **errp)
+{
+    BDRVQcow2State *s = bs->opaque;
+    BdrvDirtyBitmap *bitmap = bm->dirty_bitmap;
+    const char *bm_name = bdrv_dirty_bitmap_name(bitmap);
+    uint64_t bm_size = bdrv_dirty_bitmap_size(bitmap);
+    uint64_t limit;
+    uint64_t *tb;
+    uint64_t *allocated, *dropped;
+    uint32_t nb_allocated = 0, nb_dropped = 0;
+    uint8_t *buf;
+    bool tb_changed = false;
+    uint32_t i;
+    int ret;
+
+    ret = bitmap_table_load(bs, &bm->table, &tb);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to read bitmap table of '%s'",
+                         bm_name);
+        return ret;
+    }
+
+    buf = g_malloc(s->cluster_size);
+    allocated = g_new(uint64_t, bm->table.size);
+    dropped = g_new(uint64_t, bm->table.size);
+    limit = bdrv_dirty_bitmap_serialization_coverage(s->cluster_size, bitmap);
+    assert(DIV_ROUND_UP(bm_size, limit) == bm->table.size);
+
+    for (i = 0; i < bm->table.size; i++) {
+        uint64_t offset = i * limit;
+        uint64_t end = MIN(bm_size, offset + limit);
+        uint64_t write_size;
+        int64_t off;
+
+        if (!bdrv_dirty_bitmap_get_meta(bitmap, offset, end - offset)) {
+            continue;
+        }
+
+        write_size = bdrv_dirty_bitmap_serialization_size(bitmap, offset,
+                                                          end - offset);
+        assert(write_size <= s->cluster_size);
+        bdrv_dirty_bitmap_serialize_part(bitmap, buf, offset, end - offset);
+
+        off = tb[i] & BME_TABLE_ENTRY_OFFSET_MASK;
+        if (buffer_is_zero(buf, write_size)) {
+            /* Zero clusters are not stored at all */
+            if (off) {
+                dropped[nb_dropped++] = off;
+            }
+            if (tb[i]) {
+                tb[i] = 0;
+                tb_changed = true;
+            }
+            continue;
+        }
+
+        if (write_size < s->cluster_size) {
+            memset(buf + write_size, 0, s->cluster_size - write_size);
+        }
+
+        if (!off) {
+            off = qcow2_alloc_clusters(bs, s->cluster_size);
+            if (off < 0) {
+                error_setg_errno(errp, -off,
+                                 "Failed to allocate clusters for bitmap '%s'",
+                                 bm_name);
+                ret = off;
+                goto fail;
+            }
+            allocated[nb_allocated++] = off;
+            tb[i] = off;
+            tb_changed = true;
+        }
+
+        ret = qcow2_pre_write_overlap_check(bs, 0, off, s->cluster_size, false);
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "Qcow2 overlap check failed");
+            goto fail;
+        }
+
+        ret = bdrv_pwrite(bs->file, off, s->cluster_size, buf, 0);
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "Failed to write bitmap '%s' to file",
+                             bm_name);
+            goto fail;
+        }
+    }
+
+    if (tb_changed) {
+        ret = qcow2_pre_write_overlap_check(bs, 0, bm->table.offset,
+                                            bm->table.size * sizeof(tb[0]),
+                                            false);
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "Qcow2 overlap check failed");
+            goto fail;
+        }
+
+        bitmap_table_bswap_be(tb, bm->table.size);
+        ret = bdrv_pwrite(bs->file, bm->table.offset,
+                          bm->table.size * sizeof(tb[0]), tb, 0);
+        if (ret < 0) {
+            error_setg_errno(errp, -ret, "Failed to write bitmap '%s' to file",
+                             bm_name);
+            goto fail;
+        }
+    }
+
+    /* The table no longer references these clusters */
+    for (i = 0; i < nb_dropped; i++) {
+        qcow2_free_clusters(bs, dropped[i], s->cluster_size,
+                            QCOW2_DISCARD_ALWAYS);
+    }
+    ret = 0;
+    goto out;
+
+fail:
+    for (i = 0; i < nb_allocated; i++) {
+        qcow2_free_clusters(bs, allocated[i], s->cluster_size,
+                            QCOW2_DISCARD_ALWAYS);
+    }
+out:
+    g_free(dropped);
+    g_free(allocated);
+    g_free(buf);
+    g_free(tb);
+
+    return ret;
+}
+
 static Qcow2Bitmap *find_bitmap_by_name(Qcow2BitmapList *bm_list,
                                         const char *name)
 {
@@ -1599,15 +1773,24 @@ bool qcow2_store_persistent_dirty_bitmaps(BlockDriverState *bs,
             bm->name = g_strdup(name);
             QSIMPLEQ_INSERT_TAIL(bm_list, bm, entry);
         } else {
-            if (!(bm->flags & BME_FLAG_IN_USE)) {
+            if (!(bm->flags & BME_FLAG_IN_USE) && !s->bitmaps_clean) {
                 error_setg(errp, "Bitmap '%s' already exists in the image",
                            name);
                 goto fail;
             }
-            tb = g_memdup(&bm->table, sizeof(bm->table));
-            bm->table.offset = 0;
-            bm->table.size = 0;
-            QSIMPLEQ_INSERT_TAIL(&drop_tables, tb, entry);
+            bm->dirty_bitmap = bitmap;
+            /*
+             * Overwriting clusters is only safe while the image marks the
+             * bitmap IN_USE, otherwise write a new copy and switch to it.
+             */
+            bm->update_in_place = (bm->flags & BME_FLAG_IN_USE) &&
+                                  can_update_in_place(bs, bm);
+            if (!bm->update_in_place) {
+                tb = g_memdup(&bm->table, sizeof(bm->table));
+                bm->table.offset = 0;
+                bm->table.size = 0;
+                QSIMPLEQ_INSERT_TAIL(&drop_tables, tb, entry);
+            }
         }
         bm->flags = bdrv_dirty_bitmap_enabled(bitmap) ? BME_FLAG_AUTO : 0;
         bm->granularity_bits = ctz32(bdrv_dirty_bitmap_granularity(bitmap));
@@ -1631,7 +1814,11 @@ bool qcow2_store_persistent_dirty_bitmaps(BlockDriverState *bs,
             continue;
         }
 
-        ret = store_bitmap(bs, bm, errp);
+        if (bm->update_in_place) {
+            ret = store_bitmap_changes(bs, bm, errp);
+        } else {
+            ret = store_bitmap(bs, bm, errp);
+        }
         if (ret < 0) {
             goto fail;
         }
@@ -1650,6 +1837,23 @@ bool qcow2_store_persistent_dirty_bitmaps(BlockDriverState *bs,
         g_free(tb);
     }
 
+    /* The image now matches the bitmaps, track changes from here on */
+    QSIMPLEQ_FOREACH(bm, bm_list, entry) {
+        BdrvDirtyBitmap *bitmap = bm->dirty_bitmap;
+
+        if (release_stored || bitmap == NULL ||
+            bdrv_dirty_bitmap_readonly(bitmap)) {
+            continue;
+        }
+
+        if (bdrv_dirty_bitmap_has_meta(bitmap)) {
+            bdrv_dirty_bitmap_reset_meta(bitmap, 0,
+                                         bdrv_dirty_bitmap_size(bitmap));
+        } else {
+            bdrv_create_meta_dirty_bitmap(bitmap, s->cluster_size);
+        }
+    }
+
 success:
     if (release_stored) {
         QSIMPLEQ_FOREACH(bm, bm_list, entry) {
@@ -1667,6 +1871,7 @@ success:
 fail:
     QSIMPLEQ_FOREACH(bm, bm_list, entry) {
         if (bm->dirty_bitmap == NULL || bm->table.offset == 0 ||
+            bm->update_in_place ||
             bdrv_dirty_bitmap_readonly(bm->dirty_bitmap))
         {
             continue;
@@ -1683,6 +1888,133 @@ fail:
     return false;
 }
 
+/*
+ * Return true if the persistent bitmaps of @bs differ from what a checkpoint
+ * would leave in the image.
+ */
+static bool qcow2_bitmaps_need_sync(BlockDriverState *bs)
+{
+    BDRVQcow2State *s = bs->opaque;
+    BdrvDirtyBitmap *bitmap;
+
+    if (!qatomic_read(&s->bitmaps_clean)) {
+        return true;
+    }
+
+    FOR_EACH_DIRTY_BITMAP(bs, bitmap) {
+        if (!bdrv_dirty_bitmap_get_persistence(bitmap) ||
+            bdrv_dirty_bitmap_readonly(bitmap) ||
+            bdrv_dirty_bitmap_inconsistent(bitmap)) {
+            continue;
+        }
+
+        if (!bdrv_dirty_bitmap_has_meta(bitmap) ||
+            bdrv_dirty_bitmap_get_meta(bitmap, 0,
+                                       bdrv_dirty_bitmap_size(bitmap))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * qcow2_co_sync_persistent_dirty_bitmaps()
+ * Checkpoint the persistent bitmaps: store them without releasing them, so
+ * that the image holds consistent bitmaps that are not IN_USE until the next
+ * change. Only clusters changed since the previous store are rewritten.
+ * The caller must make sure that no requests are in flight.
+ */
+int coroutine_fn
+qcow2_co_sync_persistent_dirty_bitmaps(BlockDriverState *bs, Error **errp)
+{
+    BDRVQcow2State *s = bs->opaque;
+    int ret = 0;
+
+    if (!can_write(bs) || !qcow2_bitmaps_need_sync(bs)) {
+        return 0;
+    }
+
+    /*
+     * Hold s->lock until bitmaps_clean is set, so that a concurrent
+     * qcow2_co_mark_bitmaps_in_use() either runs before the store or sees
+     * the clean state and marks the bitmaps again.
+     */
+    qemu_co_mutex_lock(&s->lock);
+    if (!qcow2_store_persistent_dirty_bitmaps(bs, false, errp)) {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    ret = qcow2_write_caches(bs);
+    if (ret == 0) {
+        ret = bdrv_co_flush(bs->file->bs);
+    }
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to flush bitmaps");
+        goto out;
+    }
+
+    qatomic_set(&s->bitmaps_clean, true);
+
+out:
+    qemu_co_mutex_unlock(&s->lock);
+    return ret;
+}
+
+/*
+ * qcow2_co_mark_bitmaps_in_use()
+ * Must be called before any guest write. After a checkpoint the stored
+ * bitmaps are not IN_USE, so set the flag again before they go stale.
+ */
+int coroutine_fn qcow2_co_mark_bitmaps_in_use(BlockDriverState *bs)
+{
+    BDRVQcow2State *s = bs->opaque;
+    Qcow2BitmapList *bm_list;
+    Qcow2Bitmap *bm;
+    int ret = 0;
+
+    if (!qatomic_read(&s->bitmaps_clean)) {
+        return 0;
+    }
+
+    qemu_co_mutex_lock(&s->lock);
+    if (!s->bitmaps_clean) {
+        goto out;
+    }
+
+    if (s->nb_bitmaps == 0) {
+        qatomic_set(&s->bitmaps_clean, false);
+        goto out;
+    }
+
+    bm_list = bitmap_list_load(bs, s->bitmap_directory_offset,
+                               s->bitmap_directory_size, NULL);
+    if (bm_list == NULL) {
+        ret = -EIO;
+        goto out;
+    }
+
+    QSIMPLEQ_FOREACH(bm, bm_list, entry) {
+        BdrvDirtyBitmap *bitmap = bdrv_find_dirty_bitmap(bs, bm->name);
+
+        if (bitmap && bdrv_dirty_bitmap_get_persistence(bitmap) &&
+            !bdrv_dirty_bitmap_readonly(bitmap)) {
+            bm->flags |= BME_FLAG_IN_USE;
+        }
+    }
+
+    ret = update_ext_header_and_dir_in_place(bs, bm_list);
+    bitmap_list_free(bm_list);
+    if (ret == 0) {
+        qatomic_set(&s->bitmaps_clean, false);
+    }
+
+out:
+    qemu_co_mutex_unlock(&s->lock);
+    return ret;
+}
+
 int qcow2_reopen_bitmaps_ro(BlockDriverState *bs, Error **errp)
 {
     BdrvDirtyBitmap *bitmap;
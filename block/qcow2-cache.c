@@ -41,6 +41,7 @@ struct Qcow2Cache {
     int                     size;
     int                     table_size;
     bool                    depends_on_flush;
+    bool                    written_since_flush;
     void                   *table_array;
     uint64_t                lru_counter;
     uint64_t                cache_clean_lru_counter;
@@ -163,32 +164,68 @@ int qcow2_cache_destroy(Qcow2Cache *c)
     return 0;
 }
 
+/*
+ * Maximum number of adjacent tables that are written back with one request.
+ */
+#define QCOW2_CACHE_MAX_COALESCE 32
+
+typedef struct Qcow2CacheDirtyEntry {
+    int64_t offset;
+    int index;
+} Qcow2CacheDirtyEntry;
+
+static int qcow2_cache_dirty_entry_cmp(const void *a, const void *b)
+{
+    const Qcow2CacheDirtyEntry *ea = a, *eb = b;
+
+    return ea->offset < eb->offset ? -1 : ea->offset > eb->offset;
+}
+
 static int qcow2_cache_flush_dependency(BlockDriverState *bs, Qcow2Cache *c)
 {
+    Qcow2Cache *dep = c->depends;
     int ret;
 
-    ret = qcow2_cache_flush(bs, c->depends);
+    /*
+     * The tables of @dep, and any data that @c depends on being flushed
+     * (e.g. COW), have to be stable before our tables are written.  If
+     * neither has been written since the last flush, there is nothing to
+     * wait for.
+     */
+    ret = qcow2_cache_write(bs, dep);
     if (ret < 0) {
         return ret;
     }
 
+    if (dep->written_since_flush || c->depends_on_flush) {
+        ret = bdrv_flush(bs->file->bs);
+        if (ret < 0) {
+            return ret;
+        }
+        dep->written_since_flush = false;
+        c->depends_on_flush = false;
+    }
+
     c->depends = NULL;
-    c->depends_on_flush = false;
 
     return 0;
 }
 
-static int qcow2_cache_entry_flush(BlockDriverState *bs, Qcow2Cache *c, int i)
+/*
+ * Write back @count tables that are adjacent on disk, in ascending order of
+ * their offsets, with a single request.
+ */
+static int qcow2_cache_write_tables(BlockDriverState *bs, Qcow2Cache *c,
+                                    const Qcow2CacheDirtyEntry *run, int count)
 {
     BDRVQcow2State *s = bs->opaque;
+    int64_t offset = run[0].offset;
+    int64_t bytes = (int64_t) count * c->table_size;
     int ret = 0;
-
-    if (!c->entries[i].dirty || !c->entries[i].offset) {
-        return 0;
-    }
+    int i;
 
     trace_qcow2_cache_entry_flush(qemu_coroutine_self(),
-                                  c == s->l2_table_cache, i);
+                                  c == s->l2_table_cache, run[0].index);
 
     if (c->depends) {
         ret = qcow2_cache_flush_dependency(bs, c);
@@ -205,13 +242,12 @@ static int qcow2_cache_entry_flush(BlockDriverState *bs, Qcow2Cache *c, int i)
 
     if (c == s->refcount_block_cache) {
         ret = qcow2_pre_write_overlap_check(bs, QCOW2_OL_REFCOUNT_BLOCK,
-                c->entries[i].offset, c->table_size, false);
+                offset, bytes, false);
     } else if (c == s->l2_table_cache) {
         ret = qcow2_pre_write_overlap_check(bs, QCOW2_OL_ACTIVE_L2,
-                c->entries[i].offset, c->table_size, false);
+                offset, bytes, false);
     } else {
-        ret = qcow2_pre_write_overlap_check(bs, 0,
-                c->entries[i].offset, c->table_size, false);
+        ret = qcow2_pre_write_overlap_check(bs, 0, offset, bytes, false);
     }
 
     if (ret < 0) {
@@ -224,28 +260,56 @@ static int qcow2_cache_entry_flush(BlockDriverState *bs, Qcow2Cache *c, int i)
         BLKDBG_EVENT(bs->file, BLKDBG_L2_UPDATE);
     }
 
-    ret = bdrv_pwrite(bs->file, c->entries[i].offset, c->table_size,
-                      qcow2_cache_get_table_addr(c, i), 0);
+    if (count == 1) {
+        ret = bdrv_pwrite(bs->file, offset, c->table_size,
+                          qcow2_cache_get_table_addr(c, run[0].index), 0);
+    } else {
+        /* The tables are not contiguous in memory, gather them first */
+        uint8_t *buf = qemu_try_blockalign(bs->file->bs, bytes);
+
+        if (buf == NULL) {
+            return -ENOMEM;
+        }
+        for (i = 0; i < count; i++) {
+            memcpy(buf + (size_t) i * c->table_size,
+                   qcow2_cache_get_table_addr(c, run[i].index), c->table_size);
+        }
+        ret = bdrv_pwrite(bs->file, offset, bytes, buf, 0);
+        qemu_vfree(buf);
+    }
     if (ret < 0) {
         return ret;
     }
 
-    c->entries[i].dirty = false;
+    for (i = 0; i < count; i++) {
+        c->entries[run[i].index].dirty = false;
+    }
+    c->written_since_flush = true;
 
     return 0;
 }
 
-int qcow2_cache_write(BlockDriverState *bs, Qcow2Cache *c)
+/*
+ * Write back a sorted array of dirty tables, merging runs of adjacent tables
+ * into one request each.
+ */
+static int qcow2_cache_write_sorted(BlockDriverState *bs, Qcow2Cache *c,
+                                    const Qcow2CacheDirtyEntry *dirty, int n)
 {
-    BDRVQcow2State *s = bs->opaque;
     int result = 0;
+    int i, count;
     int ret;
-    int i;
 
-    trace_qcow2_cache_flush(qemu_coroutine_self(), c == s->l2_table_cache);
+    for (i = 0; i < n; i += count) {
+        for (count = 1; i + count < n && count < QCOW2_CACHE_MAX_COALESCE;
+             count++) {
+            if (dirty[i + count].offset !=
+                dirty[i + count - 1].offset + c->table_size) {
+                break;
+            }
+        }
 
-    for (i = 0; i < c->size; i++) {
-        ret = qcow2_cache_entry_flush(bs, c, i);
+        ret = qcow2_cache_write_tables(bs, c, &dirty[i], count);
         if (ret < 0 && result != -ENOSPC) {
             result = ret;
         }
@@ -254,6 +318,80 @@ int qcow2_cache_write(BlockDriverState *bs, Qcow2Cache *c)
     return result;
 }
 
+/*
+ * Write back table @i before it is evicted.  Unused dirty tables right next
+ * to it on disk go out with the same request, which spares later evictions
+ * a write of their own.
+ */
+static int qcow2_cache_entry_flush(BlockDriverState *bs, Qcow2Cache *c, int i)
+{
+    Qcow2CacheDirtyEntry run[2 * QCOW2_CACHE_MAX_COALESCE - 1];
+    int64_t offset = c->entries[i].offset;
+    int64_t span = (int64_t) (QCOW2_CACHE_MAX_COALESCE - 1) * c->table_size;
+    int n = 0, idx = 0, first, last, j;
+
+    if (!c->entries[i].dirty || !offset) {
+        return 0;
+    }
+
+    for (j = 0; j < c->size; j++) {
+        const Qcow2CachedTable *t = &c->entries[j];
+
+        if ((j == i || (t->dirty && t->ref == 0 && t->offset)) &&
+            t->offset >= offset - span && t->offset <= offset + span) {
+            run[n++] = (Qcow2CacheDirtyEntry) { t->offset, j };
+        }
+    }
+    qsort(run, n, sizeof(run[0]), qcow2_cache_dirty_entry_cmp);
+
+    while (run[idx].index != i) {
+        idx++;
+    }
+    first = last = idx;
+    while (first > 0 &&
+           run[first - 1].offset == run[first].offset - c->table_size) {
+        first--;
+    }
+    while (last + 1 < n &&
+           run[last + 1].offset == run[last].offset + c->table_size) {
+        last++;
+    }
+
+    /* Keep @i in the request if the run is longer than one request allows */
+    if (last - first + 1 > QCOW2_CACHE_MAX_COALESCE) {
+        first = MAX(first, idx - QCOW2_CACHE_MAX_COALESCE / 2);
+        last = MIN(last, first + QCOW2_CACHE_MAX_COALESCE - 1);
+    }
+
+    return qcow2_cache_write_tables(bs, c, &run[first], last - first + 1);
+}
+
+int qcow2_cache_write(BlockDriverState *bs, Qcow2Cache *c)
+{
+    BDRVQcow2State *s = bs->opaque;
+    g_autofree Qcow2CacheDirtyEntry *dirty = NULL;
+    int n = 0;
+    int i;
+
+    trace_qcow2_cache_flush(qemu_coroutine_self(), c == s->l2_table_cache);
+
+    for (i = 0; i < c->size; i++) {
+        if (c->entries[i].dirty && c->entries[i].offset) {
+            if (!dirty) {
+                dirty = g_new(Qcow2CacheDirtyEntry, c->size);
+            }
+            dirty[n++] = (Qcow2CacheDirtyEntry) { c->entries[i].offset, i };
+        }
+    }
+
+    if (n == 0) {
+        return 0;
+    }
+
+    qsort(dirty, n, sizeof(dirty[0]), qcow2_cache_dirty_entry_cmp);
+    return qcow2_cache_write_sorted(bs, c, dirty, n);
+}
+
 int qcow2_cache_flush(BlockDriverState *bs, Qcow2Cache *c)
 {
     int result = qcow2_cache_write(bs, c);
@@ -262,6 +400,8 @@ int qcow2_cache_flush(BlockDriverState *bs, Qcow2Cache *c)
         int ret = bdrv_flush(bs->file->bs);
         if (ret < 0) {
             result = ret;
+        } else {
+            c->written_since_flush = false;
         }
     }
 
@@ -491,7 +491,7 @@ static int alloc_refcount_block(BlockDriverState *bs,
         s->cluster_size;
 
     ret = qcow2_refcount_area(bs, meta_offset, 0, false,
-                              refcount_table_index, new_block);
+                              refcount_table_index, new_block, false);
     if (ret < 0) {
         return ret;
     }
@@ -524,6 +524,9 @@ fail:
  * If @new_refblock_offset is not zero, it contains the offset of a refcount
  * block that should be entered into the new refcount table at index
  * @new_refblock_index.
+ * If @allocate_additional is true, the refcount of the @additional_clusters
+ * is set to 1 as well, so that they are allocated without going through the
+ * refcount cache cluster by cluster.
  *
  * Returns: The offset after the new refcount structures (i.e. where the
  *          @additional_clusters may be placed) on success, -errno on error.
@@ -531,13 +534,14 @@ fail:
 int64_t qcow2_refcount_area(BlockDriverState *bs, uint64_t start_offset,
                             uint64_t additional_clusters, bool exact_size,
                             int new_refblock_index,
-                            uint64_t new_refblock_offset)
+                            uint64_t new_refblock_offset,
+                            bool allocate_additional)
 {
     BDRVQcow2State *s = bs->opaque;
     uint64_t total_refblock_count_u64, additional_refblock_count;
     int total_refblock_count, table_size, area_reftable_index, table_clusters;
     int i;
-    uint64_t table_offset, block_offset, end_offset;
+    uint64_t table_offset, block_offset, end_offset, alloc_end;
     int ret;
     uint64_t *new_table;
 
@@ -609,6 +613,10 @@ int64_t qcow2_refcount_area(BlockDriverState *bs, uint64_t start_offset,
 
     table_offset = start_offset + additional_refblock_count * s->cluster_size;
     end_offset = table_offset + table_clusters * s->cluster_size;
+    alloc_end = end_offset;
+    if (allocate_additional) {
+        alloc_end += additional_clusters * s->cluster_size;
+    }
 
     /* Fill the refcount blocks, and create new ones, if necessary */
     block_offset = start_offset;
@@ -640,10 +648,13 @@ int64_t qcow2_refcount_area(BlockDriverState *bs, uint64_t start_offset,
         /* First host offset covered by this refblock */
         first_offset_covered = (uint64_t)i * s->refcount_block_size *
                                s->cluster_size;
-        if (first_offset_covered < end_offset) {
+        if (first_offset_covered < alloc_end) {
             int j, end_index;
 
-            /* Set the refcount of all of the new refcount structures to 1 */
+            /*
+             * Set the refcount of all of the new refcount structures (and of
+             * the additional clusters, if requested) to 1
+             */
 
             if (first_offset_covered < start_offset) {
                 assert(i == area_reftable_index);
@@ -653,7 +664,7 @@ int64_t qcow2_refcount_area(BlockDriverState *bs, uint64_t start_offset,
                 j = 0;
             }
 
-            end_index = MIN((end_offset - first_offset_covered) /
+            end_index = MIN((alloc_end - first_offset_covered) /
                             s->cluster_size,
                             s->refcount_block_size);
 
@@ -699,6 +699,7 @@ static const char *const mutable_opts[] = {
     QCOW2_OPT_L2_CACHE_ENTRY_SIZE,
     QCOW2_OPT_REFCOUNT_CACHE_SIZE,
     QCOW2_OPT_CACHE_CLEAN_INTERVAL,
+    QCOW2_OPT_BITMAP_SYNC_INTERVAL,
     NULL
 };
 
@@ -815,6 +816,12 @@ static QemuOptsList qcow2_runtime_opts = {
             .type = QEMU_OPT_NUMBER,
             .help = "Clean unused cache entries after this time (in seconds)",
         },
+        {
+            .name = QCOW2_OPT_BITMAP_SYNC_INTERVAL,
+            .type = QEMU_OPT_NUMBER,
+            .help = "Store changed persistent bitmaps after this time "
+                    "(in seconds)",
+        },
         BLOCK_CRYPTO_OPT_DEF_KEY_SECRET("encrypt.",
             "ID of secret providing qcow2 AES key or LUKS passphrase"),
         { /* end of list */ }
@@ -865,15 +872,95 @@ static void cache_clean_timer_del(BlockDriverState *bs)
     }
 }
 
+static void coroutine_fn bitmap_sync_co_entry(void *opaque)
+{
+    BlockDriverState *bs = opaque;
+    BDRVQcow2State *s = bs->opaque;
+    Error *local_err = NULL;
+
+    bdrv_drained_begin(bs);
+    bdrv_graph_co_rdlock();
+    if (qcow2_co_sync_persistent_dirty_bitmaps(bs, &local_err) < 0) {
+        warn_reportf_err(local_err, "Failed to checkpoint bitmaps of '%s': ",
+                         bdrv_get_device_or_node_name(bs));
+    }
+    bdrv_graph_co_rdunlock();
+    bdrv_drained_end(bs);
+
+    if (s->bitmap_sync_timer) {
+        timer_mod(s->bitmap_sync_timer,
+                  qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL) +
+                  (int64_t) s->bitmap_sync_interval * 1000);
+    }
+
+    qatomic_set(&s->bitmap_sync_running, false);
+    aio_wait_kick();
+}
+
+/*
+ * The checkpoint does I/O, so it runs in a coroutine instead of polling from
+ * the timer callback. It drains @bs itself and therefore is not counted as
+ * an in-flight request; bitmap_sync_wait() must be used before @bs goes away.
+ * The timer is rearmed when the checkpoint is done.
+ */
+static void bitmap_sync_timer_cb(void *opaque)
+{
+    BlockDriverState *bs = opaque;
+    BDRVQcow2State *s = bs->opaque;
+    Coroutine *co;
+
+    qatomic_set(&s->bitmap_sync_running, true);
+    co = qemu_coroutine_create(bitmap_sync_co_entry, bs);
+    aio_co_enter(bdrv_get_aio_context(bs), co);
+}
+
+static void bitmap_sync_wait(BlockDriverState *bs)
+{
+    BDRVQcow2State *s = bs->opaque;
+
+    BDRV_POLL_WHILE(bs, qatomic_read(&s->bitmap_sync_running));
+}
+
+static void bitmap_sync_timer_init(BlockDriverState *bs, AioContext *context)
+{
+    BDRVQcow2State *s = bs->opaque;
+    if (s->bitmap_sync_interval > 0) {
+        s->bitmap_sync_timer =
+            aio_timer_new_with_attrs(context, QEMU_CLOCK_VIRTUAL,
+                                     SCALE_MS, QEMU_TIMER_ATTR_EXTERNAL,
+                                     bitmap_sync_timer_cb, bs);
+        timer_mod(s->bitmap_sync_timer, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL) +
+                  (int64_t) s->bitmap_sync_interval * 1000);
+    }
+}
+
+static void bitmap_sync_timer_del(BlockDriverState *bs)
+{
+    BDRVQcow2State *s = bs->opaque;
+    QEMUTimer *timer = s->bitmap_sync_timer;
+
+    /* A running checkpoint rearms the timer, so free it only afterwards */
+    s->bitmap_sync_timer = NULL;
+    if (timer) {
+        timer_del(timer);
+    }
+    bitmap_sync_wait(bs);
+    if (timer) {
+        timer_free(timer);
+    }
+}
+
 static void qcow2_detach_aio_context(BlockDriverState *bs)
 {
     cache_clean_timer_del(bs);
+    bitmap_sync_timer_del(bs);
 }
 
 static void qcow2_attach_aio_context(BlockDriverState *bs,
                                      AioContext *new_context)
 {
     cache_clean_timer_init(bs, new_context);
+    bitmap_sync_timer_init(bs, new_context);
 }
 
 static bool read_cache_sizes(BlockDriverState *bs, QemuOpts *opts,
@@ -977,6 +1064,7 @@ typedef struct Qcow2ReopenState {
     bool discard_passthrough[QCOW2_DISCARD_MAX];
     bool discard_no_unref;
     uint64_t cache_clean_interval;
+    uint64_t bitmap_sync_interval;
     QCryptoBlockOpenOptions *crypto_opts; /* Disk encryption runtime options */
 } Qcow2ReopenState;
 
@@ -1078,6 +1166,15 @@ static int qcow2_update_options_prepare(BlockDriverState *bs,
         goto fail;
     }
 
+    /* Interval for persistent bitmap checkpoints, 0 to disable them */
+    r->bitmap_sync_interval =
+        qemu_opt_get_number(opts, QCOW2_OPT_BITMAP_SYNC_INTERVAL, 0);
+    if (r->bitmap_sync_interval > UINT_MAX) {
+        error_setg(errp, "Bitmap sync interval too big");
+        ret = -EINVAL;
+        goto fail;
+    }
+
     /* lazy-refcounts; flush if going from enabled to disabled */
     r->use_lazy_refcounts = qemu_opt_get_bool(opts, QCOW2_OPT_LAZY_REFCOUNTS,
         (s->compatible_features & QCOW2_COMPAT_LAZY_REFCOUNTS));
@@ -1244,6 +1341,12 @@ static void qcow2_update_options_commit(BlockDriverState *bs,
         cache_clean_timer_init(bs, bdrv_get_aio_context(bs));
     }
 
+    if (s->bitmap_sync_interval != r->bitmap_sync_interval) {
+        bitmap_sync_timer_del(bs);
+        s->bitmap_sync_interval = r->bitmap_sync_interval;
+        bitmap_sync_timer_init(bs, bdrv_get_aio_context(bs));
+    }
+
     qapi_free_QCryptoBlockOpenOptions(s->crypto_opts);
     s->crypto_opts = r->crypto_opts;
 }
@@ -1892,6 +1995,7 @@ qcow2_do_open(BlockDriverState *bs, QDict *options, int flags,
     /* else pre-write overlap checks in cache_destroy may crash */
     s->l1_table = NULL;
     cache_clean_timer_del(bs);
+    bitmap_sync_timer_del(bs);
     if (s->l2_table_cache) {
         qcow2_cache_destroy(s->l2_table_cache);
     }
@@ -2418,6 +2522,132 @@ out:
     return ret;
 }
 
+typedef struct Qcow2BatchTask {
+    AioTask task;
+
+    BlockDriverState *bs;
+    BdrvBatchRequest *req;
+} Qcow2BatchTask;
+
+/*
+ * This function can count as GRAPH_RDLOCK because qcow2_co_preadv_batch()
+ * holds the graph lock and keeps it until this coroutine has terminated.
+ */
+static int coroutine_fn GRAPH_RDLOCK qcow2_co_preadv_batch_entry(AioTask *task)
+{
+    Qcow2BatchTask *t = container_of(task, Qcow2BatchTask, task);
+    BdrvBatchRequest *req = t->req;
+
+    req->ret = qcow2_co_preadv_part(t->bs, req->offset, req->bytes,
+                                    req->qiov, 0, req->flags);
+    return req->ret;
+}
+
+/*
+ * Requests that map to a single run of normal clusters are forwarded to the
+ * data file as one batch, and those that read as zeroes are completed right
+ * away. Anything else (backing file, compressed clusters, requests crossing
+ * different kinds of clusters) goes through qcow2_co_preadv_part() in
+ * parallel with the batch.
+ */
+static int coroutine_fn GRAPH_RDLOCK
+qcow2_co_preadv_batch(BlockDriverState *bs, BdrvBatchRequest *reqs,
+                      int nb_reqs)
+{
+    BDRVQcow2State *s = bs->opaque;
+    g_autofree BdrvBatchRequest *data = NULL;
+    g_autofree int *data_idx = NULL;
+    g_autofree int *slow_idx = NULL;
+    AioTaskPool *aio = NULL;
+    int nb_data = 0, nb_slow = 0;
+    int i;
+
+    if (s->crypto) {
+        return -ENOTSUP;
+    }
+
+    data = g_new(BdrvBatchRequest, nb_reqs);
+    data_idx = g_new(int, nb_reqs);
+    slow_idx = g_new(int, nb_reqs);
+
+    qemu_co_mutex_lock(&s->lock);
+    for (i = 0; i < nb_reqs; i++) {
+        BdrvBatchRequest *req = &reqs[i];
+        unsigned int cur_bytes = MIN(req->bytes, INT_MAX);
+        uint64_t host_offset = 0;
+        QCow2SubclusterType type;
+        int ret;
+
+        ret = qcow2_get_host_offset(bs, req->offset, &cur_bytes,
+                                    &host_offset, &type);
+        if (ret < 0 || cur_bytes != req->bytes) {
+            slow_idx[nb_slow++] = i;
+            continue;
+        }
+
+        switch (type) {
+        case QCOW2_SUBCLUSTER_NORMAL:
+            data[nb_data] = (BdrvBatchRequest) {
+                .offset = host_offset,
+                .bytes = req->bytes,
+                .qiov = req->qiov,
+                .flags = req->flags,
+            };
+            data_idx[nb_data++] = i;
+            break;
+
+        case QCOW2_SUBCLUSTER_ZERO_PLAIN:
+        case QCOW2_SUBCLUSTER_ZERO_ALLOC:
+            qemu_iovec_memset(req->qiov, 0, 0, req->bytes);
+            req->ret = 0;
+            break;
+
+        case QCOW2_SUBCLUSTER_UNALLOCATED_PLAIN:
+        case QCOW2_SUBCLUSTER_UNALLOCATED_ALLOC:
+            if (!bs->backing) {
+                qemu_iovec_memset(req->qiov, 0, 0, req->bytes);
+                req->ret = 0;
+                break;
+            }
+            /* fall through */
+
+        default:
+            slow_idx[nb_slow++] = i;
+            break;
+        }
+    }
+    qemu_co_mutex_unlock(&s->lock);
+
+    if (nb_slow) {
+        aio = aio_task_pool_new(nb_slow);
+        for (i = 0; i < nb_slow; i++) {
+            Qcow2BatchTask *t = g_new(Qcow2BatchTask, 1);
+
+            *t = (Qcow2BatchTask) {
+                .task.func = qcow2_co_preadv_batch_entry,
+                .bs = bs,
+                .req = &reqs[slow_idx[i]],
+            };
+            aio_task_pool_start_task(aio, &t->task);
+        }
+    }
+
+    if (nb_data) {
+        BLKDBG_CO_EVENT(bs->file, BLKDBG_READ_AIO);
+        bdrv_co_preadv_batch(s->data_file, data, nb_data);
+        for (i = 0; i < nb_data; i++) {
+            reqs[data_idx[i]].ret = data[i].ret;
+        }
+    }
+
+    if (aio) {
+        aio_task_pool_wait_all(aio);
+        g_free(aio);
+    }
+
+    return 0;
+}
+
 /* Check if it's possible to merge a write request with the writing of
  * the data from the COW regions */
 static bool merge_cow(uint64_t offset, unsigned bytes,
@@ -2660,6 +2890,11 @@ qcow2_co_pwritev_part(BlockDriverState *bs, int64_t offset, int64_t bytes,
 
     trace_qcow2_writev_start_req(qemu_coroutine_self(), offset, bytes);
 
+    ret = qcow2_co_mark_bitmaps_in_use(bs);
+    if (ret < 0) {
+        return ret;
+    }
+
     while (bytes != 0 && aio_task_pool_status(aio) == 0) {
 
         l2meta = NULL;
@@ -2734,6 +2969,7 @@ static int qcow2_inactivate(BlockDriverState *bs)
     int ret, result = 0;
     Error *local_err = NULL;
 
+    bitmap_sync_wait(bs);
     qcow2_store_persistent_dirty_bitmaps(bs, true, &local_err);
     if (local_err != NULL) {
         result = -EINVAL;
@@ -2766,6 +3002,8 @@ static int qcow2_inactivate(BlockDriverState *bs)
 static void qcow2_do_close(BlockDriverState *bs, bool close_data_file)
 {
     BDRVQcow2State *s = bs->opaque;
+
+    bitmap_sync_timer_del(bs);
     qemu_vfree(s->l1_table);
     /* else pre-write overlap checks in cache_destroy may crash */
     s->l1_table = NULL;
@@ -3286,6 +3524,230 @@ out:
     return ret;
 }
 
+/*
+ * Minimum number of new L2 tables for preallocate_bulk_co().  Below that the
+ * regular allocation path is fast enough and keeps the layout compact.
+ */
+#define QCOW2_PREALLOC_BULK_MIN_L2 16
+
+typedef struct Qcow2PreallocTask {
+    AioTask task;
+
+    BlockDriverState *bs;
+    uint64_t l2_offset;   /* host offset of the first L2 table */
+    uint64_t data_offset; /* host offset of the first data cluster */
+    uint64_t nb_clusters; /* number of data clusters mapped by the tables */
+} Qcow2PreallocTask;
+
+/* Build a run of contiguous L2 tables in memory and write it in one go */
+static coroutine_fn GRAPH_RDLOCK int qcow2_prealloc_l2_task_entry(AioTask *task)
+{
+    Qcow2PreallocTask *t = container_of(task, Qcow2PreallocTask, task);
+    BlockDriverState *bs = t->bs;
+    BDRVQcow2State *s = bs->opaque;
+    size_t entry_words = l2_entry_size(s) / sizeof(uint64_t);
+    size_t len = DIV_ROUND_UP(t->nb_clusters, s->l2_size) << s->cluster_bits;
+    uint64_t *l2_tables;
+    uint64_t i;
+    int ret;
+
+    l2_tables = qemu_try_blockalign0(bs->file->bs, len);
+    if (l2_tables == NULL) {
+        return -ENOMEM;
+    }
+
+    /* Subcluster bitmaps stay zero, as for any preallocated cluster */
+    for (i = 0; i < t->nb_clusters; i++) {
+        l2_tables[i * entry_words] =
+            cpu_to_be64((t->data_offset + (i << s->cluster_bits)) |
+                        QCOW_OFLAG_COPIED);
+    }
+
+    ret = qcow2_pre_write_overlap_check(bs, 0, t->l2_offset, len, false);
+    if (ret == 0) {
+        ret = bdrv_co_pwrite(bs->file, t->l2_offset, len, l2_tables, 0);
+    }
+
+    qemu_vfree(l2_tables);
+    return ret;
+}
+
+/**
+ * Preallocates the metadata for the guest range between @offset and
+ * @new_length in bulk. Instead of allocating one L2 table after another
+ * through the L2 cache, the final layout is computed up front and appended
+ * to the image file: refcount structures that already account for everything
+ * that follows, then all new L2 tables, then the data clusters. The L2 tables
+ * are written with large requests in parallel and the L1 table is updated
+ * once at the end.
+ *
+ * This only covers L2 tables that do not exist yet, so everything before the
+ * first L2 table boundary is preallocated with preallocate_co().  Small
+ * ranges are left to preallocate_co() altogether.
+ *
+ * Returns: 0 on success, -ENOTSUP without any change to the image if the
+ * bulk path cannot be used, other -errno on failure.
+ */
+static int coroutine_fn GRAPH_RDLOCK
+preallocate_bulk_co(BlockDriverState *bs, uint64_t offset, uint64_t new_length,
+                    PreallocMode mode, Error **errp)
+{
+    BDRVQcow2State *s = bs->opaque;
+    uint64_t l2_coverage = (uint64_t)s->l2_size << s->cluster_bits;
+    uint64_t start = ROUND_UP(offset, l2_coverage);
+    uint64_t l2_per_task = MAX(1, MiB >> s->cluster_bits);
+    int nentries = MAX(L1E_SIZE, MIN(bs->file->bs->bl.request_alignment,
+                                     s->cluster_size)) / L1E_SIZE;
+    int l1_first, l1_end, l1_write_start, l1_write_end;
+    int64_t old_file_size, last_cluster, area_start;
+    uint64_t nb_data_clusters, nb_l2_tables, l2_start, data_start, i;
+    g_autofree uint64_t *l1_buf = NULL;
+    AioTaskPool *aio;
+    int ret;
+
+    if (has_data_file(bs) || start >= new_length) {
+        return -ENOTSUP;
+    }
+
+    l1_first = start / l2_coverage;
+    l1_end = DIV_ROUND_UP(new_length, l2_coverage);
+    if (l1_end - l1_first < QCOW2_PREALLOC_BULK_MIN_L2) {
+        return -ENOTSUP;
+    }
+    assert(l1_end <= s->l1_size);
+    for (i = l1_first; i < l1_end; i++) {
+        if (s->l1_table[i] & L1E_OFFSET_MASK) {
+            return -ENOTSUP;
+        }
+    }
+
+    if (start > offset) {
+        ret = preallocate_co(bs, offset, start, mode, errp);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    old_file_size = bdrv_co_getlength(bs->file->bs);
+    if (old_file_size < 0) {
+        error_setg_errno(errp, -old_file_size,
+                         "Failed to inquire current file length");
+        return old_file_size;
+    }
+
+    last_cluster = qcow2_get_last_cluster(bs, old_file_size);
+    if (last_cluster >= 0) {
+        old_file_size = (last_cluster + 1) * s->cluster_size;
+    } else {
+        old_file_size = ROUND_UP(old_file_size, s->cluster_size);
+    }
+
+    nb_data_clusters = DIV_ROUND_UP(new_length - start, s->cluster_size);
+    nb_l2_tables = DIV_ROUND_UP(nb_data_clusters, s->l2_size);
+
+    /* Refcounts for the L2 tables and the data clusters are set right away */
+    area_start = qcow2_refcount_area(bs, old_file_size,
+                                     nb_l2_tables + nb_data_clusters,
+                                     true, 0, 0, true);
+    if (area_start < 0) {
+        error_setg_errno(errp, -area_start,
+                         "Failed to allocate refcount structures");
+        return area_start;
+    }
+
+    l2_start = area_start;
+    data_start = l2_start + (nb_l2_tables << s->cluster_bits);
+
+    if (mode == PREALLOC_MODE_METADATA) {
+        mode = PREALLOC_MODE_OFF;
+    }
+    ret = bdrv_co_truncate(bs->file,
+                           data_start + (nb_data_clusters << s->cluster_bits),
+                           false, mode, 0, errp);
+    if (ret < 0) {
+        error_prepend(errp, "Failed to resize underlying file: ");
+        goto fail;
+    }
+
+    aio = aio_task_pool_new(QCOW2_MAX_WORKERS);
+    for (i = 0; i < nb_l2_tables && aio_task_pool_status(aio) == 0;
+         i += l2_per_task) {
+        Qcow2PreallocTask *t = g_new(Qcow2PreallocTask, 1);
+        uint64_t first_cluster = i * s->l2_size;
+
+        *t = (Qcow2PreallocTask) {
+            .task.func = qcow2_prealloc_l2_task_entry,
+            .bs = bs,
+            .l2_offset = l2_start + (i << s->cluster_bits),
+            .data_offset = data_start + (first_cluster << s->cluster_bits),
+            .nb_clusters = MIN(nb_data_clusters - first_cluster,
+                               l2_per_task * s->l2_size),
+        };
+        aio_task_pool_start_task(aio, &t->task);
+    }
+    aio_task_pool_wait_all(aio);
+    ret = aio_task_pool_status(aio);
+    g_free(aio);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to write L2 tables");
+        goto fail;
+    }
+
+    /* The L2 tables must be on disk before the L1 table points to them */
+    ret = bdrv_co_flush(bs->file->bs);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to flush L2 tables");
+        goto fail;
+    }
+
+    l1_write_start = QEMU_ALIGN_DOWN(l1_first, nentries);
+    l1_write_end = ROUND_UP(l1_end, nentries);
+    l1_buf = g_try_new0(uint64_t, l1_write_end - l1_write_start);
+    if (l1_buf == NULL) {
+        ret = -ENOMEM;
+        error_setg_errno(errp, -ret, "Failed to update the L1 table");
+        goto fail;
+    }
+
+    for (i = l1_write_start; i < MIN(l1_write_end, s->l1_size); i++) {
+        uint64_t entry = s->l1_table[i];
+
+        if (i >= l1_first && i < l1_end) {
+            entry = (l2_start + ((i - l1_first) << s->cluster_bits)) |
+                    QCOW_OFLAG_COPIED;
+        }
+        l1_buf[i - l1_write_start] = cpu_to_be64(entry);
+    }
+
+    ret = qcow2_pre_write_overlap_check(bs, QCOW2_OL_ACTIVE_L1,
+            s->l1_table_offset + L1E_SIZE * l1_write_start,
+            L1E_SIZE * (l1_write_end - l1_write_start), false);
+    if (ret == 0) {
+        BLKDBG_CO_EVENT(bs->file, BLKDBG_L1_UPDATE);
+        ret = bdrv_co_pwrite_sync(bs->file,
+                                  s->l1_table_offset + L1E_SIZE * l1_write_start,
+                                  L1E_SIZE * (l1_write_end - l1_write_start),
+                                  l1_buf, 0);
+    }
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to update the L1 table");
+        goto fail;
+    }
+
+    for (i = l1_first; i < l1_end; i++) {
+        s->l1_table[i] = (l2_start + ((i - l1_first) << s->cluster_bits)) |
+                         QCOW_OFLAG_COPIED;
+    }
+
+    return 0;
+
+fail:
+    qcow2_free_clusters(bs, area_start,
+                        (nb_l2_tables + nb_data_clusters) << s->cluster_bits,
+                        QCOW2_DISCARD_OTHER);
+    return ret;
+}
+
 /* qcow2_refcount_metadata_size:
  * @clusters: number of clusters to refcount (including data and L1/L2 tables)
  * @cluster_size: size of a cluster, in bytes
@@ -4027,6 +4489,12 @@ qcow2_co_pwrite_zeroes(BlockDriverState *bs, int64_t offset, int64_t bytes,
         (offset + bytes);
 
     trace_qcow2_pwrite_zeroes_start_req(qemu_coroutine_self(), offset, bytes);
+
+    ret = qcow2_co_mark_bitmaps_in_use(bs);
+    if (ret < 0) {
+        return ret;
+    }
+
     if (offset + bytes == bs->total_sectors * BDRV_SECTOR_SIZE) {
         tail = 0;
     }
@@ -4093,6 +4561,11 @@ static coroutine_fn int qcow2_co_pdiscard(BlockDriverState *bs,
         }
     }
 
+    ret = qcow2_co_mark_bitmaps_in_use(bs);
+    if (ret < 0) {
+        return ret;
+    }
+
     qemu_co_mutex_lock(&s->lock);
     ret = qcow2_cluster_discard(bs, offset, bytes, QCOW2_DISCARD_REQUEST,
                                 false);
@@ -4198,6 +4671,11 @@ qcow2_co_copy_range_to(BlockDriverState *bs,
 
     assert(!bs->encrypted);
 
+    ret = qcow2_co_mark_bitmaps_in_use(bs);
+    if (ret < 0) {
+        return ret;
+    }
+
     qemu_co_mutex_lock(&s->lock);
 
     while (bytes != 0) {
@@ -4275,6 +4753,13 @@ qcow2_co_truncate(BlockDriverState *bs, int64_t offset, bool exact,
         return -EINVAL;
     }
 
+    /* Resizing changes the bitmaps, so the stored copies go stale */
+    ret = qcow2_co_mark_bitmaps_in_use(bs);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to mark bitmaps as in use");
+        return ret;
+    }
+
     qemu_co_mutex_lock(&s->lock);
 
     /*
@@ -4396,7 +4881,10 @@ qcow2_co_truncate(BlockDriverState *bs, int64_t offset, bool exact,
         break;
 
     case PREALLOC_MODE_METADATA:
-        ret = preallocate_co(bs, old_length, offset, prealloc, errp);
+        ret = preallocate_bulk_co(bs, old_length, offset, prealloc, errp);
+        if (ret == -ENOTSUP) {
+            ret = preallocate_co(bs, old_length, offset, prealloc, errp);
+        }
         if (ret < 0) {
             goto fail;
         }
@@ -4421,6 +4909,20 @@ qcow2_co_truncate(BlockDriverState *bs, int64_t offset, bool exact,
             break;
         }
 
+        /*
+         * Requests to zero the new area are handled below with zero
+         * clusters, which the bulk path does not set up.
+         */
+        if (!(flags & BDRV_REQ_ZERO_WRITE)) {
+            ret = preallocate_bulk_co(bs, old_length, offset, prealloc, errp);
+            if (ret != -ENOTSUP) {
+                if (ret < 0) {
+                    goto fail;
+                }
+                break;
+            }
+        }
+
         old_file_size = bdrv_co_getlength(bs->file->bs);
         if (old_file_size < 0) {
             error_setg_errno(errp, -old_file_size,
@@ -4458,7 +4960,7 @@ qcow2_co_truncate(BlockDriverState *bs, int64_t offset, bool exact,
         allocation_start = qcow2_refcount_area(bs, old_file_size,
                                                nb_new_data_clusters +
                                                nb_new_l2_tables,
-                                               true, 0, 0);
+                                               true, 0, 0, false);
         if (allocation_start < 0) {
             error_setg_errno(errp, -allocation_start,
                              "Failed to resize refcount structures");
@@ -4741,6 +5243,11 @@ qcow2_co_pwritev_compressed_part(BlockDriverState *bs,
         return -EINVAL;
     }
 
+    ret = qcow2_co_mark_bitmaps_in_use(bs);
+    if (ret < 0) {
+        return ret;
+    }
+
     if (offset_into_cluster(s, bytes) &&
         (offset + bytes) != (bs->total_sectors << BDRV_SECTOR_BITS)) {
         return -EINVAL;
@@ -6111,6 +6618,7 @@ BlockDriver bdrv_qcow2 = {
     .bdrv_co_block_status = qcow2_co_block_status,
 
     .bdrv_co_preadv_part    = qcow2_co_preadv_part,
+    .bdrv_co_preadv_batch   = qcow2_co_preadv_batch,
     .bdrv_co_pwritev_part   = qcow2_co_pwritev_part,
     .bdrv_co_flush_to_os    = qcow2_co_flush_to_os,
 
@@ -6158,6 +6666,8 @@ BlockDriver bdrv_qcow2 = {
     .bdrv_co_can_store_new_dirty_bitmap = qcow2_co_can_store_new_dirty_bitmap,
     .bdrv_co_remove_persistent_dirty_bitmap =
             qcow2_co_remove_persistent_dirty_bitmap,
+    .bdrv_co_mark_persistent_dirty_bitmaps_in_use =
+            qcow2_co_mark_bitmaps_in_use,
 };
 
 static void bdrv_qcow2_init(void)
@@ -150,6 +150,7 @@
 #define QCOW2_OPT_L2_CACHE_ENTRY_SIZE "l2-cache-entry-size"
 #define QCOW2_OPT_REFCOUNT_CACHE_SIZE "refcount-cache-size"
 #define QCOW2_OPT_CACHE_CLEAN_INTERVAL "cache-clean-interval"
+#define QCOW2_OPT_BITMAP_SYNC_INTERVAL "bitmap-sync-interval"
 
 typedef struct QCowHeader {
     uint32_t magic;
@@ -347,6 +348,12 @@ typedef struct BDRVQcow2State {
     Qcow2Cache *refcount_block_cache;
     QEMUTimer *cache_clean_timer;
     unsigned cache_clean_interval;
+    QEMUTimer *bitmap_sync_timer;
+    unsigned bitmap_sync_interval;
+    /* A checkpoint coroutine is running; see bitmap_sync_timer_cb() */
+    bool bitmap_sync_running;
+    /* Persistent bitmaps were checkpointed and are not IN_USE in the image */
+    bool bitmaps_clean;
 
     QLIST_HEAD(, QCowL2Meta) cluster_allocs;
 
@@ -861,7 +868,8 @@ int qcow2_update_cluster_refcount(BlockDriverState *bs, int64_t cluster_index,
 int64_t qcow2_refcount_area(BlockDriverState *bs, uint64_t offset,
                             uint64_t additional_clusters, bool exact_size,
                             int new_refblock_index,
-                            uint64_t new_refblock_offset);
+                            uint64_t new_refblock_offset,
+                            bool allocate_additional);
 
 int64_t qcow2_alloc_clusters(BlockDriverState *bs, uint64_t size);
 int64_t coroutine_fn qcow2_alloc_clusters_at(BlockDriverState *bs, uint64_t offset,
@@ -1003,6 +1011,9 @@ int coroutine_fn qcow2_truncate_bitmaps_check(BlockDriverState *bs, Error **errp
 bool qcow2_store_persistent_dirty_bitmaps(BlockDriverState *bs,
                                           bool release_stored, Error **errp);
 int qcow2_reopen_bitmaps_ro(BlockDriverState *bs, Error **errp);
+int coroutine_fn GRAPH_RDLOCK
+qcow2_co_sync_persistent_dirty_bitmaps(BlockDriverState *bs, Error **errp);
+int coroutine_fn qcow2_co_mark_bitmaps_in_use(BlockDriverState *bs);
 bool coroutine_fn qcow2_co_can_store_new_dirty_bitmap(BlockDriverState *bs,
                                                       const char *name,
                                                       uint32_t granularity,
@@ -218,6 +218,40 @@ raw_co_preadv(BlockDriverState *bs, int64_t offset, int64_t bytes,
     return bdrv_co_preadv(bs->file, offset, bytes, qiov, flags);
 }
 
+static int GRAPH_RDLOCK
+raw_preadv_nowait(BlockDriverState *bs, int64_t offset, int64_t bytes,
+                  QEMUIOVector *qiov)
+{
+    int ret;
+
+    ret = raw_adjust_offset(bs, &offset, bytes, false);
+    if (ret) {
+        return ret;
+    }
+
+    return bdrv_preadv_nowait(bs->file, offset, bytes, qiov);
+}
+
+static int coroutine_fn GRAPH_RDLOCK
+raw_co_preadv_batch(BlockDriverState *bs, BdrvBatchRequest *reqs, int nb_reqs)
+{
+    BDRVRawState *s = bs->opaque;
+    int i;
+
+    /*
+     * The requests don't go past the end of the node, and raw_open() made
+     * sure that offset + size fits in the file, so only shift them.
+     */
+    for (i = 0; i < nb_reqs; i++) {
+        assert(!s->has_size || reqs[i].offset + reqs[i].bytes <= s->size);
+        reqs[i].offset += s->offset;
+    }
+
+    BLKDBG_CO_EVENT(bs->file, BLKDBG_READ_AIO);
+    bdrv_co_preadv_batch(bs->file, reqs, nb_reqs);
+    return 0;
+}
+
 static int coroutine_fn GRAPH_RDLOCK
 raw_co_pwritev(BlockDriverState *bs, int64_t offset, int64_t bytes,
                QEMUIOVector *qiov, BdrvRequestFlags flags)
@@ -400,6 +434,7 @@ raw_co_get_info(BlockDriverState *bs, BlockDriverInfo *bdi)
 static void raw_refresh_limits(BlockDriverState *bs, Error **errp)
 {
     bs->bl.has_variable_length = bs->file->bs->bl.has_variable_length;
+    bs->bl.preadv_nowait = bs->file->bs->bl.preadv_nowait;
 
     if (bs->probed) {
         /* To make it easier to protect the first sector, any probed
@@ -644,6 +679,8 @@ BlockDriver bdrv_raw = {
     .bdrv_child_perm      = raw_child_perm,
     .bdrv_co_create_opts  = &raw_co_create_opts,
     .bdrv_co_preadv       = &raw_co_preadv,
+    .bdrv_co_preadv_batch = &raw_co_preadv_batch,
+    .bdrv_preadv_nowait   = &raw_preadv_nowait,
     .bdrv_co_pwritev      = &raw_co_pwritev,
     .bdrv_co_pwrite_zeroes = &raw_co_pwrite_zeroes,
     .bdrv_co_pdiscard     = &raw_co_pdiscard,
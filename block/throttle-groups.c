@@ -62,6 +62,15 @@ static void timer_cb(ThrottleGroupMember *tgm, bool is_write);
  * blk_set_aio_context()). Therefore in this file a thread will
  * access some other ThrottleGroupMember's timers only after verifying that
  * that ThrottleGroupMember has throttled requests in the queue.
+ *
+ * Taking the lock for every request makes members that run in different
+ * iothreads contend on it. To avoid that, while none of the members is
+ * being throttled each member gets a share of the group's capacity (its
+ * ThrottleCredit), already accounted in the group's ThrottleState, and
+ * spends it without taking the lock. All shares have the same size and
+ * they are taken back as soon as a request would have to wait, so limits
+ * are still enforced group-wide and the round-robin scheduler decides who
+ * goes next once the group is busy.
  */
 struct ThrottleGroup {
     Object parent_obj;
@@ -70,12 +79,14 @@ struct ThrottleGroup {
     bool is_initialized;
     char *name; /* This is constant during the lifetime of the group */
 
-    QemuMutex lock; /* This lock protects the following four fields */
+    QemuMutex lock; /* This lock protects the following fields */
     ThrottleState ts;
     QLIST_HEAD(, ThrottleGroupMember) head;
     ThrottleGroupMember *tokens[2];
     bool any_timer_armed[2];
     QEMUClockType clock_type;
+    unsigned nr_members;
+    unsigned nr_credit_holders;
 
     /* This field is protected by the global QEMU mutex */
     QTAILQ_ENTRY(ThrottleGroup) list;
@@ -254,6 +265,71 @@ static ThrottleGroupMember *next_throttle_token(ThrottleGroupMember *tgm,
     return token;
 }
 
+/* Return the unused credit of a ThrottleGroupMember to its group.
+ *
+ * This assumes that tg->lock is held.
+ *
+ * @tgm:  the ThrottleGroupMember
+ */
+static void throttle_group_release_credit(ThrottleGroupMember *tgm)
+{
+    ThrottleState *ts = tgm->throttle_state;
+    ThrottleGroup *tg = container_of(ts, ThrottleGroup, ts);
+
+    qemu_spin_lock(&tgm->credit_lock);
+    if (tgm->credit.limited) {
+        throttle_credit_release(ts, &tgm->credit);
+        tg->nr_credit_holders--;
+    }
+    qemu_spin_unlock(&tgm->credit_lock);
+}
+
+/* Take back the credit of all members of a group.
+ *
+ * This assumes that tg->lock is held.
+ */
+static void throttle_group_reclaim_credit(ThrottleGroup *tg)
+{
+    ThrottleGroupMember *tgm;
+
+    QLIST_FOREACH(tgm, &tg->head, round_robin) {
+        if (!tg->nr_credit_holders) {
+            break;
+        }
+        throttle_group_release_credit(tgm);
+    }
+}
+
+/* Give a ThrottleGroupMember its share of the group's capacity, unless
+ * some request in the group is being throttled. In that case requests
+ * keep going through the round-robin scheduler.
+ *
+ * This assumes that tg->lock is held.
+ *
+ * @tgm:  the ThrottleGroupMember
+ */
+static void throttle_group_grant_credit(ThrottleGroupMember *tgm)
+{
+    ThrottleState *ts = tgm->throttle_state;
+    ThrottleGroup *tg = container_of(ts, ThrottleGroup, ts);
+    int64_t now;
+
+    if (qatomic_read(&tgm->io_limits_disabled) ||
+        tg->any_timer_armed[0] || tg->any_timer_armed[1] ||
+        tgm->pending_reqs[0] || tgm->pending_reqs[1]) {
+        return;
+    }
+
+    now = qemu_clock_get_ns(tg->clock_type);
+
+    qemu_spin_lock(&tgm->credit_lock);
+    if (!tgm->credit.limited &&
+        throttle_credit_reserve(ts, &tgm->credit, now, tg->nr_members)) {
+        tg->nr_credit_holders++;
+    }
+    qemu_spin_unlock(&tgm->credit_lock);
+}
+
 /* Check if the next I/O request for a ThrottleGroupMember needs to be
  * throttled or not. If there's no timer set in this group, set one and update
  * the token accordingly.
@@ -281,6 +357,13 @@ static bool throttle_group_schedule_timer(ThrottleGroupMember *tgm,
         return true;
     }
 
+    /* Before throttling, take back the capacity handed out to the members
+     * so that the round-robin scheduler can distribute it */
+    if (tg->nr_credit_holders &&
+        throttle_must_wait(ts, tg->clock_type, is_write)) {
+        throttle_group_reclaim_credit(tg);
+    }
+
     must_wait = throttle_schedule_timer(ts, tt, is_write);
 
     /* If a timer just got armed, set tgm as the current token */
@@ -351,7 +434,8 @@ static void schedule_next_request(ThrottleGroupMember *tgm, bool is_write)
 
 /* Check if an I/O request needs to be throttled, wait and set a timer
  * if necessary, and schedule the next request using a round robin
- * algorithm.
+ * algorithm. Requests that fit in the member's credit go through
+ * without taking the group's lock.
  *
  * @tgm:       the current ThrottleGroupMember
  * @bytes:     the number of bytes for this I/O
@@ -367,8 +451,18 @@ void coroutine_fn throttle_group_co_io_limits_intercept(ThrottleGroupMember *tgm
 
     assert(bytes >= 0);
 
+    qemu_spin_lock(&tgm->credit_lock);
+    must_wait = !throttle_credit_consume(&tgm->credit, is_write, bytes);
+    qemu_spin_unlock(&tgm->credit_lock);
+    if (!must_wait) {
+        return;
+    }
+
     qemu_mutex_lock(&tg->lock);
 
+    /* What is left of the credit is not enough, give it back */
+    throttle_group_release_credit(tgm);
+
     /* First we check if this I/O has to be throttled. */
     token = next_throttle_token(tgm, is_write);
     must_wait = throttle_group_schedule_timer(token, is_write);
@@ -391,6 +485,9 @@ void coroutine_fn throttle_group_co_io_limits_intercept(ThrottleGroupMember *tgm
     /* Schedule the next request */
     schedule_next_request(tgm, is_write);
 
+    /* Let the following requests skip the lock if the group is idle */
+    throttle_group_grant_credit(tgm);
+
     qemu_mutex_unlock(&tg->lock);
 }
 
@@ -439,7 +536,8 @@ static void throttle_group_restart_queue(ThrottleGroupMember *tgm, bool is_write
 
     qatomic_inc(&tgm->restart_pending);
 
-    co = qemu_coroutine_create(throttle_group_restart_queue_entry, rd);
+    /* The entry point only wakes up queued requests, they run elsewhere */
+    co = qemu_coroutine_create_small(throttle_group_restart_queue_entry, rd);
     aio_co_enter(tgm->aio_context, co);
 }
 
@@ -474,6 +572,7 @@ void throttle_group_config(ThrottleGroupMember *tgm, ThrottleConfig *cfg)
     ThrottleState *ts = tgm->throttle_state;
     ThrottleGroup *tg = container_of(ts, ThrottleGroup, ts);
     qemu_mutex_lock(&tg->lock);
+    throttle_group_reclaim_credit(tg);
     throttle_config(ts, tg->clock_type, cfg);
     qemu_mutex_unlock(&tg->lock);
 
@@ -558,6 +657,10 @@ void throttle_group_register_tgm(ThrottleGroupMember *tgm,
     }
 
     QLIST_INSERT_HEAD(&tg->head, tgm, round_robin);
+    tg->nr_members++;
+
+    qemu_spin_init(&tgm->credit_lock);
+    memset(&tgm->credit, 0, sizeof(tgm->credit));
 
     throttle_timers_init(&tgm->throttle_timers,
                          tgm->aio_context,
@@ -596,6 +699,8 @@ void throttle_group_unregister_tgm(ThrottleGroupMember *tgm)
     AIO_WAIT_WHILE(tgm->aio_context, qatomic_read(&tgm->restart_pending) > 0);
 
     WITH_QEMU_LOCK_GUARD(&tg->lock) {
+        throttle_group_release_credit(tgm);
+
         for (i = 0; i < 2; i++) {
             assert(tgm->pending_reqs[i] == 0);
             assert(qemu_co_queue_empty(&tgm->throttled_reqs[i]));
@@ -612,9 +717,12 @@ void throttle_group_unregister_tgm(ThrottleGroupMember *tgm)
 
         /* remove the current tgm from the list */
         QLIST_REMOVE(tgm, round_robin);
+        tg->nr_members--;
         throttle_timers_destroy(&tgm->throttle_timers);
     }
 
+    qemu_spin_destroy(&tgm->credit_lock);
+
     throttle_group_unref(&tg->ts);
     tgm->throttle_state = NULL;
 }
@@ -640,6 +748,7 @@ void throttle_group_detach_aio_context(ThrottleGroupMember *tgm)
 
     /* Kick off next ThrottleGroupMember, if necessary */
     WITH_QEMU_LOCK_GUARD(&tg->lock) {
+        throttle_group_release_credit(tgm);
         for (i = 0; i < 2; i++) {
             if (timer_pending(tt->timers[i])) {
                 tg->any_timer_armed[i] = false;
@@ -899,6 +1008,7 @@ static void throttle_group_set_limits(Object *obj, Visitor *v,
     if (local_err) {
         goto unlock;
     }
+    throttle_group_reclaim_credit(tg);
     throttle_config(&tg->ts, tg->clock_type, &cfg);
 
 unlock:
@@ -34,6 +34,18 @@ bool ebpf_rss_set_all(struct EBPFRSSContext *ctx, struct EBPFRSSConfig *config,
     return false;
 }
 
+bool ebpf_rss_has_flow_table(struct EBPFRSSContext *ctx)
+{
+    return false;
+}
+
+bool ebpf_rss_set_flow_table(struct EBPFRSSContext *ctx,
+                             const struct EBPFRSSFlowKey *keys,
+                             const uint16_t *queues, size_t n)
+{
+    return false;
+}
+
 void ebpf_rss_unload(struct EBPFRSSContext *ctx)
 {
 
@@ -65,6 +65,12 @@ bool ebpf_rss_load(struct EBPFRSSContext *ctx)
             rss_bpf_ctx->maps.tap_rss_map_indirection_table);
     ctx->map_toeplitz_key = bpf_map__fd(
             rss_bpf_ctx->maps.tap_rss_map_toeplitz_key);
+    /*
+     * Looked up by name so that a skeleton built from an older rss.bpf.c
+     * still loads, just without flow steering.
+     */
+    ctx->map_flow_table = bpf_object__find_map_fd_by_name(
+            rss_bpf_ctx->obj, "tap_rss_map_flow_table");
 
     return true;
 error:
@@ -154,6 +160,38 @@ bool ebpf_rss_set_all(struct EBPFRSSContext *ctx, struct EBPFRSSConfig *config,
     return true;
 }
 
+bool ebpf_rss_has_flow_table(struct EBPFRSSContext *ctx)
+{
+    return ebpf_rss_is_loaded(ctx) && ctx->map_flow_table >= 0;
+}
+
+bool ebpf_rss_set_flow_table(struct EBPFRSSContext *ctx,
+                             const struct EBPFRSSFlowKey *keys,
+                             const uint16_t *queues, size_t n)
+{
+    struct EBPFRSSFlowKey key;
+    size_t i;
+
+    if (!ebpf_rss_has_flow_table(ctx) || n > EBPF_RSS_MAX_FLOWS) {
+        return false;
+    }
+
+    /* Drop the old entries first; the table is small. */
+    while (bpf_map_get_next_key(ctx->map_flow_table, NULL, &key) == 0) {
+        if (bpf_map_delete_elem(ctx->map_flow_table, &key) < 0) {
+            return false;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (bpf_map_update_elem(ctx->map_flow_table, &keys[i],
+                                &queues[i], 0) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void ebpf_rss_unload(struct EBPFRSSContext *ctx)
 {
     if (!ebpf_rss_is_loaded(ctx)) {
@@ -20,6 +20,7 @@ struct EBPFRSSContext {
     int map_configuration;
     int map_toeplitz_key;
     int map_indirections_table;
+    int map_flow_table;
 };
 
 struct EBPFRSSConfig {
@@ -30,6 +31,23 @@ struct EBPFRSSConfig {
     uint16_t default_queue;
 } __attribute__((packed));
 
+/* Maximum number of entries in the flow steering table */
+#define EBPF_RSS_MAX_FLOWS 1024
+
+/*
+ * Exact-match key of the flow steering table.  Addresses and ports are in
+ * network byte order, IPv4 addresses use the first 4 bytes of @src and @dst.
+ */
+struct EBPFRSSFlowKey {
+    uint8_t src[16];
+    uint8_t dst[16];
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint8_t ip_proto;
+    uint8_t is_ipv6;
+    uint16_t reserved;
+} __attribute__((packed));
+
 void ebpf_rss_init(struct EBPFRSSContext *ctx);
 
 bool ebpf_rss_is_loaded(struct EBPFRSSContext *ctx);
@@ -39,6 +57,12 @@ bool ebpf_rss_load(struct EBPFRSSContext *ctx);
 bool ebpf_rss_set_all(struct EBPFRSSContext *ctx, struct EBPFRSSConfig *config,
                       uint16_t *indirections_table, uint8_t *toeplitz_key);
 
+bool ebpf_rss_has_flow_table(struct EBPFRSSContext *ctx);
+
+bool ebpf_rss_set_flow_table(struct EBPFRSSContext *ctx,
+                             const struct EBPFRSSFlowKey *keys,
+                             const uint16_t *queues, size_t n);
+
 void ebpf_rss_unload(struct EBPFRSSContext *ctx);
 
 #endif /* QEMU_EBPF_RSS_H */
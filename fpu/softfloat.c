@@ -401,6 +401,139 @@ float64_gen2(float64 xa, float64 xb, float_status *s,
     return soft(ua.s, ub.s, s);
 }
 
+/*
+ * Vector flavors of the above. The input preconditions are checked once
+ * for the whole vector; if any element fails them we fall back to the
+ * scalar function for every element. Otherwise the host operation is
+ * applied to a chunk of elements at a time, which the compiler is free
+ * to vectorize, and only the chunks that produce an infinite or tiny
+ * result take the per-element slow path.
+ *
+ * Results go through a temporary so that @d may alias @a or @b, and so
+ * that tiny results can be recomputed in softfloat from the original
+ * inputs.
+ */
+#define HARDFLOAT_VEC_CHUNK 16
+
+typedef float32 (*f32_op2_fn)(float32 a, float32 b, float_status *s);
+typedef float64 (*f64_op2_fn)(float64 a, float64 b, float_status *s);
+
+static inline void
+float32_gen2_vec(float32 *d, const float32 *a, const float32 *b, size_t n,
+                 float_status *s, f32_op2_fn scalar,
+                 hard_f32_op2_fn hard, soft_f32_op2_fn soft,
+                 f32_check_fn pre, f32_check_fn post)
+{
+    size_t i, j;
+
+    if (likely(can_use_fpu(s))) {
+        bool ok = true;
+
+        for (i = 0; i < n; i++) {
+            union_float32 ua = { .s = a[i] };
+            union_float32 ub = { .s = b[i] };
+
+            ok &= pre(ua, ub);
+        }
+        if (likely(ok)) {
+            goto hard;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        d[i] = scalar(a[i], b[i], s);
+    }
+    return;
+
+ hard:
+    for (i = 0; i < n; i += HARDFLOAT_VEC_CHUNK) {
+        size_t len = MIN(n - i, HARDFLOAT_VEC_CHUNK);
+        union_float32 ur[HARDFLOAT_VEC_CHUNK];
+        bool special = false;
+
+        for (j = 0; j < len; j++) {
+            union_float32 ua = { .s = a[i + j] };
+            union_float32 ub = { .s = b[i + j] };
+
+            ur[j].h = hard(ua.h, ub.h);
+            special |= f32_is_inf(ur[j]) | (fabsf(ur[j].h) <= FLT_MIN);
+        }
+        if (unlikely(special)) {
+            for (j = 0; j < len; j++) {
+                union_float32 ua = { .s = a[i + j] };
+                union_float32 ub = { .s = b[i + j] };
+
+                if (f32_is_inf(ur[j])) {
+                    float_raise(float_flag_overflow, s);
+                } else if (fabsf(ur[j].h) <= FLT_MIN && post(ua, ub)) {
+                    ur[j].s = soft(ua.s, ub.s, s);
+                }
+            }
+        }
+        for (j = 0; j < len; j++) {
+            d[i + j] = ur[j].s;
+        }
+    }
+}
+
+static inline void
+float64_gen2_vec(float64 *d, const float64 *a, const float64 *b, size_t n,
+                 float_status *s, f64_op2_fn scalar,
+                 hard_f64_op2_fn hard, soft_f64_op2_fn soft,
+                 f64_check_fn pre, f64_check_fn post)
+{
+    size_t i, j;
+
+    if (likely(can_use_fpu(s))) {
+        bool ok = true;
+
+        for (i = 0; i < n; i++) {
+            union_float64 ua = { .s = a[i] };
+            union_float64 ub = { .s = b[i] };
+
+            ok &= pre(ua, ub);
+        }
+        if (likely(ok)) {
+            goto hard;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        d[i] = scalar(a[i], b[i], s);
+    }
+    return;
+
+ hard:
+    for (i = 0; i < n; i += HARDFLOAT_VEC_CHUNK) {
+        size_t len = MIN(n - i, HARDFLOAT_VEC_CHUNK);
+        union_float64 ur[HARDFLOAT_VEC_CHUNK];
+        bool special = false;
+
+        for (j = 0; j < len; j++) {
+            union_float64 ua = { .s = a[i + j] };
+            union_float64 ub = { .s = b[i + j] };
+
+            ur[j].h = hard(ua.h, ub.h);
+            special |= f64_is_inf(ur[j]) | (fabs(ur[j].h) <= DBL_MIN);
+        }
+        if (unlikely(special)) {
+            for (j = 0; j < len; j++) {
+                union_float64 ua = { .s = a[i + j] };
+                union_float64 ub = { .s = b[i + j] };
+
+                if (f64_is_inf(ur[j])) {
+                    float_raise(float_flag_overflow, s);
+                } else if (fabs(ur[j].h) <= DBL_MIN && post(ua, ub)) {
+                    ur[j].s = soft(ua.s, ub.s, s);
+                }
+            }
+        }
+        for (j = 0; j < len; j++) {
+            d[i + j] = ur[j].s;
+        }
+    }
+}
+
 /*
  * Classify a floating point number. Everything above float_class_qnan
  * is a NaN so cls >= float_class_qnan is any NaN.
@@ -1999,6 +2132,38 @@ float64_sub(float64 a, float64 b, float_status *s)
     return float64_addsub(a, b, s, hard_f64_sub, soft_f64_sub);
 }
 
+void QEMU_FLATTEN
+float32_add_vec(float32 *d, const float32 *a, const float32 *b, size_t n,
+                float_status *s)
+{
+    float32_gen2_vec(d, a, b, n, s, float32_add, hard_f32_add, soft_f32_add,
+                     f32_is_zon2, f32_addsubmul_post);
+}
+
+void QEMU_FLATTEN
+float32_sub_vec(float32 *d, const float32 *a, const float32 *b, size_t n,
+                float_status *s)
+{
+    float32_gen2_vec(d, a, b, n, s, float32_sub, hard_f32_sub, soft_f32_sub,
+                     f32_is_zon2, f32_addsubmul_post);
+}
+
+void QEMU_FLATTEN
+float64_add_vec(float64 *d, const float64 *a, const float64 *b, size_t n,
+                float_status *s)
+{
+    float64_gen2_vec(d, a, b, n, s, float64_add, hard_f64_add, soft_f64_add,
+                     f64_is_zon2, f64_addsubmul_post);
+}
+
+void QEMU_FLATTEN
+float64_sub_vec(float64 *d, const float64 *a, const float64 *b, size_t n,
+                float_status *s)
+{
+    float64_gen2_vec(d, a, b, n, s, float64_sub, hard_f64_sub, soft_f64_sub,
+                     f64_is_zon2, f64_addsubmul_post);
+}
+
 static float64 float64r32_addsub(float64 a, float64 b, float_status *status,
                                  bool subtract)
 {
@@ -2152,6 +2317,22 @@ float64_mul(float64 a, float64 b, float_status *s)
                         f64_is_zon2, f64_addsubmul_post);
 }
 
+void QEMU_FLATTEN
+float32_mul_vec(float32 *d, const float32 *a, const float32 *b, size_t n,
+                float_status *s)
+{
+    float32_gen2_vec(d, a, b, n, s, float32_mul, hard_f32_mul, soft_f32_mul,
+                     f32_is_zon2, f32_addsubmul_post);
+}
+
+void QEMU_FLATTEN
+float64_mul_vec(float64 *d, const float64 *a, const float64 *b, size_t n,
+                float_status *s)
+{
+    float64_gen2_vec(d, a, b, n, s, float64_mul, hard_f64_mul, soft_f64_mul,
+                     f64_is_zon2, f64_addsubmul_post);
+}
+
 float64 float64r32_mul(float64 a, float64 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
@@ -2526,6 +2707,22 @@ float64_div(float64 a, float64 b, float_status *s)
                         f64_div_pre, f64_div_post);
 }
 
+void QEMU_FLATTEN
+float32_div_vec(float32 *d, const float32 *a, const float32 *b, size_t n,
+                float_status *s)
+{
+    float32_gen2_vec(d, a, b, n, s, float32_div, hard_f32_div, soft_f32_div,
+                     f32_div_pre, f32_div_post);
+}
+
+void QEMU_FLATTEN
+float64_div_vec(float64 *d, const float64 *a, const float64 *b, size_t n,
+                float_status *s)
+{
+    float64_gen2_vec(d, a, b, n, s, float64_div, hard_f64_div, soft_f64_div,
+                     f64_div_pre, f64_div_post);
+}
+
 float64 float64r32_div(float64 a, float64 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
@@ -56,6 +56,10 @@
 
 #define E1000E_MAX_TX_FRAGS (64)
 
+/* Maximum number of descriptors moved with a single DMA access */
+#define E1000E_TX_DESC_BATCH (32)
+#define E1000E_RX_DESC_BATCH (16)
+
 union e1000_rx_desc_union {
     struct e1000_rx_desc legacy;
     union e1000_rx_desc_extended extended;
@@ -789,24 +793,42 @@ e1000e_rx_wb_interrupt_cause(E1000ECore *core, int queue_idx,
     return (queue_idx == 0) ? E1000_ICR_RXQ0 : E1000_ICR_RXQ1;
 }
 
+/*
+ * Write back the @count descriptors that were processed from @base.  The
+ * range from the first to the last descriptor that reports status goes out
+ * in one DMA access; descriptors in between are written back unchanged.
+ */
 static uint32_t
 e1000e_txdesc_writeback(E1000ECore *core, dma_addr_t base,
-                        struct e1000_tx_desc *dp, bool *ide, int queue_idx)
+                        struct e1000_tx_desc *dp, uint32_t count,
+                        bool *ide, int queue_idx)
 {
-    uint32_t txd_upper, txd_lower = le32_to_cpu(dp->lower.data);
+    uint32_t txd_upper, txd_lower;
+    uint32_t i, first = count, last = 0;
 
-    if (!(txd_lower & E1000_TXD_CMD_RS) &&
-        !(core->mac[IVAR] & E1000_IVAR_TX_INT_EVERY_WB)) {
-        return 0;
-    }
+    for (i = 0; i < count; i++) {
+        txd_lower = le32_to_cpu(dp[i].lower.data);
+
+        if (!(txd_lower & E1000_TXD_CMD_RS) &&
+            !(core->mac[IVAR] & E1000_IVAR_TX_INT_EVERY_WB)) {
+            continue;
+        }
+
+        *ide = (txd_lower & E1000_TXD_CMD_IDE) ? true : false;
 
-    *ide = (txd_lower & E1000_TXD_CMD_IDE) ? true : false;
+        txd_upper = le32_to_cpu(dp[i].upper.data) | E1000_TXD_STAT_DD;
+        dp[i].upper.data = cpu_to_le32(txd_upper);
 
-    txd_upper = le32_to_cpu(dp->upper.data) | E1000_TXD_STAT_DD;
+        first = MIN(first, i);
+        last = i;
+    }
 
-    dp->upper.data = cpu_to_le32(txd_upper);
-    pci_dma_write(core->owner, base + ((char *)&dp->upper - (char *)dp),
-                  &dp->upper, sizeof(dp->upper));
+    if (first == count) {
+        return 0;
+    }
+
+    pci_dma_write(core->owner, base + first * sizeof(*dp), &dp[first],
+                  (last - first + 1) * sizeof(*dp));
     return e1000e_tx_wb_interrupt_cause(core, queue_idx);
 }
 
@@ -841,6 +863,20 @@ e1000e_ring_head_descr(E1000ECore *core, const E1000E_RingInfo *r)
     return e1000e_ring_base(core, r) + E1000_RING_DESC_LEN * core->mac[r->dh];
 }
 
+/* Number of descriptors from the head to the tail or to the end of the ring */
+static inline uint32_t
+e1000e_ring_contig_descr_num(E1000ECore *core, const E1000E_RingInfo *r)
+{
+    uint32_t dh = core->mac[r->dh];
+    uint32_t dt = core->mac[r->dt];
+    uint32_t len = core->mac[r->dlen] / E1000_RING_DESC_LEN;
+
+    if (dh < dt) {
+        return dt - dh;
+    }
+    return dh < len ? len - dh : 1;
+}
+
 static inline void
 e1000e_ring_advance(E1000ECore *core, const E1000E_RingInfo *r, uint32_t count)
 {
@@ -928,10 +964,11 @@ static void
 e1000e_start_xmit(E1000ECore *core, const E1000E_TxRing *txr)
 {
     dma_addr_t base;
-    struct e1000_tx_desc desc;
+    struct e1000_tx_desc desc[E1000E_TX_DESC_BATCH];
     bool ide = false;
     const E1000E_RingInfo *txi = txr->i;
     uint32_t cause = E1000_ICS_TXQE;
+    uint32_t i, n;
 
     if (!(core->mac[TCTL] & E1000_TCTL_EN)) {
         trace_e1000e_tx_disabled();
@@ -940,16 +977,18 @@ e1000e_start_xmit(E1000ECore *core, const E1000E_TxRing *txr)
 
     while (!e1000e_ring_empty(core, txi)) {
         base = e1000e_ring_head_descr(core, txi);
+        n = MIN(e1000e_ring_contig_descr_num(core, txi), E1000E_TX_DESC_BATCH);
 
-        pci_dma_read(core->owner, base, &desc, sizeof(desc));
-
-        trace_e1000e_tx_descr((void *)(intptr_t)desc.buffer_addr,
-                              desc.lower.data, desc.upper.data);
+        pci_dma_read(core->owner, base, desc, n * sizeof(desc[0]));
 
-        e1000e_process_tx_desc(core, txr->tx, &desc, txi->idx);
-        cause |= e1000e_txdesc_writeback(core, base, &desc, &ide, txi->idx);
+        for (i = 0; i < n; i++) {
+            trace_e1000e_tx_descr((void *)(intptr_t)desc[i].buffer_addr,
+                                  desc[i].lower.data, desc[i].upper.data);
 
-        e1000e_ring_advance(core, txi, 1);
+            e1000e_process_tx_desc(core, txr->tx, &desc[i], txi->idx);
+            e1000e_ring_advance(core, txi, 1);
+        }
+        cause |= e1000e_txdesc_writeback(core, base, desc, n, &ide, txi->idx);
     }
 
     if (!ide || !e1000e_intrmgr_delay_tx_causes(core, &cause)) {
@@ -1348,53 +1387,68 @@ struct NetRxPkt *pkt, const E1000E_RSSInfo *rss_info,
     }
 }
 
-static inline void
-e1000e_pci_dma_write_rx_desc(E1000ECore *core, dma_addr_t addr,
-                             union e1000_rx_desc_union *desc, dma_addr_t len)
+static inline uint32_t
+e1000e_rx_desc_get_status(E1000ECore *core, union e1000_rx_desc_union *desc)
 {
-    PCIDevice *dev = core->owner;
-
     if (e1000e_rx_use_legacy_descriptor(core)) {
-        struct e1000_rx_desc *d = &desc->legacy;
-        size_t offset = offsetof(struct e1000_rx_desc, status);
-        uint8_t status = d->status;
-
-        d->status &= ~E1000_RXD_STAT_DD;
-        pci_dma_write(dev, addr, desc, len);
+        return desc->legacy.status;
+    } else if (core->mac[RCTL] & E1000_RCTL_DTYP_PS) {
+        return desc->packet_split.wb.middle.status_error;
+    } else {
+        return desc->extended.wb.upper.status_error;
+    }
+}
 
-        if (status & E1000_RXD_STAT_DD) {
-            d->status = status;
-            pci_dma_write(dev, addr + offset, &status, sizeof(status));
-        }
+static inline void
+e1000e_rx_desc_set_status(E1000ECore *core, union e1000_rx_desc_union *desc,
+                          uint32_t status)
+{
+    if (e1000e_rx_use_legacy_descriptor(core)) {
+        desc->legacy.status = status;
+    } else if (core->mac[RCTL] & E1000_RCTL_DTYP_PS) {
+        desc->packet_split.wb.middle.status_error = status;
     } else {
-        if (core->mac[RCTL] & E1000_RCTL_DTYP_PS) {
-            union e1000_rx_desc_packet_split *d = &desc->packet_split;
-            size_t offset = offsetof(union e1000_rx_desc_packet_split,
-                wb.middle.status_error);
-            uint32_t status = d->wb.middle.status_error;
+        desc->extended.wb.upper.status_error = status;
+    }
+}
+
+/*
+ * Write back @count consecutive RX descriptors starting at @addr.  The
+ * descriptors first go out with DD clear; if any of them completes, the
+ * whole block is written again.  Only the DD bits change in the second
+ * write, so the guest never sees DD on a partially written descriptor.
+ */
+static void
+e1000e_pci_dma_write_rx_descs(E1000ECore *core, dma_addr_t addr,
+                              union e1000_rx_desc_union *desc, uint32_t count)
+{
+    uint8_t buf[E1000E_RX_DESC_BATCH * sizeof(union e1000_rx_desc_union)];
+    uint32_t status[E1000E_RX_DESC_BATCH];
+    PCIDevice *dev = core->owner;
+    size_t len = core->rx_desc_len;
+    bool dd = false;
+    uint32_t i;
 
-            d->wb.middle.status_error &= ~E1000_RXD_STAT_DD;
-            pci_dma_write(dev, addr, desc, len);
+    assert(count <= E1000E_RX_DESC_BATCH && len <= sizeof(*desc));
 
-            if (status & E1000_RXD_STAT_DD) {
-                d->wb.middle.status_error = status;
-                pci_dma_write(dev, addr + offset, &status, sizeof(status));
-            }
-        } else {
-            union e1000_rx_desc_extended *d = &desc->extended;
-            size_t offset = offsetof(union e1000_rx_desc_extended,
-                wb.upper.status_error);
-            uint32_t status = d->wb.upper.status_error;
+    for (i = 0; i < count; i++) {
+        status[i] = e1000e_rx_desc_get_status(core, &desc[i]);
+        dd |= status[i] & E1000_RXD_STAT_DD;
+        e1000e_rx_desc_set_status(core, &desc[i],
+                                  status[i] & ~E1000_RXD_STAT_DD);
+        memcpy(buf + i * len, &desc[i], len);
+    }
+    pci_dma_write(dev, addr, buf, count * len);
 
-            d->wb.upper.status_error &= ~E1000_RXD_STAT_DD;
-            pci_dma_write(dev, addr, desc, len);
+    if (!dd) {
+        return;
+    }
 
-            if (status & E1000_RXD_STAT_DD) {
-                d->wb.upper.status_error = status;
-                pci_dma_write(dev, addr + offset, &status, sizeof(status));
-            }
-        }
+    for (i = 0; i < count; i++) {
+        e1000e_rx_desc_set_status(core, &desc[i], status[i]);
+        memcpy(buf + i * len, &desc[i], len);
     }
+    pci_dma_write(dev, addr, buf, count * len);
 }
 
 typedef struct e1000e_ba_state_st {
@@ -1512,8 +1566,9 @@ e1000e_write_packet_to_guest(E1000ECore *core, struct NetRxPkt *pkt,
                              const E1000E_RSSInfo *rss_info)
 {
     PCIDevice *d = core->owner;
-    dma_addr_t base;
-    union e1000_rx_desc_union desc;
+    dma_addr_t base, batch_base = 0;
+    union e1000_rx_desc_union desc[E1000E_RX_DESC_BATCH];
+    uint32_t n = 0;
     size_t desc_size;
     size_t desc_offset = 0;
     size_t iov_ofs = 0;
@@ -1540,16 +1595,22 @@ e1000e_write_packet_to_guest(E1000ECore *core, struct NetRxPkt *pkt,
         }
 
         if (e1000e_ring_empty(core, rxi)) {
+            if (n) {
+                e1000e_pci_dma_write_rx_descs(core, batch_base, desc, n);
+            }
             return;
         }
 
         base = e1000e_ring_head_descr(core, rxi);
+        if (!n) {
+            batch_base = base;
+        }
 
-        pci_dma_read(d, base, &desc, core->rx_desc_len);
+        pci_dma_read(d, base, &desc[n], core->rx_desc_len);
 
         trace_e1000e_rx_descr(rxi->idx, base, core->rx_desc_len);
 
-        e1000e_read_rx_descr(core, &desc, ba);
+        e1000e_read_rx_descr(core, &desc[n], ba);
 
         if (ba[0]) {
             if (desc_offset < size) {
@@ -1619,13 +1680,18 @@ e1000e_write_packet_to_guest(E1000ECore *core, struct NetRxPkt *pkt,
             is_last = true;
         }
 
-        e1000e_write_rx_descr(core, &desc, is_last ? core->rx_pkt : NULL,
+        e1000e_write_rx_descr(core, &desc[n], is_last ? core->rx_pkt : NULL,
                            rss_info, do_ps ? ps_hdr_len : 0, &bastate.written);
-        e1000e_pci_dma_write_rx_desc(core, base, &desc, core->rx_desc_len);
+        n++;
 
         e1000e_ring_advance(core, rxi,
                             core->rx_desc_len / E1000_MIN_RX_DESC_LEN);
 
+        /* Write back once per packet, or when the batch cannot grow. */
+        if (is_last || n == E1000E_RX_DESC_BATCH || core->mac[rxi->dh] == 0) {
+            e1000e_pci_dma_write_rx_descs(core, batch_base, desc, n);
+            n = 0;
+        }
     } while (desc_offset < total_size);
 
     e1000e_update_rx_stats(core, size, total_size);
@@ -57,6 +57,10 @@
 
 #define E1000E_MAX_TX_FRAGS (64)
 
+/* Maximum number of descriptors moved with a single DMA access */
+#define IGB_TX_DESC_BATCH   (32)
+#define IGB_RX_DESC_BATCH   (16)
+
 union e1000_rx_desc_union {
     struct e1000_rx_desc legacy;
     union e1000_adv_rx_desc adv;
@@ -512,6 +516,62 @@ static void igb_tx_pkt_vmdq_callback(void *opaque,
     }
 }
 
+/* Pools whose receive address registers match @dest */
+static uint16_t igb_ra_pools(IGBCore *core, const uint8_t *dest)
+{
+    uint32_t ra[2], *macp;
+    uint16_t pools = 0;
+
+    for (macp = core->mac + RA; macp < core->mac + RA + 32; macp += 2) {
+        if (!(macp[1] & E1000_RAH_AV)) {
+            continue;
+        }
+        ra[0] = cpu_to_le32(macp[0]);
+        ra[1] = cpu_to_le32(macp[1]);
+        if (!memcmp(dest, (uint8_t *)ra, ETH_ALEN)) {
+            pools |= (macp[1] & E1000_RAH_POOL_MASK) / E1000_RAH_POOL_1;
+        }
+    }
+
+    for (macp = core->mac + RA2; macp < core->mac + RA2 + 16; macp += 2) {
+        if (!(macp[1] & E1000_RAH_AV)) {
+            continue;
+        }
+        ra[0] = cpu_to_le32(macp[0]);
+        ra[1] = cpu_to_le32(macp[1]);
+        if (!memcmp(dest, (uint8_t *)ra, ETH_ALEN)) {
+            pools |= (macp[1] & E1000_RAH_POOL_MASK) / E1000_RAH_POOL_1;
+        }
+    }
+
+    return pools;
+}
+
+/* Check @dest against the multicast or unicast hash table @table */
+static bool igb_ta_match(IGBCore *core, const uint32_t *table,
+                         const uint8_t *dest)
+{
+    static const int ta_shift[] = { 4, 3, 2, 0 };
+    uint32_t f;
+
+    f = ta_shift[(core->mac[RCTL] >> E1000_RCTL_MO_SHIFT) & 3];
+    f = (((dest[5] << 8) | dest[4]) >> f) & 0xfff;
+    return table[f >> 5] & (1 << (f & 0x1f));
+}
+
+/*
+ * A unicast packet that matches neither a pool address nor the unicast hash
+ * table is not switched to any local pool.
+ */
+static bool igb_tx_pkt_is_external(IGBCore *core, struct NetTxPkt *tx_pkt)
+{
+    const struct eth_header *ehdr = net_tx_pkt_get_eth_hdr(tx_pkt);
+
+    return net_tx_pkt_get_packet_type(tx_pkt) == ETH_PKT_UCAST &&
+           !igb_ra_pools(core, ehdr->h_dest) &&
+           !igb_ta_match(core, core->mac + UTA, ehdr->h_dest);
+}
+
 /* TX Packets Switching (7.10.3.6) */
 static bool igb_tx_pkt_switch(IGBCore *core, struct igb_tx *tx,
                               NetClientState *nc)
@@ -528,6 +588,14 @@ static bool igb_tx_pkt_switch(IGBCore *core, struct igb_tx *tx,
         goto send_out;
     }
 
+    /*
+     * Packets that only leave the port can keep their GSO request for the
+     * backend instead of being segmented for the switching callback.
+     */
+    if (igb_tx_pkt_is_external(core, tx->tx_pkt)) {
+        goto send_out;
+    }
+
     context.core = core;
     context.nc = nc;
 
@@ -735,6 +803,20 @@ igb_ring_advance(IGBCore *core, const E1000E_RingInfo *r, uint32_t count)
     }
 }
 
+/* Number of descriptors from the head to the tail or to the end of the ring */
+static inline uint32_t
+igb_ring_contig_descr_num(IGBCore *core, const E1000E_RingInfo *r)
+{
+    uint32_t dh = core->mac[r->dh];
+    uint32_t dt = core->mac[r->dt];
+    uint32_t len = core->mac[r->dlen] / E1000_RING_DESC_LEN;
+
+    if (dh < dt) {
+        return dt - dh;
+    }
+    return dh < len ? len - dh : 1;
+}
+
 static inline uint32_t
 igb_ring_free_descr_num(IGBCore *core, const E1000E_RingInfo *r)
 {
@@ -830,36 +912,50 @@ igb_rx_ring_init(IGBCore *core, E1000E_RxRing *rxr, int idx)
     rxr->i      = &i[idx];
 }
 
+/*
+ * Write back the @count descriptors that were processed from @base.  With
+ * descriptor write-back, the range from the first to the last descriptor
+ * with RS set goes out in one DMA access; descriptors in between are
+ * written back unchanged.  With head write-back, only the final head is
+ * reported.
+ */
 static uint32_t
-igb_txdesc_writeback(IGBCore *core, dma_addr_t base,
-                     union e1000_adv_tx_desc *tx_desc,
+igb_txdesc_writeback(IGBCore *core, PCIDevice *d, dma_addr_t base,
+                     union e1000_adv_tx_desc *tx_desc, uint32_t count,
                      const E1000E_RingInfo *txi)
 {
-    PCIDevice *d;
-    uint32_t cmd_type_len = le32_to_cpu(tx_desc->read.cmd_type_len);
+    uint32_t cmd_type_len, status;
+    uint32_t i, first = count, last = 0;
     uint64_t tdwba;
 
-    tdwba = core->mac[E1000_TDWBAL(txi->idx) >> 2];
-    tdwba |= (uint64_t)core->mac[E1000_TDWBAH(txi->idx) >> 2] << 32;
+    for (i = 0; i < count; i++) {
+        cmd_type_len = le32_to_cpu(tx_desc[i].read.cmd_type_len);
+        if (cmd_type_len & E1000_TXD_CMD_RS) {
+            first = MIN(first, i);
+            last = i;
+        }
+    }
 
-    if (!(cmd_type_len & E1000_TXD_CMD_RS)) {
+    if (first == count) {
         return 0;
     }
 
-    d = pcie_sriov_get_vf_at_index(core->owner, txi->idx % 8);
-    if (!d) {
-        d = core->owner;
-    }
+    tdwba = core->mac[E1000_TDWBAL(txi->idx) >> 2];
+    tdwba |= (uint64_t)core->mac[E1000_TDWBAH(txi->idx) >> 2] << 32;
 
     if (tdwba & 1) {
         uint32_t buffer = cpu_to_le32(core->mac[txi->dh]);
         pci_dma_write(d, tdwba & ~3, &buffer, sizeof(buffer));
     } else {
-        uint32_t status = le32_to_cpu(tx_desc->wb.status) | E1000_TXD_STAT_DD;
-
-        tx_desc->wb.status = cpu_to_le32(status);
-        pci_dma_write(d, base + offsetof(union e1000_adv_tx_desc, wb),
-            &tx_desc->wb, sizeof(tx_desc->wb));
+        for (i = first; i <= last; i++) {
+            cmd_type_len = le32_to_cpu(tx_desc[i].read.cmd_type_len);
+            if (cmd_type_len & E1000_TXD_CMD_RS) {
+                status = le32_to_cpu(tx_desc[i].wb.status) | E1000_TXD_STAT_DD;
+                tx_desc[i].wb.status = cpu_to_le32(status);
+            }
+        }
+        pci_dma_write(d, base + first * sizeof(*tx_desc), &tx_desc[first],
+                      (last - first + 1) * sizeof(*tx_desc));
     }
 
     return igb_tx_wb_eic(core, txi->idx);
@@ -882,9 +978,10 @@ igb_start_xmit(IGBCore *core, const IGB_TxRing *txr)
 {
     PCIDevice *d;
     dma_addr_t base;
-    union e1000_adv_tx_desc desc;
+    union e1000_adv_tx_desc desc[IGB_TX_DESC_BATCH];
     const E1000E_RingInfo *txi = txr->i;
     uint32_t eic = 0;
+    uint32_t i, n;
 
     if (!igb_tx_enabled(core, txi)) {
         trace_e1000e_tx_disabled();
@@ -898,15 +995,19 @@ igb_start_xmit(IGBCore *core, const IGB_TxRing *txr)
 
     while (!igb_ring_empty(core, txi)) {
         base = igb_ring_head_descr(core, txi);
+        n = MIN(igb_ring_contig_descr_num(core, txi), IGB_TX_DESC_BATCH);
 
-        pci_dma_read(d, base, &desc, sizeof(desc));
+        pci_dma_read(d, base, desc, n * sizeof(desc[0]));
 
-        trace_e1000e_tx_descr((void *)(intptr_t)desc.read.buffer_addr,
-                              desc.read.cmd_type_len, desc.wb.status);
+        for (i = 0; i < n; i++) {
+            trace_e1000e_tx_descr((void *)(intptr_t)desc[i].read.buffer_addr,
+                                  desc[i].read.cmd_type_len,
+                                  desc[i].wb.status);
 
-        igb_process_tx_desc(core, d, txr->tx, &desc, txi->idx);
-        igb_ring_advance(core, txi, 1);
-        eic |= igb_txdesc_writeback(core, base, &desc, txi);
+            igb_process_tx_desc(core, d, txr->tx, &desc[i], txi->idx);
+            igb_ring_advance(core, txi, 1);
+        }
+        eic |= igb_txdesc_writeback(core, d, base, desc, n, txi);
     }
 
     if (eic) {
@@ -1017,9 +1118,8 @@ static uint16_t igb_receive_assign(IGBCore *core, const struct iovec *iov,
                                    E1000E_RSSInfo *rss_info,
                                    uint16_t *etqf, bool *ts, bool *external_tx)
 {
-    static const int ta_shift[] = { 4, 3, 2, 0 };
     const struct eth_header *ehdr = &l2_header->eth;
-    uint32_t f, ra[2], *macp, rctl = core->mac[RCTL];
+    uint32_t ra[2], *macp;
     uint16_t queues = 0;
     uint16_t oversized = 0;
     size_t vlan_num = 0;
@@ -1087,34 +1187,12 @@ static uint16_t igb_receive_assign(IGBCore *core, const struct iovec *iov,
                 }
             }
         } else {
-            for (macp = core->mac + RA; macp < core->mac + RA + 32; macp += 2) {
-                if (!(macp[1] & E1000_RAH_AV)) {
-                    continue;
-                }
-                ra[0] = cpu_to_le32(macp[0]);
-                ra[1] = cpu_to_le32(macp[1]);
-                if (!memcmp(ehdr->h_dest, (uint8_t *)ra, ETH_ALEN)) {
-                    queues |= (macp[1] & E1000_RAH_POOL_MASK) / E1000_RAH_POOL_1;
-                }
-            }
-
-            for (macp = core->mac + RA2; macp < core->mac + RA2 + 16; macp += 2) {
-                if (!(macp[1] & E1000_RAH_AV)) {
-                    continue;
-                }
-                ra[0] = cpu_to_le32(macp[0]);
-                ra[1] = cpu_to_le32(macp[1]);
-                if (!memcmp(ehdr->h_dest, (uint8_t *)ra, ETH_ALEN)) {
-                    queues |= (macp[1] & E1000_RAH_POOL_MASK) / E1000_RAH_POOL_1;
-                }
-            }
+            queues = igb_ra_pools(core, ehdr->h_dest);
 
             if (!queues) {
                 macp = core->mac + (is_multicast_ether_addr(ehdr->h_dest) ? MTA : UTA);
 
-                f = ta_shift[(rctl >> E1000_RCTL_MO_SHIFT) & 3];
-                f = (((ehdr->h_dest[5] << 8) | ehdr->h_dest[4]) >> f) & 0xfff;
-                if (macp[f >> 5] & (1 << (f & 0x1f))) {
+                if (igb_ta_match(core, macp, ehdr->h_dest)) {
                     for (i = 0; i < IGB_NUM_VM_POOLS; i++) {
                         if (core->mac[VMOLR0 + i] & E1000_VMOLR_ROMPE) {
                             queues |= BIT(i);
@@ -1481,36 +1559,63 @@ igb_write_rx_descr(IGBCore *core, union e1000_rx_desc_union *desc,
     }
 }
 
+static inline uint32_t
+igb_rx_desc_get_status(IGBCore *core, union e1000_rx_desc_union *desc)
+{
+    if (igb_rx_use_legacy_descriptor(core)) {
+        return desc->legacy.status;
+    }
+    return desc->adv.wb.upper.status_error;
+}
+
 static inline void
-igb_pci_dma_write_rx_desc(IGBCore *core, PCIDevice *dev, dma_addr_t addr,
-                          union e1000_rx_desc_union *desc, dma_addr_t len)
+igb_rx_desc_set_status(IGBCore *core, union e1000_rx_desc_union *desc,
+                       uint32_t status)
 {
     if (igb_rx_use_legacy_descriptor(core)) {
-        struct e1000_rx_desc *d = &desc->legacy;
-        size_t offset = offsetof(struct e1000_rx_desc, status);
-        uint8_t status = d->status;
+        desc->legacy.status = status;
+    } else {
+        desc->adv.wb.upper.status_error = status;
+    }
+}
+
+/*
+ * Write back @count consecutive RX descriptors starting at @addr.  The
+ * descriptors first go out with DD clear; if any of them completes, the
+ * whole block is written again with DD set.  The second write only changes
+ * the DD bits, so the guest never sees DD on a partially written
+ * descriptor, and it takes two DMA accesses however many descriptors the
+ * packet used.
+ */
+static void
+igb_pci_dma_write_rx_descs(IGBCore *core, PCIDevice *dev, dma_addr_t addr,
+                           union e1000_rx_desc_union *desc, uint32_t count)
+{
+    uint8_t buf[IGB_RX_DESC_BATCH * sizeof(union e1000_rx_desc_union)];
+    uint32_t status[IGB_RX_DESC_BATCH];
+    size_t len = core->rx_desc_len;
+    bool dd = false;
+    uint32_t i;
 
-        d->status &= ~E1000_RXD_STAT_DD;
-        pci_dma_write(dev, addr, desc, len);
+    assert(count <= IGB_RX_DESC_BATCH && len <= sizeof(*desc));
 
-        if (status & E1000_RXD_STAT_DD) {
-            d->status = status;
-            pci_dma_write(dev, addr + offset, &status, sizeof(status));
-        }
-    } else {
-        union e1000_adv_rx_desc *d = &desc->adv;
-        size_t offset =
-            offsetof(union e1000_adv_rx_desc, wb.upper.status_error);
-        uint32_t status = d->wb.upper.status_error;
+    for (i = 0; i < count; i++) {
+        status[i] = igb_rx_desc_get_status(core, &desc[i]);
+        dd |= status[i] & E1000_RXD_STAT_DD;
+        igb_rx_desc_set_status(core, &desc[i], status[i] & ~E1000_RXD_STAT_DD);
+        memcpy(buf + i * len, &desc[i], len);
+    }
+    pci_dma_write(dev, addr, buf, count * len);
 
-        d->wb.upper.status_error &= ~E1000_RXD_STAT_DD;
-        pci_dma_write(dev, addr, desc, len);
+    if (!dd) {
+        return;
+    }
 
-        if (status & E1000_RXD_STAT_DD) {
-            d->wb.upper.status_error = status;
-            pci_dma_write(dev, addr + offset, &status, sizeof(status));
-        }
+    for (i = 0; i < count; i++) {
+        igb_rx_desc_set_status(core, &desc[i], status[i]);
+        memcpy(buf + i * len, &desc[i], len);
     }
+    pci_dma_write(dev, addr, buf, count * len);
 }
 
 static void
@@ -1558,8 +1663,9 @@ igb_write_packet_to_guest(IGBCore *core, struct NetRxPkt *pkt,
                           uint16_t etqf, bool ts)
 {
     PCIDevice *d;
-    dma_addr_t base;
-    union e1000_rx_desc_union desc;
+    dma_addr_t base, batch_base = 0;
+    union e1000_rx_desc_union desc[IGB_RX_DESC_BATCH];
+    uint32_t n = 0;
     size_t desc_size;
     size_t desc_offset = 0;
     size_t iov_ofs = 0;
@@ -1587,16 +1693,22 @@ igb_write_packet_to_guest(IGBCore *core, struct NetRxPkt *pkt,
         }
 
         if (igb_ring_empty(core, rxi)) {
+            if (n) {
+                igb_pci_dma_write_rx_descs(core, d, batch_base, desc, n);
+            }
             return;
         }
 
         base = igb_ring_head_descr(core, rxi);
+        if (!n) {
+            batch_base = base;
+        }
 
-        pci_dma_read(d, base, &desc, core->rx_desc_len);
+        pci_dma_read(d, base, &desc[n], core->rx_desc_len);
 
         trace_e1000e_rx_descr(rxi->idx, base, core->rx_desc_len);
 
-        igb_read_rx_descr(core, &desc, &ba);
+        igb_read_rx_descr(core, &desc[n], &ba);
 
         if (ba) {
             if (desc_offset < size) {
@@ -1636,12 +1748,17 @@ igb_write_packet_to_guest(IGBCore *core, struct NetRxPkt *pkt,
             is_last = true;
         }
 
-        igb_write_rx_descr(core, &desc, is_last ? core->rx_pkt : NULL,
+        igb_write_rx_descr(core, &desc[n], is_last ? core->rx_pkt : NULL,
                            rss_info, etqf, ts, written);
-        igb_pci_dma_write_rx_desc(core, d, base, &desc, core->rx_desc_len);
+        n++;
 
         igb_ring_advance(core, rxi, core->rx_desc_len / E1000_MIN_RX_DESC_LEN);
 
+        /* Write back once per packet, or when the batch cannot grow. */
+        if (is_last || n == IGB_RX_DESC_BATCH || core->mac[rxi->dh] == 0) {
+            igb_pci_dma_write_rx_descs(core, d, batch_base, desc, n);
+            n = 0;
+        }
     } while (desc_offset < total_size);
 
     igb_update_rx_stats(core, rxi, size, total_size);
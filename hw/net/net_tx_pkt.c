@@ -417,6 +417,13 @@ bool net_tx_pkt_has_fragments(struct NetTxPkt *pkt)
     return pkt->raw_frags > 0;
 }
 
+const struct eth_header *net_tx_pkt_get_eth_hdr(struct NetTxPkt *pkt)
+{
+    assert(pkt);
+
+    return &pkt->l2_hdr.eth;
+}
+
 eth_pkt_types_e net_tx_pkt_get_packet_type(struct NetTxPkt *pkt)
 {
     assert(pkt);
@@ -133,6 +133,15 @@ bool net_tx_pkt_update_sctp_checksum(struct NetTxPkt *pkt);
  */
 size_t net_tx_pkt_get_total_len(struct NetTxPkt *pkt);
 
+/**
+ * get the Ethernet header of a parsed packet
+ *
+ * @pkt:            packet
+ * @ret:            Ethernet header
+ *
+ */
+const struct eth_header *net_tx_pkt_get_eth_hdr(struct NetTxPkt *pkt);
+
 /**
  * get packet type
  *
@@ -33,6 +33,7 @@
 #include "hw/virtio/virtio-bus.h"
 #include "qapi/error.h"
 #include "qapi/qapi-events-net.h"
+#include "qapi/qapi-visit-virtio.h"
 #include "hw/qdev-properties.h"
 #include "qapi/qapi-types-migration.h"
 #include "qapi/qapi-events-migration.h"
@@ -956,6 +957,25 @@ static void failover_add_primary(VirtIONet *n, Error **errp)
     error_propagate(errp, err);
 }
 
+
+/*
+ * Receive coalescing runs for guests that negotiate VIRTIO_NET_F_RSC_EXT,
+ * and otherwise as GRO for guests that accept TSO: coalesced segments
+ * are passed on as GSO packets.  GRO needs the checksum state of the
+ * backend, i.e. a vnet header of the size the guest uses.
+ */
+static void virtio_net_update_rsc(VirtIONet *n, uint64_t features)
+{
+    bool rsc_ext = virtio_has_feature(features, VIRTIO_NET_F_RSC_EXT);
+
+    n->gro_enabled = !rsc_ext && n->gro && n->has_vnet_hdr &&
+                     n->host_hdr_len == n->guest_hdr_len;
+    n->rsc4_enabled = (rsc_ext || n->gro_enabled) &&
+        virtio_has_feature(features, VIRTIO_NET_F_GUEST_TSO4);
+    n->rsc6_enabled = (rsc_ext || n->gro_enabled) &&
+        virtio_has_feature(features, VIRTIO_NET_F_GUEST_TSO6);
+}
+
 static void virtio_net_set_features(VirtIODevice *vdev, uint64_t features)
 {
     VirtIONet *n = VIRTIO_NET(vdev);
@@ -979,10 +999,7 @@ static void virtio_net_set_features(VirtIODevice *vdev, uint64_t features)
                                virtio_has_feature(features,
                                                   VIRTIO_NET_F_HASH_REPORT));
 
-    n->rsc4_enabled = virtio_has_feature(features, VIRTIO_NET_F_RSC_EXT) &&
-        virtio_has_feature(features, VIRTIO_NET_F_GUEST_TSO4);
-    n->rsc6_enabled = virtio_has_feature(features, VIRTIO_NET_F_RSC_EXT) &&
-        virtio_has_feature(features, VIRTIO_NET_F_GUEST_TSO6);
+    virtio_net_update_rsc(n, features);
     n->rss_data.redirect = virtio_has_feature(features, VIRTIO_NET_F_RSS);
 
     if (n->has_vnet_hdr) {
@@ -1084,10 +1101,7 @@ static int virtio_net_handle_offloads(VirtIONet *n, uint8_t cmd,
             return VIRTIO_NET_ERR;
         }
 
-        n->rsc4_enabled = virtio_has_feature(offloads, VIRTIO_NET_F_RSC_EXT) &&
-            virtio_has_feature(offloads, VIRTIO_NET_F_GUEST_TSO4);
-        n->rsc6_enabled = virtio_has_feature(offloads, VIRTIO_NET_F_RSC_EXT) &&
-            virtio_has_feature(offloads, VIRTIO_NET_F_GUEST_TSO6);
+        virtio_net_update_rsc(n, offloads);
         virtio_clear_feature(&offloads, VIRTIO_NET_F_RSC_EXT);
 
         supported_offloads = virtio_net_supported_guest_offloads(n);
@@ -1277,6 +1291,41 @@ static void rss_data_to_rss_config(struct VirtioNetRssData *data,
     config->default_queue = data->default_queue;
 }
 
+/*
+ * Copy the flow steering rules to the eBPF program.  Rules for queue pairs
+ * beyond @queue_pairs are left out, like virtio_net_lookup_flow() ignores
+ * them, so that those flows are hashed instead.  Fails if there are rules
+ * but the program has no flow table.
+ */
+static bool virtio_net_set_ebpf_flow_table(VirtIONet *n, uint16_t queue_pairs)
+{
+    guint n_flows = g_hash_table_size(n->flow_table);
+    g_autofree struct EBPFRSSFlowKey *keys = NULL;
+    g_autofree uint16_t *queues = NULL;
+    GHashTableIter iter;
+    gpointer key, value;
+    guint i = 0;
+
+    keys = g_new(struct EBPFRSSFlowKey, n_flows);
+    queues = g_new(uint16_t, n_flows);
+    g_hash_table_iter_init(&iter, n->flow_table);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        unsigned int queue = GPOINTER_TO_UINT(value) - 1;
+
+        if (queue >= queue_pairs) {
+            continue;
+        }
+        keys[i] = *(struct EBPFRSSFlowKey *)key;
+        queues[i] = queue;
+        i++;
+    }
+
+    if (!ebpf_rss_has_flow_table(&n->ebpf_rss)) {
+        return i == 0;
+    }
+    return ebpf_rss_set_flow_table(&n->ebpf_rss, keys, queues, i);
+}
+
 static bool virtio_net_attach_epbf_rss(VirtIONet *n)
 {
     struct EBPFRSSConfig config = {};
@@ -1304,6 +1353,44 @@ static void virtio_net_detach_epbf_rss(VirtIONet *n)
     virtio_net_attach_ebpf_to_backend(n->nic, -1);
 }
 
+/*
+ * Make the RSS steering in use pick up a new flow table.  eBPF programs
+ * without a flow table can't honour the rules, so switch to software RSS
+ * while there are any, and back to eBPF once the table is empty again.
+ * vhost has no software fallback and keeps eBPF steering, without rules.
+ * @queue_pairs is the number of queue pairs the guest has enabled.
+ */
+static void virtio_net_commit_flow_table(VirtIONet *n, uint16_t queue_pairs)
+{
+    if (!n->rss_data.enabled || n->rss_data.populate_hash) {
+        return;
+    }
+    if (n->rss_data.enabled_software_rss && !n->rss_data.flow_fallback) {
+        return;
+    }
+
+    if (virtio_net_set_ebpf_flow_table(n, queue_pairs)) {
+        if (n->rss_data.flow_fallback && virtio_net_attach_epbf_rss(n)) {
+            n->rss_data.enabled_software_rss = false;
+            n->rss_data.flow_fallback = false;
+        }
+        return;
+    }
+
+    if (get_vhost_net(qemu_get_queue(n->nic)->peer)) {
+        warn_report("Can't steer flows with eBPF RSS for vhost - "
+                    "flow rules are ignored");
+        return;
+    }
+    if (!n->rss_data.flow_fallback) {
+        warn_report("Can't steer flows with eBPF RSS - "
+                    "fallback to software RSS");
+        virtio_net_detach_epbf_rss(n);
+        n->rss_data.enabled_software_rss = true;
+        n->rss_data.flow_fallback = true;
+    }
+}
+
 static bool virtio_net_load_ebpf(VirtIONet *n)
 {
     if (!virtio_net_attach_ebpf_to_backend(n->nic, -1)) {
@@ -1432,9 +1519,13 @@ static uint16_t virtio_net_handle_rss(VirtIONet *n,
         goto error;
     }
     n->rss_data.enabled = true;
+    n->rss_data.enabled_software_rss = false;
+    n->rss_data.flow_fallback = false;
 
     if (!n->rss_data.populate_hash) {
-        if (!virtio_net_attach_epbf_rss(n)) {
+        if (virtio_net_attach_epbf_rss(n)) {
+            virtio_net_commit_flow_table(n, queue_pairs);
+        } else {
             /* EBPF must be loaded for vhost */
             if (get_vhost_net(qemu_get_queue(n->nic)->peer)) {
                 warn_report("Can't load eBPF RSS for vhost");
@@ -1813,11 +1904,71 @@ static void virtio_set_packet_hash(const uint8_t *buf, uint8_t report,
     hdr->hash_report = report;
 }
 
+/*
+ * Look up the flow of a parsed packet in the flow steering table, with the
+ * same key as the eBPF program builds.
+ */
+static bool virtio_net_flow_lookup(VirtIONet *n, struct NetRxPkt *pkt,
+                                   bool hasip4, bool hasip6,
+                                   EthL4HdrProto l4hdr_proto,
+                                   unsigned int *queue)
+{
+    struct EBPFRSSFlowKey key = {};
+    eth_l4_hdr_info *l4hdr_info;
+    gpointer value;
+
+    if (!g_hash_table_size(n->flow_table)) {
+        return false;
+    }
+
+    l4hdr_info = net_rx_pkt_get_l4_info(pkt);
+    switch (l4hdr_proto) {
+    case ETH_L4_HDR_PROTO_TCP:
+        key.ip_proto = IP_PROTO_TCP;
+        key.src_port = l4hdr_info->hdr.tcp.th_sport;
+        key.dst_port = l4hdr_info->hdr.tcp.th_dport;
+        break;
+    case ETH_L4_HDR_PROTO_UDP:
+        key.ip_proto = IP_PROTO_UDP;
+        key.src_port = l4hdr_info->hdr.udp.uh_sport;
+        key.dst_port = l4hdr_info->hdr.udp.uh_dport;
+        break;
+    default:
+        return false;
+    }
+
+    if (hasip4) {
+        eth_ip4_hdr_info *ip4hdr_info = net_rx_pkt_get_ip4_info(pkt);
+
+        memcpy(key.src, &ip4hdr_info->ip4_hdr.ip_src, sizeof(uint32_t));
+        memcpy(key.dst, &ip4hdr_info->ip4_hdr.ip_dst, sizeof(uint32_t));
+    } else if (hasip6) {
+        eth_ip6_hdr_info *ip6hdr_info = net_rx_pkt_get_ip6_info(pkt);
+
+        memcpy(key.src, &ip6hdr_info->ip6_hdr.ip6_src, sizeof(key.src));
+        memcpy(key.dst, &ip6hdr_info->ip6_hdr.ip6_dst, sizeof(key.dst));
+        key.is_ipv6 = 1;
+    } else {
+        return false;
+    }
+
+    value = g_hash_table_lookup(n->flow_table, &key);
+    if (!value) {
+        return false;
+    }
+
+    /* Rules for queue pairs the guest has not enabled are ignored. */
+    *queue = GPOINTER_TO_UINT(value) - 1;
+    return *queue < n->curr_queue_pairs;
+}
+
 static int virtio_net_process_rss(NetClientState *nc, const uint8_t *buf,
                                   size_t size)
 {
     VirtIONet *n = qemu_get_nic_opaque(nc);
     unsigned int index = nc->queue_index, new_index = index;
+    unsigned int flow_index;
+    bool steered = false;
     struct NetRxPkt *pkt = n->rx_pkt;
     uint8_t net_hash_type;
     uint32_t hash;
@@ -1841,12 +1992,23 @@ static int virtio_net_process_rss(NetClientState *nc, const uint8_t *buf,
 
     net_rx_pkt_set_protocols(pkt, &iov, 1, n->host_hdr_len);
     net_rx_pkt_get_protocols(pkt, &hasip4, &hasip6, &l4hdr_proto);
+
+    /* Flows steered explicitly take precedence over the hash. */
+    if (n->rss_data.redirect &&
+        virtio_net_flow_lookup(n, pkt, hasip4, hasip6, l4hdr_proto,
+                               &flow_index)) {
+        steered = true;
+    }
+
     net_hash_type = virtio_net_get_hash_type(hasip4, hasip6, l4hdr_proto,
                                              n->rss_data.hash_types);
     if (net_hash_type > NetPktRssIpV6UdpEx) {
         if (n->rss_data.populate_hash) {
             virtio_set_packet_hash(buf, VIRTIO_NET_HASH_REPORT_NONE, 0);
         }
+        if (steered) {
+            return (index == flow_index) ? -1 : flow_index;
+        }
         return n->rss_data.redirect ? n->rss_data.default_queue : -1;
     }
 
@@ -1856,7 +2018,9 @@ static int virtio_net_process_rss(NetClientState *nc, const uint8_t *buf,
         virtio_set_packet_hash(buf, reports[net_hash_type], hash);
     }
 
-    if (n->rss_data.redirect) {
+    if (steered) {
+        new_index = flow_index;
+    } else if (n->rss_data.redirect) {
         new_index = hash & (n->rss_data.indirections_len - 1);
         new_index = n->rss_data.indirections_table[new_index];
     }
@@ -1994,7 +2158,13 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
     }
 
     virtqueue_flush(q->rx_vq, i);
-    virtio_notify(vdev, q->rx_vq);
+    q->rx_packets++;
+    q->rx_bytes += size - MIN(size, n->host_hdr_len);
+    if (n->rx_batch) {
+        q->rx_notify = true;
+    } else {
+        virtio_notify(vdev, q->rx_vq);
+    }
 
     return size;
 
@@ -2051,6 +2221,39 @@ static void virtio_net_rsc_extract_unit6(VirtioNetRscChain *chain,
     unit->payload = htons(*unit->ip_plen) - unit->tcp_hdrlen;
 }
 
+/*
+ * Turn a coalesced segment into a GSO packet that the guest can take apart
+ * again, with a partial checksum like the ones tap passes on.
+ */
+static void virtio_net_gro_finalize(VirtioNetRscChain *chain,
+                                    VirtioNetRscSeg *seg)
+{
+    VirtIODevice *vdev = VIRTIO_DEVICE(chain->n);
+    struct virtio_net_hdr *h = seg->buf;
+    uint8_t *l2 = (uint8_t *)seg->buf + chain->n->guest_hdr_len;
+    uint16_t l4_off = (uint8_t *)seg->unit.tcp - l2;
+    uint16_t l4_len = seg->unit.tcp_hdrlen + seg->unit.payload;
+    uint32_t cso, sum;
+
+    if (chain->proto == ETH_P_IP) {
+        eth_fix_ip4_checksum(seg->unit.ip,
+                             (uint8_t *)seg->unit.tcp -
+                             (uint8_t *)seg->unit.ip);
+        sum = eth_calc_ip4_pseudo_hdr_csum(seg->unit.ip, l4_len, &cso);
+    } else {
+        sum = eth_calc_ip6_pseudo_hdr_csum(seg->unit.ip, l4_len,
+                                           IP_PROTO_TCP, &cso);
+    }
+    seg->unit.tcp->th_sum = cpu_to_be16(~net_checksum_finish(sum));
+
+    h->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+    h->gso_type = chain->gso_type;
+    virtio_stw_p(vdev, &h->hdr_len, l4_off + seg->unit.tcp_hdrlen);
+    virtio_stw_p(vdev, &h->gso_size, seg->gso_size);
+    virtio_stw_p(vdev, &h->csum_start, l4_off);
+    virtio_stw_p(vdev, &h->csum_offset, offsetof(struct tcp_header, th_sum));
+}
+
 static size_t virtio_net_rsc_drain_seg(VirtioNetRscChain *chain,
                                        VirtioNetRscSeg *seg)
 {
@@ -2058,10 +2261,12 @@ static size_t virtio_net_rsc_drain_seg(VirtioNetRscChain *chain,
     struct virtio_net_hdr_v1 *h;
 
     h = (struct virtio_net_hdr_v1 *)seg->buf;
-    h->flags = 0;
-    h->gso_type = VIRTIO_NET_HDR_GSO_NONE;
-
-    if (seg->is_coalesced) {
+    if (chain->n->gro_enabled) {
+        /* A single segment keeps the header it came with. */
+        if (seg->is_coalesced) {
+            virtio_net_gro_finalize(chain, seg);
+        }
+    } else if (seg->is_coalesced) {
         h->rsc.segments = seg->packets;
         h->rsc.dup_acks = seg->dup_ack;
         h->flags = VIRTIO_NET_HDR_F_RSC_INFO;
@@ -2070,6 +2275,9 @@ static size_t virtio_net_rsc_drain_seg(VirtioNetRscChain *chain,
         } else {
             h->gso_type = VIRTIO_NET_HDR_GSO_TCPV6;
         }
+    } else {
+        h->flags = 0;
+        h->gso_type = VIRTIO_NET_HDR_GSO_NONE;
     }
 
     ret = virtio_net_do_receive(seg->nc, seg->buf, seg->size);
@@ -2148,6 +2356,7 @@ static void virtio_net_rsc_cache_buf(VirtioNetRscChain *chain,
     default:
         g_assert_not_reached();
     }
+    seg->gso_size = seg->unit.payload;
 }
 
 static int32_t virtio_net_rsc_handle_ack(VirtioNetRscChain *chain,
@@ -2207,6 +2416,21 @@ static int32_t virtio_net_rsc_coalesce_data(VirtioNetRscChain *chain,
         return RSC_FINAL;
     }
 
+    /*
+     * For GRO, every segment but the last one must carry gso_size bytes,
+     * and the TCP headers must only differ where the merged header can
+     * stand for all of them.
+     */
+    if (chain->n->gro_enabled &&
+        (nseq == oseq || n_unit->payload > seg->gso_size ||
+         o_unit->payload % seg->gso_size ||
+         n_unit->tcp_hdrlen != o_unit->tcp_hdrlen ||
+         memcmp(n_unit->tcp + 1, o_unit->tcp + 1,
+                n_unit->tcp_hdrlen - sizeof(struct tcp_header)))) {
+        chain->stat.gro_final++;
+        return RSC_FINAL;
+    }
+
     data = ((uint8_t *)n_unit->tcp) + n_unit->tcp_hdrlen;
     if (nseq == oseq) {
         if ((o_unit->payload == 0) && n_unit->payload) {
@@ -2311,7 +2535,8 @@ static int virtio_net_rsc_tcp_ctrl_check(VirtioNetRscChain *chain,
         return RSC_FINAL;
     }
 
-    if (tcp_hdr > sizeof(struct tcp_header)) {
+    /* GRO compares the options of the segments it merges */
+    if (tcp_hdr > sizeof(struct tcp_header) && !chain->n->gro_enabled) {
         chain->stat.tcp_all_opt++;
         return RSC_FINAL;
     }
@@ -2438,6 +2663,34 @@ static int32_t virtio_net_rsc_sanity_check4(VirtioNetRscChain *chain,
     return RSC_CANDIDATE;
 }
 
+/*
+ * GRO only merges data segments whose checksum the host has already
+ * verified or will fill in, and that are not GSO packets themselves.
+ */
+static bool virtio_net_gro_candidate(VirtioNetRscChain *chain,
+                                     const uint8_t *buf,
+                                     VirtioNetRscUnit *unit)
+{
+    const struct virtio_net_hdr *h = (const struct virtio_net_hdr *)buf;
+    size_t l3_len = be16_to_cpu(*unit->ip_plen);
+    size_t l4_end;
+
+    if (chain->proto == ETH_P_IPV6) {
+        l3_len += sizeof(struct ip6_header);
+    }
+    l4_end = (uint8_t *)unit->tcp - (uint8_t *)unit->ip + unit->tcp_hdrlen;
+
+    if (h->gso_type != VIRTIO_NET_HDR_GSO_NONE ||
+        !(h->flags & (VIRTIO_NET_HDR_F_NEEDS_CSUM |
+                      VIRTIO_NET_HDR_F_DATA_VALID)) ||
+        unit->tcp_hdrlen < sizeof(struct tcp_header) ||
+        l4_end >= l3_len) {
+        chain->stat.gro_bypass++;
+        return false;
+    }
+    return true;
+}
+
 static size_t virtio_net_rsc_receive4(VirtioNetRscChain *chain,
                                       NetClientState *nc,
                                       const uint8_t *buf, size_t size)
@@ -2461,6 +2714,10 @@ static size_t virtio_net_rsc_receive4(VirtioNetRscChain *chain,
     }
 
     ret = virtio_net_rsc_tcp_ctrl_check(chain, unit.tcp);
+    if (ret == RSC_CANDIDATE && chain->n->gro_enabled &&
+        !virtio_net_gro_candidate(chain, buf, &unit)) {
+        ret = RSC_FINAL;
+    }
     if (ret == RSC_BYPASS) {
         return virtio_net_do_receive(nc, buf, size);
     } else if (ret == RSC_FINAL) {
@@ -2530,6 +2787,10 @@ static size_t virtio_net_rsc_receive6(void *opq, NetClientState *nc,
     }
 
     ret = virtio_net_rsc_tcp_ctrl_check(chain, unit.tcp);
+    if (ret == RSC_CANDIDATE && chain->n->gro_enabled &&
+        !virtio_net_gro_candidate(chain, buf, &unit)) {
+        ret = RSC_FINAL;
+    }
     if (ret == RSC_BYPASS) {
         return virtio_net_do_receive(nc, buf, size);
     } else if (ret == RSC_FINAL) {
@@ -2589,7 +2850,8 @@ static ssize_t virtio_net_rsc_receive(NetClientState *nc,
     VirtIONet *n;
 
     n = qemu_get_nic_opaque(nc);
-    if (size < (n->host_hdr_len + sizeof(struct eth_header))) {
+    if (size < (n->host_hdr_len + sizeof(struct eth_header)) ||
+        (n->gro_enabled && n->needs_vnet_hdr_swap)) {
         return virtio_net_do_receive(nc, buf, size);
     }
 
@@ -2608,17 +2870,99 @@ static ssize_t virtio_net_rsc_receive(NetClientState *nc,
     return virtio_net_do_receive(nc, buf, size);
 }
 
+/* Like NAPI, don't hold back GRO segments past the end of a batch. */
+static void virtio_net_gro_flush(VirtIONet *n)
+{
+    VirtioNetRscChain *chain;
+
+    if (!n->gro_enabled) {
+        return;
+    }
+
+    QTAILQ_FOREACH(chain, &n->rsc_chains, next) {
+        if (!QTAILQ_EMPTY(&chain->buffers)) {
+            virtio_net_rsc_purge(chain);
+        }
+    }
+}
+
+static void virtio_net_gro_flush_bh(void *opaque)
+{
+    virtio_net_gro_flush(opaque);
+}
+
 static ssize_t virtio_net_receive(NetClientState *nc, const uint8_t *buf,
                                   size_t size)
 {
     VirtIONet *n = qemu_get_nic_opaque(nc);
+    ssize_t ret;
+
     if ((n->rsc4_enabled || n->rsc6_enabled)) {
-        return virtio_net_rsc_receive(nc, buf, size);
+        ret = virtio_net_rsc_receive(nc, buf, size);
+        /*
+         * Backends that deliver packets one at a time, and the net queue
+         * when it is flushed, still hand over several packets per main loop
+         * iteration.  Treat those as a batch and flush once they are done.
+         */
+        if (!n->rx_batch && n->gro_enabled) {
+            qemu_bh_schedule(n->gro_flush_bh);
+        }
+        return ret;
     } else {
         return virtio_net_do_receive(nc, buf, size);
     }
 }
 
+/*
+ * Receive a batch of packets from the backend, raising at most one
+ * interrupt per RX queue for the whole batch.
+ */
+static int virtio_net_receive_iov_batch(NetClientState *nc,
+                                        const NetPacketIOV *pkts, int count)
+{
+    VirtIONet *n = qemu_get_nic_opaque(nc);
+    VirtIODevice *vdev = VIRTIO_DEVICE(n);
+    g_autofree uint8_t *linear = NULL;
+    int i;
+
+    n->rx_batch = true;
+    for (i = 0; i < count; i++) {
+        const uint8_t *buf;
+        size_t size;
+
+        if (pkts[i].iovcnt == 1) {
+            buf = pkts[i].iov[0].iov_base;
+            size = pkts[i].iov[0].iov_len;
+        } else {
+            if (!linear) {
+                linear = g_malloc(NET_BUFSIZE);
+            }
+            size = iov_to_buf(pkts[i].iov, pkts[i].iovcnt, 0,
+                              linear, NET_BUFSIZE);
+            buf = linear;
+        }
+
+        if (virtio_net_receive(nc, buf, size) == 0) {
+            break;
+        }
+    }
+
+    virtio_net_gro_flush(n);
+    n->rx_batch = false;
+
+    /* RSS may have steered some of the packets to other queues. */
+    for (int j = 0; j < n->max_queue_pairs; j++) {
+        VirtIONetQueue *q = &n->vqs[j];
+
+        if (q->rx_notify) {
+            q->rx_notify = false;
+            virtio_notify(vdev, q->rx_vq);
+        }
+    }
+
+    return i;
+}
+
 static int32_t virtio_net_flush_tx(VirtIONetQueue *q);
 
 static void virtio_net_tx_complete(NetClientState *nc, ssize_t len)
@@ -2654,11 +2998,80 @@ static void virtio_net_tx_complete(NetClientState *nc, ssize_t len)
 }
 
 /* TX */
+
+/* Number of TX elements popped from the virtqueue at a time */
+#define VIRTIO_NET_TX_BATCH 32
+
+static void virtio_net_tx_account(VirtIONetQueue *q, VirtQueueElement *elem)
+{
+    size_t size = iov_size(elem->out_sg, elem->out_num);
+
+    q->tx_packets++;
+    q->tx_bytes += size - MIN(size, q->n->guest_hdr_len);
+}
+
+static void virtio_net_tx_unpop(VirtIONetQueue *q, VirtQueueElement **elems,
+                                unsigned int count)
+{
+    while (count--) {
+        virtqueue_unpop(q->tx_vq, elems[count], 0);
+        g_free(elems[count]);
+    }
+}
+
+/*
+ * Send the first @count of the @popped elements in @elems, whose packets
+ * are described by @pkts, as a single batch.  If the peer queues one of
+ * them, the elements after it are put back on the virtqueue and -EBUSY is
+ * returned.
+ */
+static int virtio_net_tx_send_batch(VirtIONetQueue *q,
+                                    VirtQueueElement **elems,
+                                    const NetPacketIOV *pkts,
+                                    unsigned int count, unsigned int popped)
+{
+    VirtIONet *n = q->n;
+    VirtIODevice *vdev = VIRTIO_DEVICE(n);
+    int queue_index = vq2q(virtio_get_queue_index(q->tx_vq));
+    unsigned int i, sent;
+
+    if (!count) {
+        return 0;
+    }
+
+    sent = qemu_sendv_packet_batch_async(qemu_get_subqueue(n->nic,
+                                                           queue_index),
+                                         pkts, count, virtio_net_tx_complete);
+    /* A packet that got queued goes out later, count it as well. */
+    for (i = 0; i < MIN(sent + 1, count); i++) {
+        virtio_net_tx_account(q, elems[i]);
+    }
+    if (sent) {
+        WITH_RCU_READ_LOCK_GUARD() {
+            for (i = 0; i < sent; i++) {
+                virtqueue_fill(q->tx_vq, elems[i], 0, i);
+                g_free(elems[i]);
+            }
+            virtqueue_flush(q->tx_vq, sent);
+        }
+        virtio_notify(vdev, q->tx_vq);
+    }
+
+    if (sent < count) {
+        virtio_queue_set_notification(q->tx_vq, 0);
+        q->async_tx.elem = elems[sent];
+        virtio_net_tx_unpop(q, elems + sent + 1, popped - sent - 1);
+        return -EBUSY;
+    }
+    return 0;
+}
+
 static int32_t virtio_net_flush_tx(VirtIONetQueue *q)
 {
     VirtIONet *n = q->n;
     VirtIODevice *vdev = VIRTIO_DEVICE(n);
-    VirtQueueElement *elem;
+    VirtQueueElement *elems[VIRTIO_NET_TX_BATCH];
+    NetPacketIOV pkts[VIRTIO_NET_TX_BATCH];
     int32_t num_packets = 0;
     int queue_index = vq2q(virtio_get_queue_index(q->tx_vq));
     if (!(vdev->status & VIRTIO_CONFIG_S_DRIVER_OK)) {
@@ -2670,81 +3083,122 @@ static int32_t virtio_net_flush_tx(VirtIONetQueue *q)
         return num_packets;
     }
 
-    for (;;) {
-        ssize_t ret;
-        unsigned int out_num;
-        struct iovec sg[VIRTQUEUE_MAX_SIZE], sg2[VIRTQUEUE_MAX_SIZE + 1], *out_sg;
-        struct virtio_net_hdr_mrg_rxbuf mhdr;
+    while (num_packets < n->tx_burst) {
+        unsigned int i, count, batched = 0;
 
-        elem = virtqueue_pop(q->tx_vq, sizeof(VirtQueueElement));
-        if (!elem) {
+        count = virtqueue_pop_batch(q->tx_vq, sizeof(VirtQueueElement),
+                                    (void **)elems,
+                                    MIN(VIRTIO_NET_TX_BATCH,
+                                        n->tx_burst - num_packets));
+        if (!count) {
             break;
         }
 
-        out_num = elem->out_num;
-        out_sg = elem->out_sg;
-        if (out_num < 1) {
-            virtio_error(vdev, "virtio-net header not in first element");
-            virtqueue_detach_element(q->tx_vq, elem, 0);
-            g_free(elem);
-            return -EINVAL;
-        }
+        for (i = 0; i < count; i++) {
+            VirtQueueElement *elem = elems[i];
+            ssize_t ret;
+            unsigned int out_num;
+            struct iovec sg[VIRTQUEUE_MAX_SIZE], sg2[VIRTQUEUE_MAX_SIZE + 1];
+            struct iovec *out_sg;
+            struct virtio_net_hdr_mrg_rxbuf mhdr;
+
+            out_num = elem->out_num;
+            out_sg = elem->out_sg;
+
+            /*
+             * Packets that can be passed on as the guest laid them out are
+             * collected and sent to the peer together.
+             */
+            if (out_num >= 1 && !n->needs_vnet_hdr_swap &&
+                n->host_hdr_len == n->guest_hdr_len &&
+                (!n->has_vnet_hdr ||
+                 iov_size(out_sg, out_num) >= n->guest_hdr_len)) {
+                pkts[batched].iov = out_sg;
+                pkts[batched].iovcnt = out_num;
+                batched++;
+                continue;
+            }
+
+            /* Everything else goes out on its own, after what we have */
+            if (virtio_net_tx_send_batch(q, elems + i - batched, pkts,
+                                         batched, count - i + batched)) {
+                return -EBUSY;
+            }
+            num_packets += batched;
+            batched = 0;
 
-        if (n->has_vnet_hdr) {
-            if (iov_to_buf(out_sg, out_num, 0, &mhdr, n->guest_hdr_len) <
-                n->guest_hdr_len) {
-                virtio_error(vdev, "virtio-net header incorrect");
+            if (out_num < 1) {
+                virtio_error(vdev, "virtio-net header not in first element");
                 virtqueue_detach_element(q->tx_vq, elem, 0);
                 g_free(elem);
+                virtio_net_tx_unpop(q, elems + i + 1, count - i - 1);
                 return -EINVAL;
             }
-            if (n->needs_vnet_hdr_swap) {
-                virtio_net_hdr_swap(vdev, (void *) &mhdr);
-                sg2[0].iov_base = &mhdr;
-                sg2[0].iov_len = n->guest_hdr_len;
-                out_num = iov_copy(&sg2[1], ARRAY_SIZE(sg2) - 1,
-                                   out_sg, out_num,
-                                   n->guest_hdr_len, -1);
-                if (out_num == VIRTQUEUE_MAX_SIZE) {
-                    goto drop;
+
+            if (n->has_vnet_hdr) {
+                if (iov_to_buf(out_sg, out_num, 0, &mhdr, n->guest_hdr_len) <
+                    n->guest_hdr_len) {
+                    virtio_error(vdev, "virtio-net header incorrect");
+                    virtqueue_detach_element(q->tx_vq, elem, 0);
+                    g_free(elem);
+                    virtio_net_tx_unpop(q, elems + i + 1, count - i - 1);
+                    return -EINVAL;
                 }
-                out_num += 1;
-                out_sg = sg2;
-            }
-        }
-        /*
-         * If host wants to see the guest header as is, we can
-         * pass it on unchanged. Otherwise, copy just the parts
-         * that host is interested in.
-         */
-        assert(n->host_hdr_len <= n->guest_hdr_len);
-        if (n->host_hdr_len != n->guest_hdr_len) {
-            unsigned sg_num = iov_copy(sg, ARRAY_SIZE(sg),
+                if (n->needs_vnet_hdr_swap) {
+                    virtio_net_hdr_swap(vdev, (void *) &mhdr);
+                    sg2[0].iov_base = &mhdr;
+                    sg2[0].iov_len = n->guest_hdr_len;
+                    out_num = iov_copy(&sg2[1], ARRAY_SIZE(sg2) - 1,
                                        out_sg, out_num,
-                                       0, n->host_hdr_len);
-            sg_num += iov_copy(sg + sg_num, ARRAY_SIZE(sg) - sg_num,
-                             out_sg, out_num,
-                             n->guest_hdr_len, -1);
-            out_num = sg_num;
-            out_sg = sg;
-        }
-
-        ret = qemu_sendv_packet_async(qemu_get_subqueue(n->nic, queue_index),
-                                      out_sg, out_num, virtio_net_tx_complete);
-        if (ret == 0) {
-            virtio_queue_set_notification(q->tx_vq, 0);
-            q->async_tx.elem = elem;
-            return -EBUSY;
-        }
+                                       n->guest_hdr_len, -1);
+                    if (out_num == VIRTQUEUE_MAX_SIZE) {
+                        goto drop;
+                    }
+                    out_num += 1;
+                    out_sg = sg2;
+                }
+            }
+            /*
+             * If host wants to see the guest header as is, we can
+             * pass it on unchanged. Otherwise, copy just the parts
+             * that host is interested in.
+             */
+            assert(n->host_hdr_len <= n->guest_hdr_len);
+            if (n->host_hdr_len != n->guest_hdr_len) {
+                unsigned sg_num = iov_copy(sg, ARRAY_SIZE(sg),
+                                           out_sg, out_num,
+                                           0, n->host_hdr_len);
+                sg_num += iov_copy(sg + sg_num, ARRAY_SIZE(sg) - sg_num,
+                                 out_sg, out_num,
+                                 n->guest_hdr_len, -1);
+                out_num = sg_num;
+                out_sg = sg;
+            }
+
+            ret = qemu_sendv_packet_async(qemu_get_subqueue(n->nic,
+                                                            queue_index),
+                                          out_sg, out_num,
+                                          virtio_net_tx_complete);
+            virtio_net_tx_account(q, elem);
+            if (ret == 0) {
+                virtio_queue_set_notification(q->tx_vq, 0);
+                q->async_tx.elem = elem;
+                virtio_net_tx_unpop(q, elems + i + 1, count - i - 1);
+                return -EBUSY;
+            }
 
 drop:
-        virtqueue_push(q->tx_vq, elem, 0);
-        virtio_notify(vdev, q->tx_vq);
-        g_free(elem);
+            virtqueue_push(q->tx_vq, elem, 0);
+            virtio_notify(vdev, q->tx_vq);
+            g_free(elem);
+            num_packets++;
+        }
 
-        if (++num_packets >= n->tx_burst) {
-            break;
+        if (virtio_net_tx_send_batch(q, elems + count - batched, pkts,
+                                     batched, batched)) {
+            return -EBUSY;
         }
+        num_packets += batched;
     }
     return num_packets;
 }
@@ -3054,8 +3508,11 @@ static int virtio_net_post_load_device(void *opaque, int version_id)
 
     if (n->rss_data.enabled) {
         n->rss_data.enabled_software_rss = n->rss_data.populate_hash;
+        n->rss_data.flow_fallback = false;
         if (!n->rss_data.populate_hash) {
-            if (!virtio_net_attach_epbf_rss(n)) {
+            if (virtio_net_attach_epbf_rss(n)) {
+                virtio_net_commit_flow_table(n, n->curr_queue_pairs);
+            } else {
                 if (get_vhost_net(qemu_get_queue(n->nic)->peer)) {
                     warn_report("Can't post-load eBPF RSS for vhost");
                 } else {
@@ -3336,6 +3793,7 @@ static NetClientInfo net_virtio_info = {
     .size = sizeof(NICState),
     .can_receive = virtio_net_can_receive,
     .receive = virtio_net_receive,
+    .receive_iov_batch = virtio_net_receive_iov_batch,
     .link_status_changed = virtio_net_set_link_status,
     .query_rx_filter = virtio_net_query_rxfilter,
     .announce = virtio_net_announce,
@@ -3736,6 +4194,8 @@ static void virtio_net_device_realize(DeviceState *dev, Error **errp)
             (uint8_t *)&netcfg, 0, ETH_ALEN, VHOST_SET_CONFIG_TYPE_FRONTEND);
     }
     QTAILQ_INIT(&n->rsc_chains);
+    n->gro_flush_bh = qemu_bh_new_guarded(virtio_net_gro_flush_bh, n,
+                                          &dev->mem_reentrancy_guard);
     n->qdev = dev;
 
     net_rx_pkt_init(&n->rx_pkt);
@@ -3783,12 +4243,142 @@ static void virtio_net_device_unrealize(DeviceState *dev)
     qemu_announce_timer_del(&n->announce_timer, false);
     g_free(n->vqs);
     qemu_del_nic(n->nic);
+    qemu_bh_delete(n->gro_flush_bh);
     virtio_net_rsc_cleanup(n);
     g_free(n->rss_data.indirections_table);
     net_rx_pkt_uninit(n->rx_pkt);
     virtio_cleanup(vdev);
 }
 
+static guint virtio_net_flow_key_hash(gconstpointer key)
+{
+    const uint8_t *p = key;
+    guint h = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof(struct EBPFRSSFlowKey); i += sizeof(uint32_t)) {
+        h = h * 31 + ldl_he_p(p + i);
+    }
+    return h;
+}
+
+static gboolean virtio_net_flow_key_equal(gconstpointer a, gconstpointer b)
+{
+    return !memcmp(a, b, sizeof(struct EBPFRSSFlowKey));
+}
+
+static GHashTable *virtio_net_flow_table_new(void)
+{
+    return g_hash_table_new_full(virtio_net_flow_key_hash,
+                                 virtio_net_flow_key_equal, g_free, NULL);
+}
+
+static bool virtio_net_flow_rule_to_key(const VirtioNetFlowRule *rule,
+                                        struct EBPFRSSFlowKey *key,
+                                        Error **errp)
+{
+    memset(key, 0, sizeof(*key));
+
+    if (inet_pton(AF_INET, rule->src_addr, key->src) == 1 &&
+        inet_pton(AF_INET, rule->dst_addr, key->dst) == 1) {
+        key->is_ipv6 = 0;
+    } else if (inet_pton(AF_INET6, rule->src_addr, key->src) == 1 &&
+               inet_pton(AF_INET6, rule->dst_addr, key->dst) == 1) {
+        key->is_ipv6 = 1;
+    } else {
+        error_setg(errp, "Invalid flow addresses '%s' and '%s'",
+                   rule->src_addr, rule->dst_addr);
+        return false;
+    }
+
+    key->src_port = cpu_to_be16(rule->src_port);
+    key->dst_port = cpu_to_be16(rule->dst_port);
+    key->ip_proto = rule->protocol == VIRTIO_NET_FLOW_PROTOCOL_TCP ?
+                    IP_PROTO_TCP : IP_PROTO_UDP;
+    return true;
+}
+
+static void virtio_net_get_flow_rules(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    VirtIONet *n = VIRTIO_NET(obj);
+
+    visit_type_VirtioNetFlowRuleList(v, name, &n->flow_rules, errp);
+}
+
+static void virtio_net_set_flow_rules(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    VirtIONet *n = VIRTIO_NET(obj);
+    VirtioNetFlowRuleList *rules = NULL, *l;
+    GHashTable *table;
+
+    if (!visit_type_VirtioNetFlowRuleList(v, name, &rules, errp)) {
+        return;
+    }
+
+    table = virtio_net_flow_table_new();
+    for (l = rules; l; l = l->next) {
+        struct EBPFRSSFlowKey key;
+
+        if (g_hash_table_size(table) == EBPF_RSS_MAX_FLOWS) {
+            error_setg(errp, "Too many flow rules, the maximum is %d",
+                       EBPF_RSS_MAX_FLOWS);
+            goto fail;
+        }
+        if (DEVICE(n)->realized && l->value->queue >= n->max_queue_pairs) {
+            error_setg(errp, "Flow rule queue %u is out of range",
+                       l->value->queue);
+            goto fail;
+        }
+        if (!virtio_net_flow_rule_to_key(l->value, &key, errp)) {
+            goto fail;
+        }
+        g_hash_table_replace(table, g_memdup2(&key, sizeof(key)),
+                             GUINT_TO_POINTER(l->value->queue + 1));
+    }
+
+    g_hash_table_unref(n->flow_table);
+    n->flow_table = table;
+    qapi_free_VirtioNetFlowRuleList(n->flow_rules);
+    n->flow_rules = rules;
+
+    if (DEVICE(n)->realized) {
+        virtio_net_commit_flow_table(n, n->curr_queue_pairs);
+    }
+    return;
+
+fail:
+    g_hash_table_unref(table);
+    qapi_free_VirtioNetFlowRuleList(rules);
+}
+
+static void virtio_net_get_queue_stats(Object *obj, Visitor *v,
+                                       const char *name, void *opaque,
+                                       Error **errp)
+{
+    VirtIONet *n = VIRTIO_NET(obj);
+    VirtioNetQueueStatsList *list = NULL;
+    int i;
+
+    for (i = n->max_queue_pairs - 1; i >= 0; i--) {
+        VirtioNetQueueStats *stats = g_new0(VirtioNetQueueStats, 1);
+        VirtIONetQueue *q = &n->vqs[i];
+
+        stats->queue = i;
+        stats->rx_packets = q->rx_packets;
+        stats->rx_bytes = q->rx_bytes;
+        stats->tx_packets = q->tx_packets;
+        stats->tx_bytes = q->tx_bytes;
+        QAPI_LIST_PREPEND(list, stats);
+    }
+
+    visit_type_VirtioNetQueueStatsList(v, name, &list, errp);
+    qapi_free_VirtioNetQueueStatsList(list);
+}
+
 static void virtio_net_instance_init(Object *obj)
 {
     VirtIONet *n = VIRTIO_NET(obj);
@@ -3803,6 +4393,15 @@ static void virtio_net_instance_init(Object *obj)
                                   DEVICE(n));
 
     ebpf_rss_init(&n->ebpf_rss);
+    n->flow_table = virtio_net_flow_table_new();
+}
+
+static void virtio_net_instance_finalize(Object *obj)
+{
+    VirtIONet *n = VIRTIO_NET(obj);
+
+    g_hash_table_unref(n->flow_table);
+    qapi_free_VirtioNetFlowRuleList(n->flow_rules);
 }
 
 static int virtio_net_pre_save(void *opaque)
@@ -3907,6 +4506,7 @@ static Property virtio_net_properties[] = {
                     VIRTIO_NET_F_RSC_EXT, false),
     DEFINE_PROP_UINT32("rsc_interval", VirtIONet, rsc_timeout,
                        VIRTIO_NET_RSC_DEFAULT_INTERVAL),
+    DEFINE_PROP_BOOL("gro", VirtIONet, gro, false),
     DEFINE_NIC_PROPERTIES(VirtIONet, nic_conf),
     DEFINE_PROP_UINT32("x-txtimer", VirtIONet, net_conf.txtimer,
                        TX_TIMER_INTERVAL),
@@ -3931,6 +4531,12 @@ static void virtio_net_class_init(ObjectClass *klass, void *data)
     VirtioDeviceClass *vdc = VIRTIO_DEVICE_CLASS(klass);
 
     device_class_set_props(dc, virtio_net_properties);
+    object_class_property_add(klass, "x-flow-rules", "VirtioNetFlowRuleList",
+                              virtio_net_get_flow_rules,
+                              virtio_net_set_flow_rules, NULL, NULL);
+    object_class_property_add(klass, "x-queue-stats",
+                              "VirtioNetQueueStatsList",
+                              virtio_net_get_queue_stats, NULL, NULL, NULL);
     dc->vmsd = &vmstate_virtio_net;
     set_bit(DEVICE_CATEGORY_NETWORK, dc->categories);
     vdc->realize = virtio_net_device_realize;
@@ -3959,6 +4565,7 @@ static const TypeInfo virtio_net_info = {
     .parent = TYPE_VIRTIO_DEVICE,
     .instance_size = sizeof(VirtIONet),
     .instance_init = virtio_net_instance_init,
+    .instance_finalize = virtio_net_instance_finalize,
     .class_init = virtio_net_class_init,
 };
 
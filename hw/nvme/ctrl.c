@@ -40,6 +40,7 @@
  *              sriov_vi_flexible=<N[optional]> \
  *              sriov_max_vi_per_vf=<N[optional]> \
  *              sriov_max_vq_per_vf=<N[optional]> \
+ *              iothread=<iothread_id[optional]> \
  *              subsys=<subsys_id>
  *      -device nvme-ns,drive=<drive_id>,bus=<bus_name>,nsid=<nsid>,\
  *              zoned=<true|false[optional]>, \
@@ -147,6 +148,13 @@
  *   a secondary controller. The default 0 resolves to
  *   `(sriov_vq_flexible / sriov_max_vfs)`.
  *
+ * - `iothread`
+ *   Process the I/O queues and their completions in the given iothread
+ *   instead of the main loop. With `ioeventfd=on` and shadow doorbells
+ *   enabled by the host, the iothread polls the submission queue doorbells
+ *   while idle. The admin queue is always processed in the main loop.
+ *   Namespaces shared between controllers must use the same iothread.
+ *
  * nvme namespace device parameters
  * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
  * - `shared`
@@ -200,6 +208,7 @@
 #include "qapi/visitor.h"
 #include "sysemu/sysemu.h"
 #include "sysemu/block-backend.h"
+#include "block/aio-wait.h"
 #include "sysemu/hostmem.h"
 #include "hw/pci/msix.h"
 #include "hw/pci/pcie_sriov.h"
@@ -693,6 +702,43 @@ static void nvme_irq_deassert(NvmeCtrl *n, NvmeCQueue *cq)
     }
 }
 
+static void nvme_irq_update(NvmeCtrl *n, NvmeCQueue *cq)
+{
+    if (cq->tail != cq->head) {
+        nvme_irq_assert(n, cq);
+    } else {
+        nvme_irq_deassert(n, cq);
+    }
+}
+
+/*
+ * Completion queues serviced in an iothread do not touch the interrupt
+ * state of the device directly; the main loop re-evaluates it instead.
+ */
+static void nvme_irq_kick(NvmeCtrl *n, NvmeCQueue *cq)
+{
+    if (cq->irq_notifier_enabled) {
+        event_notifier_set(&cq->irq_notifier);
+        return;
+    }
+
+    nvme_irq_update(n, cq);
+}
+
+static void nvme_irq_notifier(EventNotifier *e)
+{
+    NvmeCQueue *cq = container_of(e, NvmeCQueue, irq_notifier);
+    NvmeCtrl *n = cq->ctrl;
+
+    if (!event_notifier_test_and_clear(e)) {
+        return;
+    }
+
+    aio_context_acquire(n->ctx);
+    nvme_irq_update(n, cq);
+    aio_context_release(n->ctx);
+}
+
 static void nvme_req_clear(NvmeRequest *req)
 {
     req->ns = NULL;
@@ -1487,9 +1533,13 @@ static void nvme_post_cqes(void *opaque)
     NvmeCQueue *cq = opaque;
     NvmeCtrl *n = cq->ctrl;
     NvmeRequest *req, *next;
-    bool pending = cq->head != cq->tail;
+    bool pending;
     int ret;
 
+    aio_context_acquire(n->ctx);
+
+    pending = cq->head != cq->tail;
+
     QTAILQ_FOREACH_SAFE(req, &cq->req_list, entry, next) {
         NvmeSQueue *sq;
         hwaddr addr;
@@ -1526,8 +1576,10 @@ static void nvme_post_cqes(void *opaque)
             n->cq_pending++;
         }
 
-        nvme_irq_assert(n, cq);
+        nvme_irq_kick(n, cq);
     }
+
+    aio_context_release(n->ctx);
 }
 
 static void nvme_enqueue_req_completion(NvmeCQueue *cq, NvmeRequest *req)
@@ -1543,8 +1595,10 @@ static void nvme_enqueue_req_completion(NvmeCQueue *cq, NvmeRequest *req)
                                       req->status, req->cmd.opcode);
     }
 
+    aio_context_acquire(cq->ctrl->ctx);
     QTAILQ_REMOVE(&req->sq->out_req_list, req, entry);
     QTAILQ_INSERT_TAIL(&cq->req_list, req, entry);
+    aio_context_release(cq->ctrl->ctx);
 
     qemu_bh_schedule(cq->bh);
 }
@@ -2132,7 +2186,9 @@ static inline bool nvme_is_write(NvmeRequest *req)
 
 static AioContext *nvme_get_aio_context(BlockAIOCB *acb)
 {
-    return qemu_get_aio_context();
+    NvmeRequest *req = acb->opaque;
+
+    return req->sq->sqid ? req->sq->ctrl->ctx : qemu_get_aio_context();
 }
 
 static void nvme_misc_cb(void *opaque, int ret)
@@ -4501,6 +4557,8 @@ static void nvme_cq_notifier(EventNotifier *e)
         return;
     }
 
+    aio_context_acquire(n->ctx);
+
     nvme_update_cq_head(cq);
 
     if (cq->tail == cq->head) {
@@ -4508,9 +4566,11 @@ static void nvme_cq_notifier(EventNotifier *e)
             n->cq_pending--;
         }
 
-        nvme_irq_deassert(n, cq);
+        nvme_irq_kick(n, cq);
     }
 
+    aio_context_release(n->ctx);
+
     qemu_bh_schedule(cq->bh);
 }
 
@@ -4525,7 +4585,12 @@ static int nvme_init_cq_ioeventfd(NvmeCQueue *cq)
         return ret;
     }
 
-    event_notifier_set_handler(&cq->notifier, nvme_cq_notifier);
+    if (n->params.iothread) {
+        aio_set_event_notifier(n->ctx, &cq->notifier, nvme_cq_notifier,
+                               NULL, NULL);
+    } else {
+        event_notifier_set_handler(&cq->notifier, nvme_cq_notifier);
+    }
     memory_region_add_eventfd(&n->iomem,
                               0x1000 + offset, 4, false, 0, &cq->notifier);
 
@@ -4543,6 +4608,34 @@ static void nvme_sq_notifier(EventNotifier *e)
     nvme_process_sq(sq);
 }
 
+/*
+ * Busy-poll the shadow doorbell while the iothread is idle so that new
+ * submissions are picked up without waiting for the guest to write the
+ * MMIO doorbell. The AioContext adapts the polling interval on its own.
+ */
+static bool nvme_sq_poll(void *opaque)
+{
+    EventNotifier *e = opaque;
+    NvmeSQueue *sq = container_of(e, NvmeSQueue, notifier);
+    uint32_t tail;
+
+    if (QTAILQ_EMPTY(&sq->req_list)) {
+        return false;
+    }
+
+    ldl_le_pci_dma(PCI_DEVICE(sq->ctrl), sq->db_addr, &tail,
+                   MEMTXATTRS_UNSPECIFIED);
+
+    return tail != sq->head;
+}
+
+static void nvme_sq_poll_ready(EventNotifier *e)
+{
+    NvmeSQueue *sq = container_of(e, NvmeSQueue, notifier);
+
+    nvme_process_sq(sq);
+}
+
 static int nvme_init_sq_ioeventfd(NvmeSQueue *sq)
 {
     NvmeCtrl *n = sq->ctrl;
@@ -4554,23 +4647,45 @@ static int nvme_init_sq_ioeventfd(NvmeSQueue *sq)
         return ret;
     }
 
-    event_notifier_set_handler(&sq->notifier, nvme_sq_notifier);
+    if (n->params.iothread) {
+        aio_set_event_notifier(n->ctx, &sq->notifier, nvme_sq_notifier,
+                               nvme_sq_poll, nvme_sq_poll_ready);
+    } else {
+        event_notifier_set_handler(&sq->notifier, nvme_sq_notifier);
+    }
     memory_region_add_eventfd(&n->iomem,
                               0x1000 + offset, 4, false, 0, &sq->notifier);
 
     return 0;
 }
 
+/* Runs in the iothread so that no handler of the queue is still active */
+static void nvme_detach_sq_bh(void *opaque)
+{
+    NvmeSQueue *sq = opaque;
+
+    qemu_bh_delete(sq->bh);
+    if (sq->ioeventfd_enabled) {
+        aio_set_event_notifier(sq->ctrl->ctx, &sq->notifier, NULL, NULL, NULL);
+    }
+}
+
 static void nvme_free_sq(NvmeSQueue *sq, NvmeCtrl *n)
 {
     uint16_t offset = sq->sqid << 3;
 
     n->sq[sq->sqid] = NULL;
-    qemu_bh_delete(sq->bh);
+    if (n->params.iothread && sq->sqid) {
+        aio_wait_bh_oneshot(n->ctx, nvme_detach_sq_bh, sq);
+    } else {
+        qemu_bh_delete(sq->bh);
+        if (sq->ioeventfd_enabled) {
+            event_notifier_set_handler(&sq->notifier, NULL);
+        }
+    }
     if (sq->ioeventfd_enabled) {
         memory_region_del_eventfd(&n->iomem,
                                   0x1000 + offset, 4, false, 0, &sq->notifier);
-        event_notifier_set_handler(&sq->notifier, NULL);
         event_notifier_cleanup(&sq->notifier);
     }
     g_free(sq->io_req);
@@ -4595,6 +4710,15 @@ static uint16_t nvme_del_sq(NvmeCtrl *n, NvmeRequest *req)
     trace_pci_nvme_del_sq(qid);
 
     sq = n->sq[qid];
+    if (n->params.iothread) {
+        /* requests complete in the iothread; cancel them and wait */
+        QTAILQ_FOREACH_SAFE(r, &sq->out_req_list, entry, next) {
+            assert(r->aiocb);
+            blk_aio_cancel_async(r->aiocb);
+        }
+        AIO_WAIT_WHILE(n->ctx, !QTAILQ_EMPTY(&sq->out_req_list));
+    }
+
     while (!QTAILQ_EMPTY(&sq->out_req_list)) {
         r = QTAILQ_FIRST(&sq->out_req_list);
         assert(r->aiocb);
@@ -4641,8 +4765,9 @@ static void nvme_init_sq(NvmeSQueue *sq, NvmeCtrl *n, uint64_t dma_addr,
         QTAILQ_INSERT_TAIL(&(sq->req_list), &sq->io_req[i], entry);
     }
 
-    sq->bh = qemu_bh_new_guarded(nvme_process_sq, sq,
-                                 &DEVICE(sq->ctrl)->mem_reentrancy_guard);
+    sq->bh = aio_bh_new_guarded(sqid ? n->ctx : qemu_get_aio_context(),
+                                nvme_process_sq, sq,
+                                &DEVICE(sq->ctrl)->mem_reentrancy_guard);
 
     if (n->dbbuf_enabled) {
         sq->db_addr = n->dbbuf_dbs + (sqid << 3);
@@ -5215,19 +5340,39 @@ static uint16_t nvme_get_log(NvmeCtrl *n, NvmeRequest *req)
     }
 }
 
+static void nvme_detach_cq_bh(void *opaque)
+{
+    NvmeCQueue *cq = opaque;
+
+    qemu_bh_delete(cq->bh);
+    if (cq->ioeventfd_enabled) {
+        aio_set_event_notifier(cq->ctrl->ctx, &cq->notifier, NULL, NULL, NULL);
+    }
+}
+
 static void nvme_free_cq(NvmeCQueue *cq, NvmeCtrl *n)
 {
     PCIDevice *pci = PCI_DEVICE(n);
     uint16_t offset = (cq->cqid << 3) + (1 << 2);
 
     n->cq[cq->cqid] = NULL;
-    qemu_bh_delete(cq->bh);
+    if (n->params.iothread && cq->cqid) {
+        aio_wait_bh_oneshot(n->ctx, nvme_detach_cq_bh, cq);
+    } else {
+        qemu_bh_delete(cq->bh);
+        if (cq->ioeventfd_enabled) {
+            event_notifier_set_handler(&cq->notifier, NULL);
+        }
+    }
     if (cq->ioeventfd_enabled) {
         memory_region_del_eventfd(&n->iomem,
                                   0x1000 + offset, 4, false, 0, &cq->notifier);
-        event_notifier_set_handler(&cq->notifier, NULL);
         event_notifier_cleanup(&cq->notifier);
     }
+    if (cq->irq_notifier_enabled) {
+        event_notifier_set_handler(&cq->irq_notifier, NULL);
+        event_notifier_cleanup(&cq->irq_notifier);
+    }
     if (msix_enabled(pci)) {
         msix_vector_unuse(pci, cq->vector);
     }
@@ -5292,9 +5437,16 @@ static void nvme_init_cq(NvmeCQueue *cq, NvmeCtrl *n, uint64_t dma_addr,
             }
         }
     }
+    if (n->params.iothread && cqid != 0) {
+        if (!event_notifier_init(&cq->irq_notifier, 0)) {
+            event_notifier_set_handler(&cq->irq_notifier, nvme_irq_notifier);
+            cq->irq_notifier_enabled = true;
+        }
+    }
     n->cq[cqid] = cq;
-    cq->bh = qemu_bh_new_guarded(nvme_post_cqes, cq,
-                                 &DEVICE(cq->ctrl)->mem_reentrancy_guard);
+    cq->bh = aio_bh_new_guarded(cqid ? n->ctx : qemu_get_aio_context(),
+                                nvme_post_cqes, cq,
+                                &DEVICE(cq->ctrl)->mem_reentrancy_guard);
 }
 
 static uint16_t nvme_create_cq(NvmeCtrl *n, NvmeRequest *req)
@@ -6411,7 +6563,14 @@ static uint16_t nvme_ns_attachment(NvmeCtrl *n, NvmeRequest *req)
                 return NVME_NS_PRIVATE | NVME_DNR;
             }
 
-            nvme_attach_ns(ctrl, ns);
+            /* moving the namespace between AioContexts drains it */
+            aio_context_release(n->ctx);
+            ret = nvme_attach_ns(ctrl, ns, NULL);
+            aio_context_acquire(n->ctx);
+            if (ret) {
+                return NVME_NS_CTRL_LIST_INVALID | NVME_DNR;
+            }
+
             nvme_select_iocs_ns(ctrl, ns);
 
             break;
@@ -7009,6 +7168,8 @@ static void nvme_process_sq(void *opaque)
     NvmeCmd cmd;
     NvmeRequest *req;
 
+    aio_context_acquire(n->ctx);
+
     if (n->dbbuf_enabled) {
         nvme_update_sq_tail(sq);
     }
@@ -7042,6 +7203,8 @@ static void nvme_process_sq(void *opaque)
             nvme_update_sq_tail(sq);
         }
     }
+
+    aio_context_release(n->ctx);
 }
 
 static void nvme_update_msixcap_ts(PCIDevice *pci_dev, uint32_t table_size)
@@ -7728,11 +7891,13 @@ static void nvme_mmio_write(void *opaque, hwaddr addr, uint64_t data,
         return;
     }
 
+    aio_context_acquire(n->ctx);
     if (addr < sizeof(n->bar)) {
         nvme_write_bar(n, addr, data, size);
     } else {
         nvme_process_db(n, addr, data);
     }
+    aio_context_release(n->ctx);
 }
 
 static const MemoryRegionOps nvme_mmio_ops = {
@@ -8294,16 +8459,48 @@ static int nvme_init_subsys(NvmeCtrl *n, Error **errp)
     return 0;
 }
 
-void nvme_attach_ns(NvmeCtrl *n, NvmeNamespace *ns)
+static int nvme_ns_set_aio_context(NvmeNamespace *ns, AioContext *ctx,
+                                   Error **errp)
+{
+    BlockBackend *blk = ns->blkconf.blk;
+    AioContext *old_ctx = blk_get_aio_context(blk);
+    int ret;
+
+    if (old_ctx == ctx) {
+        return 0;
+    }
+
+    aio_context_acquire(old_ctx);
+    ret = blk_set_aio_context(blk, ctx, errp);
+    aio_context_release(old_ctx);
+
+    return ret;
+}
+
+int nvme_attach_ns(NvmeCtrl *n, NvmeNamespace *ns, Error **errp)
 {
     uint32_t nsid = ns->params.nsid;
     assert(nsid && nsid <= NVME_MAX_NAMESPACES);
 
+    if (blk_get_aio_context(ns->blkconf.blk) != n->ctx) {
+        if (ns->attached) {
+            error_setg(errp, "namespace %u is attached to a controller "
+                       "running in a different iothread", nsid);
+            return -1;
+        }
+
+        if (nvme_ns_set_aio_context(ns, n->ctx, errp) < 0) {
+            return -1;
+        }
+    }
+
     n->namespaces[nsid] = ns;
     ns->attached++;
 
     n->dmrsl = MIN_NON_ZERO(n->dmrsl,
                             BDRV_REQUEST_MAX_BYTES / nvme_l2b(ns, 1));
+
+    return 0;
 }
 
 static void nvme_realize(PCIDevice *pci_dev, Error **errp)
@@ -8326,6 +8523,12 @@ static void nvme_realize(PCIDevice *pci_dev, Error **errp)
         return;
     }
 
+    if (n->params.iothread) {
+        n->ctx = iothread_get_aio_context(n->params.iothread);
+    } else {
+        n->ctx = qemu_get_aio_context();
+    }
+
     qbus_init(&n->bus, sizeof(NvmeBus), TYPE_NVME_BUS, dev, dev->id);
 
     if (nvme_init_subsys(n, errp)) {
@@ -8346,7 +8549,9 @@ static void nvme_realize(PCIDevice *pci_dev, Error **errp)
             return;
         }
 
-        nvme_attach_ns(n, ns);
+        if (nvme_attach_ns(n, ns, errp)) {
+            return;
+        }
     }
 }
 
@@ -8356,16 +8561,27 @@ static void nvme_exit(PCIDevice *pci_dev)
     NvmeNamespace *ns;
     int i;
 
+    aio_context_acquire(n->ctx);
     nvme_ctrl_reset(n, NVME_RESET_FUNCTION);
+    aio_context_release(n->ctx);
 
-    if (n->subsys) {
-        for (i = 1; i <= NVME_MAX_NAMESPACES; i++) {
-            ns = nvme_ns(n, i);
-            if (ns) {
-                ns->attached--;
-            }
+    for (i = 1; i <= NVME_MAX_NAMESPACES; i++) {
+        ns = nvme_ns(n, i);
+        if (!ns) {
+            continue;
+        }
+
+        if (n->subsys) {
+            ns->attached--;
         }
 
+        /* hand the namespace back to the main loop once it is unused */
+        if (n->params.iothread && !(n->subsys && ns->attached)) {
+            nvme_ns_set_aio_context(ns, qemu_get_aio_context(), NULL);
+        }
+    }
+
+    if (n->subsys) {
         nvme_subsys_unregister_ctrl(n->subsys, n);
     }
 
@@ -8407,6 +8623,8 @@ static Property nvme_props[] = {
     DEFINE_PROP_BOOL("use-intel-id", NvmeCtrl, params.use_intel_id, false),
     DEFINE_PROP_BOOL("legacy-cmb", NvmeCtrl, params.legacy_cmb, false),
     DEFINE_PROP_BOOL("ioeventfd", NvmeCtrl, params.ioeventfd, false),
+    DEFINE_PROP_LINK("iothread", NvmeCtrl, params.iothread, TYPE_IOTHREAD,
+                     IOThread *),
     DEFINE_PROP_UINT8("zoned.zasl", NvmeCtrl, params.zasl, 0),
     DEFINE_PROP_BOOL("zoned.auto_transition", NvmeCtrl,
                      params.auto_transition_zones, true),
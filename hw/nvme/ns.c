@@ -778,8 +778,9 @@ static void nvme_ns_realize(DeviceState *dev, Error **errp)
             for (i = 0; i < ARRAY_SIZE(subsys->ctrls); i++) {
                 NvmeCtrl *ctrl = subsys->ctrls[i];
 
-                if (ctrl && ctrl != SUBSYS_SLOT_RSVD) {
-                    nvme_attach_ns(ctrl, ns);
+                if (ctrl && ctrl != SUBSYS_SLOT_RSVD &&
+                    nvme_attach_ns(ctrl, ns, errp)) {
+                    return;
                 }
             }
 
@@ -788,7 +789,7 @@ static void nvme_ns_realize(DeviceState *dev, Error **errp)
 
     }
 
-    nvme_attach_ns(n, ns);
+    nvme_attach_ns(n, ns, errp);
 }
 
 static Property nvme_ns_props[] = {
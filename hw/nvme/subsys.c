@@ -92,8 +92,10 @@ int nvme_subsys_register_ctrl(NvmeCtrl *n, Error **errp)
 
     for (nsid = 1; nsid < ARRAY_SIZE(subsys->namespaces); nsid++) {
         NvmeNamespace *ns = subsys->namespaces[nsid];
-        if (ns && ns->params.shared && !ns->params.detached) {
-            nvme_attach_ns(n, ns);
+        if (ns && ns->params.shared && !ns->params.detached &&
+            nvme_attach_ns(n, ns, errp)) {
+            subsys->ctrls[cntlid] = NULL;
+            return -1;
         }
     }
 
@@ -16,6 +16,7 @@
 #include "qapi/qapi-commands-virtio.h"
 #include "trace.h"
 #include "qemu/error-report.h"
+#include "qemu/host-utils.h"
 #include "qemu/log.h"
 #include "qemu/main-loop.h"
 #include "qemu/module.h"
@@ -25,6 +26,7 @@
 #include "hw/virtio/vhost.h"
 #include "migration/qemu-file-types.h"
 #include "qemu/atomic.h"
+#include "qemu/stats64.h"
 #include "hw/virtio/virtio-bus.h"
 #include "hw/qdev-properties.h"
 #include "hw/virtio/virtio-access.h"
@@ -117,6 +119,37 @@ typedef struct VRingPackedDescEvent {
     uint16_t flags;
 } VRingPackedDescEvent ;
 
+/*
+ * Cache of freed VirtQueueElements in power-of-two size classes, from
+ * 1 << VQ_POOL_MIN_SHIFT bytes up.  Larger elements are not cached.
+ *
+ * Elements are allocated by the thread that pops from the virtqueue but
+ * can be freed from any thread.  As in the coroutine pool, frees go to a
+ * lock-free release list that the allocating side moves over in one go.
+ */
+enum {
+    VQ_POOL_MIN_SHIFT = 9,
+    VQ_POOL_CLASSES = 5,
+    VQ_POOL_MAX_FREE = 256,
+};
+
+typedef struct VirtQueuePoolEntry {
+    QSLIST_ENTRY(VirtQueuePoolEntry) next;
+} VirtQueuePoolEntry;
+
+struct VirtQueueElementPool {
+    /* One reference for the VirtQueue plus one per live element */
+    unsigned int refcnt;
+
+    QSLIST_HEAD(, VirtQueuePoolEntry) alloc_list[VQ_POOL_CLASSES];
+    QSLIST_HEAD(, VirtQueuePoolEntry) release_list[VQ_POOL_CLASSES];
+    unsigned int release_size[VQ_POOL_CLASSES];
+
+    Stat64 allocs;
+    Stat64 hits;
+    Stat64 frees;
+};
+
 struct VirtQueue
 {
     VRing vring;
@@ -152,6 +185,7 @@ struct VirtQueue
     EventNotifier guest_notifier;
     EventNotifier host_notifier;
     bool host_notifier_enabled;
+    VirtQueueElementPool *pool;
     QLIST_ENTRY(VirtQueue) node;
 };
 
@@ -1461,9 +1495,105 @@ void virtqueue_map(VirtIODevice *vdev, VirtQueueElement *elem)
                                                                         false);
 }
 
-static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_num)
+static void virtqueue_element_pool_unref(VirtQueueElementPool *pool)
+{
+    VirtQueuePoolEntry *entry, *next;
+    int i;
+
+    if (qatomic_fetch_dec(&pool->refcnt) != 1) {
+        return;
+    }
+
+    for (i = 0; i < VQ_POOL_CLASSES; i++) {
+        QSLIST_FOREACH_SAFE(entry, &pool->alloc_list[i], next, next) {
+            g_free(entry);
+        }
+        QSLIST_FOREACH_SAFE(entry, &pool->release_list[i], next, next) {
+            g_free(entry);
+        }
+    }
+    g_free(pool);
+}
+
+/* Called from the thread that pops from the virtqueue.  */
+static void *virtqueue_element_pool_alloc(VirtQueueElementPool *pool,
+                                          size_t size, unsigned int *cls)
+{
+    VirtQueuePoolEntry *entry;
+    unsigned int i;
+
+    stat64_add(&pool->allocs, 1);
+
+    i = size <= (1 << VQ_POOL_MIN_SHIFT) ? 0 :
+        64 - clz64(size - 1) - VQ_POOL_MIN_SHIFT;
+    if (i >= VQ_POOL_CLASSES) {
+        *cls = VQ_POOL_CLASSES;
+        return g_malloc(size);
+    }
+
+    qatomic_inc(&pool->refcnt);
+    *cls = i;
+
+    entry = QSLIST_FIRST(&pool->alloc_list[i]);
+    if (!entry && qatomic_read(&pool->release_size[i])) {
+        qatomic_set(&pool->release_size[i], 0);
+        QSLIST_MOVE_ATOMIC(&pool->alloc_list[i], &pool->release_list[i]);
+        entry = QSLIST_FIRST(&pool->alloc_list[i]);
+    }
+    if (entry) {
+        QSLIST_REMOVE_HEAD(&pool->alloc_list[i], next);
+        stat64_add(&pool->hits, 1);
+        return entry;
+    }
+    return g_malloc(1 << (VQ_POOL_MIN_SHIFT + i));
+}
+
+/*
+ * Free an element returned by virtqueue_pop() or qemu_get_virtqueue_element().
+ * Devices that call virtio_queue_enable_element_pool() must free their
+ * elements with this function rather than g_free().
+ */
+void virtqueue_element_free(VirtQueueElement *elem)
+{
+    VirtQueueElementPool *pool = elem->pool;
+    unsigned int i = elem->pool_class;
+
+    if (!pool) {
+        g_free(elem);
+        return;
+    }
+
+    stat64_add(&pool->frees, 1);
+    if (i == VQ_POOL_CLASSES) {
+        g_free(elem);
+        return;
+    }
+
+    /* Not exact, but the limit is only there to bound memory usage */
+    if (qatomic_read(&pool->release_size[i]) < VQ_POOL_MAX_FREE) {
+        QSLIST_INSERT_HEAD_ATOMIC(&pool->release_list[i],
+                                  (VirtQueuePoolEntry *)elem, next);
+        qatomic_inc(&pool->release_size[i]);
+    } else {
+        g_free(elem);
+    }
+    virtqueue_element_pool_unref(pool);
+}
+
+void virtio_queue_enable_element_pool(VirtQueue *vq)
+{
+    if (!vq->pool) {
+        vq->pool = g_new0(VirtQueueElementPool, 1);
+        vq->pool->refcnt = 1;
+    }
+}
+
+static void *virtqueue_alloc_element(VirtQueue *vq, size_t sz,
+                                     unsigned out_num, unsigned in_num)
 {
     VirtQueueElement *elem;
+    VirtQueueElementPool *pool = vq ? vq->pool : NULL;
+    unsigned int pool_class = 0;
     size_t in_addr_ofs = QEMU_ALIGN_UP(sz, __alignof__(elem->in_addr[0]));
     size_t out_addr_ofs = in_addr_ofs + in_num * sizeof(elem->in_addr[0]);
     size_t out_addr_end = out_addr_ofs + out_num * sizeof(elem->out_addr[0]);
@@ -1472,8 +1602,14 @@ static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_nu
     size_t out_sg_end = out_sg_ofs + out_num * sizeof(elem->out_sg[0]);
 
     assert(sz >= sizeof(VirtQueueElement));
-    elem = g_malloc(out_sg_end);
+    if (pool) {
+        elem = virtqueue_element_pool_alloc(pool, out_sg_end, &pool_class);
+    } else {
+        elem = g_malloc(out_sg_end);
+    }
     trace_virtqueue_alloc_element(elem, sz, in_num, out_num);
+    elem->pool = pool;
+    elem->pool_class = pool_class;
     elem->out_num = out_num;
     elem->in_num = in_num;
     elem->in_addr = (void *)elem + in_addr_ofs;
@@ -1483,10 +1619,16 @@ static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_nu
     return elem;
 }
 
-static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
+/*
+ * Pop one element from a split ring.  Updating the avail event index is
+ * left to the caller so that a batch of pops only writes it once.
+ *
+ * Called within rcu_read_lock().
+ */
+static void *virtqueue_split_pop_rcu(VirtQueue *vq, size_t sz,
+                                     VRingMemoryRegionCaches *caches)
 {
     unsigned int i, head, max;
-    VRingMemoryRegionCaches *caches;
     MemoryRegionCache indirect_desc_cache = MEMORY_REGION_CACHE_INVALID;
     MemoryRegionCache *desc_cache;
     int64_t len;
@@ -1498,7 +1640,6 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
     VRingDesc desc;
     int rc;
 
-    RCU_READ_LOCK_GUARD();
     if (virtio_queue_empty_rcu(vq)) {
         goto done;
     }
@@ -1520,13 +1661,8 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
         goto done;
     }
 
-    if (virtio_vdev_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX)) {
-        vring_set_avail_event(vq, vq->last_avail_idx);
-    }
-
     i = head;
 
-    caches = vring_get_region_caches(vq);
     if (!caches) {
         virtio_error(vdev, "Region caches not initialized");
         goto done;
@@ -1595,7 +1731,7 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
     }
 
     /* Now copy what we have collected and mapped */
-    elem = virtqueue_alloc_element(sz, out_num, in_num);
+    elem = virtqueue_alloc_element(vq, sz, out_num, in_num);
     elem->index = head;
     elem->ndescs = 1;
     for (i = 0; i < out_num; i++) {
@@ -1620,10 +1756,11 @@ err_undo_map:
     goto done;
 }
 
-static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
+/* Called within rcu_read_lock().  */
+static void *virtqueue_packed_pop_rcu(VirtQueue *vq, size_t sz,
+                                      VRingMemoryRegionCaches *caches)
 {
     unsigned int i, max;
-    VRingMemoryRegionCaches *caches;
     MemoryRegionCache indirect_desc_cache = MEMORY_REGION_CACHE_INVALID;
     MemoryRegionCache *desc_cache;
     int64_t len;
@@ -1636,7 +1773,6 @@ static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
     uint16_t id;
     int rc;
 
-    RCU_READ_LOCK_GUARD();
     if (virtio_queue_packed_empty_rcu(vq)) {
         goto done;
     }
@@ -1653,7 +1789,6 @@ static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
 
     i = vq->last_avail_idx;
 
-    caches = vring_get_region_caches(vq);
     if (!caches) {
         virtio_error(vdev, "Region caches not initialized");
         goto done;
@@ -1721,7 +1856,7 @@ static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
     } while (rc == VIRTQUEUE_READ_DESC_MORE);
 
     /* Now copy what we have collected and mapped */
-    elem = virtqueue_alloc_element(sz, out_num, in_num);
+    elem = virtqueue_alloc_element(vq, sz, out_num, in_num);
     for (i = 0; i < out_num; i++) {
         elem->out_addr[i] = addr[i];
         elem->out_sg[i] = iov[i];
@@ -1755,17 +1890,89 @@ err_undo_map:
     goto done;
 }
 
-void *virtqueue_pop(VirtQueue *vq, size_t sz)
+static unsigned int virtqueue_split_pop_batch(VirtQueue *vq, size_t sz,
+                                              void **elems, unsigned int max)
+{
+    VRingMemoryRegionCaches *caches;
+    uint16_t start = vq->last_avail_idx;
+    unsigned int n = 0;
+
+    RCU_READ_LOCK_GUARD();
+    if (virtio_queue_empty_rcu(vq)) {
+        return 0;
+    }
+
+    /*
+     * The avail index has been read at most once above; only pop what it
+     * advertised so that the batch does not go back to guest memory for it.
+     */
+    max = MIN(max, (uint16_t)(vq->shadow_avail_idx - vq->last_avail_idx));
+
+    caches = vring_get_region_caches(vq);
+    while (n < max) {
+        elems[n] = virtqueue_split_pop_rcu(vq, sz, caches);
+        if (!elems[n]) {
+            break;
+        }
+        n++;
+    }
+
+    if (vq->last_avail_idx != start &&
+        virtio_vdev_has_feature(vq->vdev, VIRTIO_RING_F_EVENT_IDX)) {
+        vring_set_avail_event(vq, vq->last_avail_idx);
+    }
+
+    return n;
+}
+
+static unsigned int virtqueue_packed_pop_batch(VirtQueue *vq, size_t sz,
+                                               void **elems, unsigned int max)
+{
+    VRingMemoryRegionCaches *caches;
+    unsigned int n = 0;
+
+    RCU_READ_LOCK_GUARD();
+    caches = vring_get_region_caches(vq);
+    while (n < max) {
+        elems[n] = virtqueue_packed_pop_rcu(vq, sz, caches);
+        if (!elems[n]) {
+            break;
+        }
+        n++;
+    }
+
+    return n;
+}
+
+/*
+ * Pop up to @max elements into @elems, each allocated as by virtqueue_pop().
+ * The ring caches are looked up and the avail index is read once for the
+ * whole batch.  Returns the number of elements popped; elements that the
+ * caller ends up not processing must be returned with virtqueue_unpop() in
+ * reverse order.
+ */
+unsigned int virtqueue_pop_batch(VirtQueue *vq, size_t sz, void **elems,
+                                 unsigned int max)
 {
     if (virtio_device_disabled(vq->vdev)) {
-        return NULL;
+        return 0;
     }
 
     if (virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED)) {
-        return virtqueue_packed_pop(vq, sz);
+        return virtqueue_packed_pop_batch(vq, sz, elems, max);
     } else {
-        return virtqueue_split_pop(vq, sz);
+        return virtqueue_split_pop_batch(vq, sz, elems, max);
+    }
+}
+
+void *virtqueue_pop(VirtQueue *vq, size_t sz)
+{
+    void *elem;
+
+    if (!virtqueue_pop_batch(vq, sz, &elem, 1)) {
+        return NULL;
     }
+    return elem;
 }
 
 static unsigned int virtqueue_packed_drop_all(VirtQueue *vq)
@@ -1903,7 +2110,7 @@ void *qemu_get_virtqueue_element(VirtIODevice *vdev, QEMUFile *f, size_t sz)
     assert(ARRAY_SIZE(data.in_addr) >= data.in_num);
     assert(ARRAY_SIZE(data.out_addr) >= data.out_num);
 
-    elem = virtqueue_alloc_element(sz, data.out_num, data.in_num);
+    elem = virtqueue_alloc_element(NULL, sz, data.out_num, data.in_num);
     elem->index = data.index;
 
     for (i = 0; i < elem->in_num; i++) {
@@ -2325,6 +2532,10 @@ void virtio_delete_queue(VirtQueue *vq)
     vq->handle_output = NULL;
     g_free(vq->used_elems);
     vq->used_elems = NULL;
+    if (vq->pool) {
+        virtqueue_element_pool_unref(vq->pool);
+        vq->pool = NULL;
+    }
     virtio_virtqueue_reset_region_cache(vq);
 }
 
@@ -3884,6 +4095,17 @@ VirtQueueStatus *qmp_x_query_virtio_queue_status(const char *path,
     status->signalled_used = vdev->vq[queue].signalled_used;
     status->signalled_used_valid = vdev->vq[queue].signalled_used_valid;
 
+    if (vdev->vq[queue].pool) {
+        VirtQueueElementPool *pool = vdev->vq[queue].pool;
+
+        status->has_pool_allocs = true;
+        status->pool_allocs = stat64_get(&pool->allocs);
+        status->has_pool_hits = true;
+        status->pool_hits = stat64_get(&pool->hits);
+        status->has_pool_frees = true;
+        status->pool_frees = stat64_get(&pool->frees);
+    }
+
     if (vdev->vhost_started) {
         VirtioDeviceClass *vdc = VIRTIO_DEVICE_GET_CLASS(vdev);
         struct vhost_dev *hdev = vdc->get_vhost(vdev);
@@ -215,6 +215,19 @@ typedef enum {
     BDRV_REQ_MASK               = 0x7ff,
 } BdrvRequestFlags;
 
+/*
+ * One read request of a batch submitted with bdrv_co_preadv_batch() or
+ * blk_co_preadv_batch().  @ret is filled in when the batch completes.
+ */
+struct BdrvBatchRequest {
+    int64_t offset;
+    int64_t bytes;
+    QEMUIOVector *qiov;
+    size_t qiov_offset;
+    BdrvRequestFlags flags;
+    int ret;
+};
+
 #define BDRV_O_NO_SHARE    0x0001 /* don't share permissions */
 #define BDRV_O_RDWR        0x0002
 #define BDRV_O_RESIZE      0x0004 /* request permission for resizing the node */
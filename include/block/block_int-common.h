@@ -532,6 +532,36 @@ struct BlockDriver {
         QEMUIOVector *qiov, size_t qiov_offset,
         BdrvRequestFlags flags);
 
+    /**
+     * Read several ranges at once, ideally with a single submission to
+     * the host and a single coroutine switch for the whole batch.
+     *
+     * Each request has the same guarantees as for .bdrv_co_preadv:
+     * offset and bytes are aligned to 'request_alignment', bytes is no
+     * larger than 'max_transfer' and the request does not go past the end
+     * of the node.  In addition, @qiov_offset is 0 and @bytes is the size
+     * of @qiov.
+     *
+     * Fill in the @ret field of every request and return 0, or return
+     * -ENOTSUP without touching any request if the batch cannot be
+     * handled here; the requests are then submitted one by one.
+     */
+    int coroutine_fn GRAPH_RDLOCK_PTR (*bdrv_co_preadv_batch)(
+        BlockDriverState *bs, BdrvBatchRequest *reqs, int nb_reqs);
+
+    /**
+     * Read without a coroutine, for requests that can complete right away.
+     *
+     * The request has the same guarantees as for .bdrv_co_preadv, and
+     * does not go past the end of the node.  This is called outside
+     * coroutine context and must neither block nor poll.
+     *
+     * Return -EAGAIN without touching @qiov if the request cannot be
+     * completed immediately; it is then submitted again in a coroutine.
+     */
+    int GRAPH_RDLOCK_PTR (*bdrv_preadv_nowait)(BlockDriverState *bs,
+        int64_t offset, int64_t bytes, QEMUIOVector *qiov);
+
     int coroutine_fn GRAPH_RDLOCK_PTR (*bdrv_co_writev)(BlockDriverState *bs,
         int64_t sector_num, int nb_sectors, QEMUIOVector *qiov,
         int flags);
@@ -776,6 +806,14 @@ struct BlockDriver {
 
     int coroutine_fn GRAPH_RDLOCK_PTR (*bdrv_co_remove_persistent_dirty_bitmap)(
         BlockDriverState *bs, const char *name, Error **errp);
+
+    /*
+     * Called before a persistent bitmap is changed by anything other than a
+     * guest write (clear, merge, enable, ...), so that the driver can mark
+     * its stored copy as out of date first.
+     */
+    int coroutine_fn GRAPH_RDLOCK_PTR (
+        *bdrv_co_mark_persistent_dirty_bitmaps_in_use)(BlockDriverState *bs);
 };
 
 static inline bool TSA_NO_TSA block_driver_can_compress(BlockDriver *drv)
@@ -872,6 +910,14 @@ typedef struct BlockLimits {
      */
     bool has_variable_length;
 
+    /*
+     * true if reads can be completed without a coroutine, i.e. the driver
+     * implements .bdrv_preadv_nowait and so does every node it passes those
+     * reads on to.  Filters that forward .bdrv_preadv_nowait to a child
+     * must copy this from the child in .bdrv_refresh_limits.
+     */
+    bool preadv_nowait;
+
     /* device zone model */
     BlockZoneModel zoned;
 
@@ -50,6 +50,10 @@ int coroutine_fn GRAPH_RDLOCK bdrv_co_preadv(BdrvChild *child,
 int coroutine_fn GRAPH_RDLOCK bdrv_co_preadv_part(BdrvChild *child,
     int64_t offset, int64_t bytes,
     QEMUIOVector *qiov, size_t qiov_offset, BdrvRequestFlags flags);
+int coroutine_fn GRAPH_RDLOCK bdrv_co_preadv_batch(BdrvChild *child,
+    BdrvBatchRequest *reqs, int nb_reqs);
+int GRAPH_RDLOCK bdrv_preadv_nowait(BdrvChild *child,
+    int64_t offset, int64_t bytes, QEMUIOVector *qiov);
 int coroutine_fn GRAPH_RDLOCK bdrv_co_pwritev(BdrvChild *child,
     int64_t offset, int64_t bytes, QEMUIOVector *qiov,
     BdrvRequestFlags flags);
@@ -43,6 +43,11 @@ int co_wrapper_bdrv_rdlock
 bdrv_remove_persistent_dirty_bitmap(BlockDriverState *bs, const char *name,
                                     Error **errp);
 
+int coroutine_fn GRAPH_RDLOCK
+bdrv_co_mark_persistent_dirty_bitmaps_in_use(BlockDriverState *bs);
+int co_wrapper_mixed_bdrv_rdlock
+bdrv_mark_persistent_dirty_bitmaps_in_use(BlockDriverState *bs);
+
 void bdrv_disable_dirty_bitmap(BdrvDirtyBitmap *bitmap);
 void bdrv_enable_dirty_bitmap(BdrvDirtyBitmap *bitmap);
 void bdrv_enable_dirty_bitmap_locked(BdrvDirtyBitmap *bitmap);
@@ -79,6 +84,14 @@ void bdrv_dirty_bitmap_deserialize_ones(BdrvDirtyBitmap *bitmap,
                                         bool finish);
 void bdrv_dirty_bitmap_deserialize_finish(BdrvDirtyBitmap *bitmap);
 
+void bdrv_create_meta_dirty_bitmap(BdrvDirtyBitmap *bitmap, int chunk_size);
+void bdrv_release_meta_dirty_bitmap(BdrvDirtyBitmap *bitmap);
+bool bdrv_dirty_bitmap_has_meta(BdrvDirtyBitmap *bitmap);
+bool bdrv_dirty_bitmap_get_meta(BdrvDirtyBitmap *bitmap, int64_t offset,
+                                int64_t bytes);
+void bdrv_dirty_bitmap_reset_meta(BdrvDirtyBitmap *bitmap, int64_t offset,
+                                  int64_t bytes);
+
 void bdrv_dirty_bitmap_set_readonly(BdrvDirtyBitmap *bitmap, bool value);
 void bdrv_dirty_bitmap_set_persistence(BdrvDirtyBitmap *bitmap,
                                        bool persistent);
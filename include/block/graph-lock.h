@@ -159,6 +159,18 @@ bdrv_graph_co_rdlock(void);
 void coroutine_fn TSA_RELEASE_SHARED(graph_lock) TSA_NO_TSA
 bdrv_graph_co_rdunlock(void);
 
+/*
+ * bdrv_graph_rd{un}lock_nowait:
+ * Like bdrv_graph_co_rd{un}lock(), but usable outside coroutines.  Instead
+ * of waiting for a writer, bdrv_graph_rdlock_nowait() fails and returns
+ * false.  The caller must not poll or yield until it drops the lock.
+ */
+bool TSA_TRY_ACQUIRE_SHARED(true, graph_lock) TSA_NO_TSA
+bdrv_graph_rdlock_nowait(void);
+
+void TSA_RELEASE_SHARED(graph_lock) TSA_NO_TSA
+bdrv_graph_rdunlock_nowait(void);
+
 /*
  * bdrv_graph_rd{un}lock_main_loop:
  * Just a placeholder to mark where the graph rdlock should be taken
@@ -72,6 +72,8 @@ void luring_cleanup(LuringState *s);
 /* luring_co_submit: submit I/O requests in the thread's current AioContext. */
 int coroutine_fn luring_co_submit(BlockDriverState *bs, int fd, uint64_t offset,
                                   QEMUIOVector *qiov, int type);
+int coroutine_fn luring_co_preadv_batch(BlockDriverState *bs, int fd,
+                                        BdrvBatchRequest *reqs, int nb_reqs);
 void luring_detach_aio_context(LuringState *s, AioContext *old_context);
 void luring_attach_aio_context(LuringState *s, AioContext *new_context);
 #endif
@@ -26,6 +26,7 @@
 #define THROTTLE_GROUPS_H
 
 #include "qemu/coroutine.h"
+#include "qemu/thread.h"
 #include "qemu/throttle.h"
 #include "qom/object.h"
 
@@ -57,6 +58,13 @@ typedef struct ThrottleGroupMember {
     unsigned       pending_reqs[2];
     QLIST_ENTRY(ThrottleGroupMember) round_robin;
 
+    /* Part of the group's capacity reserved for this member, which its
+     * requests can spend without taking the ThrottleGroup lock.  It is
+     * protected by credit_lock, which nests inside the ThrottleGroup lock.
+     */
+    QemuSpin       credit_lock;
+    ThrottleCredit credit;
+
 } ThrottleGroupMember;
 
 #define TYPE_THROTTLE_GROUP "throttle-group"
@@ -89,6 +89,14 @@ struct TranslationBlock {
     uint16_t size;
     uint16_t icount;
 
+    /*
+     * Non-zero if the TB was translated without the TCG optimizer
+     * (see tb_tier_threshold): the number of lookups left before it
+     * is retranslated with full optimization.  Updated racily; it only
+     * decides when the retranslation happens.
+     */
+    uint32_t tier_countdown;
+
     struct tb_tc tc;
 
     /*
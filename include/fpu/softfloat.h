@@ -713,6 +713,20 @@ static inline bool float32_unordered_quiet(float32 a, float32 b,
 #define float32_three make_float32(0x40400000)
 #define float32_infinity make_float32(0x7f800000)
 
+/*----------------------------------------------------------------------------
+| Element-wise operations on @n-element vectors of float32. The destination
+| may alias either source. Equivalent to calling the scalar operation on
+| each element in turn, but amenable to host SIMD when hardfloat is usable.
+*----------------------------------------------------------------------------*/
+void float32_add_vec(float32 *, const float32 *, const float32 *, size_t,
+                     float_status *status);
+void float32_sub_vec(float32 *, const float32 *, const float32 *, size_t,
+                     float_status *status);
+void float32_mul_vec(float32 *, const float32 *, const float32 *, size_t,
+                     float_status *status);
+void float32_div_vec(float32 *, const float32 *, const float32 *, size_t,
+                     float_status *status);
+
 /*----------------------------------------------------------------------------
 | Packs the sign `zSign', exponent `zExp', and significand `zSig' into a
 | single-precision floating-point value, returning the result.  After being
@@ -909,6 +923,20 @@ static inline bool float64_unordered_quiet(float64 a, float64 b,
 #define float64_ln2 make_float64(0x3fe62e42fefa39efLL)
 #define float64_infinity make_float64(0x7ff0000000000000LL)
 
+/*----------------------------------------------------------------------------
+| Element-wise operations on @n-element vectors of float64. The destination
+| may alias either source. Equivalent to calling the scalar operation on
+| each element in turn, but amenable to host SIMD when hardfloat is usable.
+*----------------------------------------------------------------------------*/
+void float64_add_vec(float64 *, const float64 *, const float64 *, size_t,
+                     float_status *status);
+void float64_sub_vec(float64 *, const float64 *, const float64 *, size_t,
+                     float_status *status);
+void float64_mul_vec(float64 *, const float64 *, const float64 *, size_t,
+                     float_status *status);
+void float64_div_vec(float64 *, const float64 *, const float64 *, size_t,
+                     float_status *status);
+
 /*----------------------------------------------------------------------------
 | The pattern for a default generated double-precision NaN.
 *----------------------------------------------------------------------------*/
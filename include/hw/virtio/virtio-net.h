@@ -20,6 +20,7 @@
 #include "net/announce.h"
 #include "qemu/option_int.h"
 #include "qom/object.h"
+#include "qapi/qapi-types-virtio.h"
 
 #include "ebpf/ebpf_rss.h"
 
@@ -90,6 +91,8 @@ typedef struct VirtioNetRscStat {
     uint32_t purge_failed;
     uint32_t drain_failed;
     uint32_t final_failed;
+    uint32_t gro_final;
+    uint32_t gro_bypass;
     int64_t  timer;
 } VirtioNetRscStat;
 
@@ -110,6 +113,7 @@ typedef struct VirtioNetRscSeg {
     uint16_t packets;
     uint16_t dup_ack;
     bool is_coalesced;      /* need recall ipv4 header checksum, mark here */
+    uint16_t gso_size;      /* payload of the first segment, for GRO */
     VirtioNetRscUnit unit;
     NetClientState *nc;
 } VirtioNetRscSeg;
@@ -136,6 +140,8 @@ typedef struct VirtioNetRscChain {
 typedef struct VirtioNetRssData {
     bool    enabled;
     bool    enabled_software_rss;
+    /* software RSS is used only because eBPF can't hold the flow rules */
+    bool    flow_fallback;
     bool    redirect;
     bool    populate_hash;
     uint32_t hash_types;
@@ -154,6 +160,13 @@ typedef struct VirtIONetQueue {
     struct {
         VirtQueueElement *elem;
     } async_tx;
+    /* RX used ring updated during a batch, guest not notified yet */
+    bool rx_notify;
+    /* Counters for the "x-queue-stats" property */
+    uint64_t rx_packets;
+    uint64_t rx_bytes;
+    uint64_t tx_packets;
+    uint64_t tx_bytes;
     struct VirtIONet *n;
 } VirtIONetQueue;
 
@@ -176,6 +189,9 @@ struct VirtIONet {
     uint32_t rsc_timeout;
     uint8_t rsc4_enabled;
     uint8_t rsc6_enabled;
+    /* coalesce into GSO packets, rather than for VIRTIO_NET_F_RSC_EXT */
+    bool gro;
+    bool gro_enabled;
     uint8_t has_ufo;
     uint32_t mergeable_rx_bufs;
     uint8_t promisc;
@@ -208,6 +224,10 @@ struct VirtIONet {
     uint64_t saved_guest_offloads;
     AnnounceTimer announce_timer;
     bool needs_vnet_hdr_swap;
+    /* receiving a batch, RX interrupts are deferred to its end */
+    bool rx_batch;
+    /* flushes GRO after packets that were not received as a batch */
+    QEMUBH *gro_flush_bh;
     bool mtu_bypass_backend;
     /* primary failover device is hidden*/
     bool failover_primary_hidden;
@@ -217,6 +237,10 @@ struct VirtIONet {
     bool primary_opts_from_json;
     Notifier migration_state;
     VirtioNetRssData rss_data;
+    /* Flow steering rules, as set and returned by "x-flow-rules" */
+    VirtioNetFlowRuleList *flow_rules;
+    /* struct EBPFRSSFlowKey -> queue pair index + 1 */
+    GHashTable *flow_table;
     struct NetRxPkt *rx_pkt;
     struct EBPFRSSContext ebpf_rss;
 };
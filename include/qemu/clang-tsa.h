@@ -85,6 +85,15 @@
 #define TSA_ACQUIRE(...) TSA(acquire_capability(__VA_ARGS__))
 #define TSA_ACQUIRE_SHARED(...) TSA(acquire_shared_capability(__VA_ARGS__))
 
+/* TSA_TRY_ACQUIRE() is used to annotate functions that may fail to acquire
+ * the resource: the first argument is the return value that means success.
+ *
+ * bool Foo(void) TSA_TRY_ACQUIRE(true, mutex);
+ */
+#define TSA_TRY_ACQUIRE(...) TSA(try_acquire_capability(__VA_ARGS__))
+#define TSA_TRY_ACQUIRE_SHARED(...) \
+    TSA(try_acquire_shared_capability(__VA_ARGS__))
+
 /* TSA_RELEASE() is used to annotate functions: the caller of the
  * function MUST hold the resource, but the function will then release it.
  *
@@ -76,6 +76,25 @@ typedef void coroutine_fn CoroutineEntry(void *opaque);
  */
 Coroutine *qemu_coroutine_create(CoroutineEntry *entry, void *opaque);
 
+/**
+ * Stack sizes that coroutines can be created with.  Each of them has its
+ * own pool.
+ */
+typedef enum CoroutineStackClass {
+    COROUTINE_STACK_DEFAULT,
+    COROUTINE_STACK_SMALL,
+    COROUTINE_STACK__MAX,
+} CoroutineStackClass;
+
+/**
+ * Create a new coroutine with a small stack
+ *
+ * Like qemu_coroutine_create(), but the coroutine only gets a fraction of
+ * the default stack.  Only use this for entry points whose call chain is
+ * short and does not depend on the block graph or on guest input.
+ */
+Coroutine *qemu_coroutine_create_small(CoroutineEntry *entry, void *opaque);
+
 /**
  * Transfer control to a coroutine
  */
@@ -281,6 +281,29 @@ void qemu_coroutine_inc_pool_size(unsigned int additional_pool_size);
  */
 void qemu_coroutine_dec_pool_size(unsigned int additional_pool_size);
 
+/**
+ * Keep the coroutines that terminate in the calling thread in its own pool
+ * instead of sharing them with other threads, and never take coroutines
+ * that were released by other threads.  Stack pages are allocated by the
+ * first thread that touches them, so this keeps them on the memory node of
+ * a thread that is pinned to one.
+ */
+void qemu_coroutine_pool_set_thread_local(void);
+
+typedef struct CoroutinePoolStats {
+    uint64_t stack_size;    /* size of the stacks in this pool */
+    uint64_t hits;          /* coroutines that were reused */
+    uint64_t misses;        /* coroutines that needed a new stack */
+    uint64_t frees;         /* stacks that were freed */
+    uint64_t pooled;        /* terminated coroutines waiting for reuse */
+} CoroutinePoolStats;
+
+/**
+ * Get the counters of the pool for @stack_class, summed over all threads
+ */
+void qemu_coroutine_get_pool_stats(CoroutineStackClass stack_class,
+                                   CoroutinePoolStats *stats);
+
 #include "qemu/lockable.h"
 
 /**
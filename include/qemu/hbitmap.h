@@ -269,6 +269,37 @@ char *hbitmap_sha256(const HBitmap *bitmap, Error **errp);
  */
 void hbitmap_free(HBitmap *hb);
 
+/**
+ * hbitmap_create_meta:
+ * @hb: The HBitmap to operate on.
+ * @chunk_size: How many bits in @hb does one bit in the meta track.
+ *
+ * Create a "meta" hbitmap to track dirtiness of the bits in this HBitmap.
+ * The meta bitmap is owned by @hb and must be freed with hbitmap_free_meta()
+ * before @hb itself is freed.
+ *
+ * A bit that changes in @hb is always reflected in the meta bitmap, but the
+ * opposite is not guaranteed: operations that replace the contents of @hb
+ * wholesale may mark more chunks than have actually changed.
+ */
+HBitmap *hbitmap_create_meta(HBitmap *hb, int chunk_size);
+
+/**
+ * hbitmap_free_meta:
+ * @hb: The HBitmap whose meta bitmap should be released.
+ */
+void hbitmap_free_meta(HBitmap *hb);
+
+/**
+ * hbitmap_transfer_meta:
+ * @dst: The HBitmap that replaces @src.
+ * @src: The HBitmap whose meta bitmap is moved to @dst.
+ *
+ * Move the meta bitmap of @src, if any, to @dst and mark all of @dst as
+ * changed.
+ */
+void hbitmap_transfer_meta(HBitmap *dst, HBitmap *src);
+
 /**
  * hbitmap_iter_init:
  * @hbi: HBitmapIter to initialize.
@@ -350,4 +381,11 @@ bool hbitmap_status(const HBitmap *hb, int64_t start, int64_t count,
  */
 int64_t hbitmap_iter_next(HBitmapIter *hbi);
 
+/*
+ * Select the next accelerated implementation of the word scanning
+ * kernels.  Returns false once all of them have been used.  This is
+ * meant for tests and benchmarks only.
+ */
+bool test_hbitmap_next_accel(void);
+
 #endif
@@ -99,6 +99,18 @@ typedef struct ThrottleState {
     int64_t previous_leak;    /* timestamp of the last leak done */
 } ThrottleState;
 
+/* A part of the capacity of a ThrottleState that has been reserved in
+ * advance, so that its owner can account requests without taking the
+ * lock that protects the ThrottleState.  Reserved units are already
+ * included in the bucket levels; whatever is not used must be returned
+ * with throttle_credit_release().
+ */
+typedef struct ThrottleCredit {
+    double   units[BUCKETS_COUNT]; /* units left in each limited bucket */
+    unsigned limited;              /* bitmap of the limited buckets */
+    uint64_t op_size;              /* copy of cfg.op_size */
+} ThrottleCredit;
+
 typedef struct ThrottleTimers {
     QEMUTimer *timers[2];     /* timers used to do the throttling */
     QEMUClockType clock_type; /* the clock used */
@@ -151,7 +163,19 @@ bool throttle_schedule_timer(ThrottleState *ts,
                              ThrottleTimers *tt,
                              bool is_write);
 
+bool throttle_must_wait(ThrottleState *ts,
+                        QEMUClockType clock_type,
+                        bool is_write);
+
 void throttle_account(ThrottleState *ts, bool is_write, uint64_t size);
+
+/* accounting without the ThrottleState */
+bool throttle_credit_reserve(ThrottleState *ts, ThrottleCredit *credit,
+                             int64_t now, unsigned shares);
+bool throttle_credit_consume(ThrottleCredit *credit, bool is_write,
+                             uint64_t size);
+void throttle_credit_release(ThrottleState *ts, ThrottleCredit *credit);
+
 void throttle_limits_to_config(ThrottleLimits *arg, ThrottleConfig *cfg,
                                Error **errp);
 void throttle_config_to_limits(ThrottleConfig *cfg, ThrottleLimits *var);
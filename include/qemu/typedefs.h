@@ -29,6 +29,7 @@ typedef struct AioContext AioContext;
 typedef struct Aml Aml;
 typedef struct AnnounceTimer AnnounceTimer;
 typedef struct ArchCPU ArchCPU;
+typedef struct BdrvBatchRequest BdrvBatchRequest;
 typedef struct BdrvDirtyBitmap BdrvDirtyBitmap;
 typedef struct BdrvDirtyBitmapIter BdrvDirtyBitmapIter;
 typedef struct BlockBackend BlockBackend;
@@ -160,6 +160,16 @@ int coroutine_fn blk_co_preadv_part(BlockBackend *blk, int64_t offset,
                                     int64_t bytes, QEMUIOVector *qiov,
                                     size_t qiov_offset, BdrvRequestFlags flags);
 
+/*
+ * Submit several reads at once.  The result of each request is stored in its
+ * @ret field; the return value is 0 if all of them succeeded, or the first
+ * error otherwise.
+ */
+int co_wrapper_mixed blk_preadv_batch(BlockBackend *blk,
+                                      BdrvBatchRequest *reqs, int nb_reqs);
+int coroutine_fn blk_co_preadv_batch(BlockBackend *blk,
+                                     BdrvBatchRequest *reqs, int nb_reqs);
+
 int co_wrapper_mixed blk_pwrite(BlockBackend *blk, int64_t offset,
                                 int64_t bytes, const void *buf,
                                 BdrvRequestFlags flags);
@@ -22,6 +22,7 @@
 #include "qapi/error.h"
 #include "qapi/qapi-commands-misc.h"
 #include "qemu/error-report.h"
+#include "qemu/coroutine.h"
 #include "qemu/rcu.h"
 #include "qemu/main-loop.h"
 
@@ -47,6 +48,7 @@ static void *iothread_run(void *opaque)
      */
     g_main_context_push_thread_default(iothread->worker_context);
     qemu_set_current_aio_context(iothread->ctx);
+    qemu_coroutine_pool_set_thread_local();
     iothread->thread_id = qemu_get_thread_id();
     qemu_sem_post(&iothread->init_done_sem);
 
@@ -363,6 +365,27 @@ static int query_one_iothread(Object *object, void *opaque)
     return 0;
 }
 
+CoroutinePoolInfoList *qmp_x_query_coroutine_pool(Error **errp)
+{
+    CoroutinePoolInfoList *head = NULL;
+    CoroutinePoolInfoList **tail = &head;
+    CoroutineStackClass i;
+
+    for (i = 0; i < COROUTINE_STACK__MAX; i++) {
+        CoroutinePoolInfo *info = g_new0(CoroutinePoolInfo, 1);
+        CoroutinePoolStats stats;
+
+        qemu_coroutine_get_pool_stats(i, &stats);
+        info->stack_size = stats.stack_size;
+        info->hits = stats.hits;
+        info->misses = stats.misses;
+        info->pooled = stats.pooled;
+        info->stack_bytes = (stats.misses - stats.frees) * stats.stack_size;
+        QAPI_LIST_APPEND(tail, info);
+    }
+    return head;
+}
+
 IOThreadInfoList *qmp_query_iothreads(Error **errp)
 {
     IOThreadInfoList *head = NULL;
@@ -69,6 +69,7 @@ char *exec_path;
 char real_exec_path[PATH_MAX];
 
 static bool opt_one_insn_per_tb;
+static unsigned opt_tb_tier_threshold;
 static const char *argv0;
 static const char *gdbstub;
 static envlist_t *envlist;
@@ -411,6 +412,14 @@ static void handle_arg_one_insn_per_tb(const char *arg)
     opt_one_insn_per_tb = true;
 }
 
+static void handle_arg_tb_tier_threshold(const char *arg)
+{
+    if (qemu_strtoui(arg, NULL, 0, &opt_tb_tier_threshold) < 0) {
+        fprintf(stderr, "Invalid TB tier threshold: %s\n", arg);
+        exit(EXIT_FAILURE);
+    }
+}
+
 static void handle_arg_strace(const char *arg)
 {
     enable_strace = true;
@@ -502,6 +511,10 @@ static const struct qemu_argument arg_table[] = {
      "",           "run with one guest instruction per emulated TB"},
     {"singlestep", "QEMU_SINGLESTEP",  false, handle_arg_one_insn_per_tb,
      "",           "deprecated synonym for -one-insn-per-tb"},
+    {"tb-tier-threshold",
+                   "QEMU_TB_TIER_THRESHOLD", true, handle_arg_tb_tier_threshold,
+     "count",      "translate TBs unoptimized first, "
+     "optimize them after 'count' lookups"},
     {"strace",     "QEMU_STRACE",      false, handle_arg_strace,
      "",           "log system calls"},
     {"seed",       "QEMU_RAND_SEED",   true,  handle_arg_seed,
@@ -791,6 +804,8 @@ int main(int argc, char **argv, char **envp)
         accel_init_interfaces(ac);
         object_property_set_bool(OBJECT(accel), "one-insn-per-tb",
                                  opt_one_insn_per_tb, &error_abort);
+        object_property_set_uint(OBJECT(accel), "tb-tier-threshold",
+                                 opt_tb_tier_threshold, &error_abort);
         ac->init_machine(NULL);
     }
     cpu = cpu_create(cpu_type);
@@ -865,6 +865,78 @@ ssize_t qemu_sendv_packet_async(NetClientState *sender,
                                    iov, iovcnt, sent_cb);
 }
 
+static int qemu_deliver_packet_iov_batch(NetClientState *sender,
+                                         unsigned flags,
+                                         const NetPacketIOV *pkts,
+                                         int count,
+                                         void *opaque)
+{
+    NetClientState *nc = opaque;
+    int ret;
+
+    if (nc->link_down) {
+        return count;
+    }
+
+    if (nc->receive_disabled) {
+        return 0;
+    }
+
+    ret = nc->info->receive_iov_batch(nc, pkts, count);
+    if (ret < count) {
+        nc->receive_disabled = 1;
+    }
+
+    return ret;
+}
+
+/*
+ * Send @count packets to the peer of @sender.  Returns the number of packets
+ * that were sent or dropped.  If that is less than @count, the next packet
+ * has been queued and @sent_cb will be called for it, just like when
+ * qemu_sendv_packet_async() returns 0; the remaining packets are not sent.
+ *
+ * Peers that implement receive_iov_batch get the whole batch in one call
+ * unless net filters are attached, otherwise the packets go through
+ * qemu_sendv_packet_async() one at a time.
+ */
+int qemu_sendv_packet_batch_async(NetClientState *sender,
+                                  const NetPacketIOV *pkts, int count,
+                                  NetPacketSent *sent_cb)
+{
+    NetClientState *peer = sender->peer;
+    int i;
+
+    if (sender->link_down || !peer) {
+        return count;
+    }
+
+    if (!peer->info->receive_iov_batch ||
+        !QTAILQ_EMPTY(&sender->filters) || !QTAILQ_EMPTY(&peer->filters)) {
+        goto one_by_one;
+    }
+    for (i = 0; i < count; i++) {
+        if (iov_size(pkts[i].iov, pkts[i].iovcnt) > NET_BUFSIZE) {
+            goto one_by_one;
+        }
+    }
+
+    return qemu_net_queue_send_iov_batch(peer->incoming_queue, sender,
+                                         QEMU_NET_PACKET_FLAG_NONE,
+                                         pkts, count,
+                                         qemu_deliver_packet_iov_batch,
+                                         sent_cb);
+
+one_by_one:
+    for (i = 0; i < count; i++) {
+        if (!qemu_sendv_packet_async(sender, pkts[i].iov, pkts[i].iovcnt,
+                                     sent_cb)) {
+            break;
+        }
+    }
+    return i;
+}
+
 ssize_t
 qemu_sendv_packet(NetClientState *nc, const struct iovec *iov, int iovcnt)
 {
@@ -1082,6 +1154,12 @@ static int (* const net_client_init_fun[NET_CLIENT_DRIVER__MAX])(
 #ifdef CONFIG_NETMAP
         [NET_CLIENT_DRIVER_NETMAP]    = net_init_netmap,
 #endif
+#ifdef CONFIG_AF_XDP
+        [NET_CLIENT_DRIVER_AF_XDP]    = net_init_af_xdp,
+#endif
+#ifdef CONFIG_LINUX
+        [NET_CLIENT_DRIVER_SHM]       = net_init_shm,
+#endif
 #ifdef CONFIG_NET_BRIDGE
         [NET_CLIENT_DRIVER_BRIDGE]    = net_init_bridge,
 #endif
@@ -1186,6 +1264,12 @@ void show_netdevs(void)
 #ifdef CONFIG_NETMAP
         "netmap",
 #endif
+#ifdef CONFIG_AF_XDP
+        "af-xdp",
+#endif
+#ifdef CONFIG_LINUX
+        "shm",
+#endif
 #ifdef CONFIG_POSIX
         "vhost-user",
 #endif
@@ -254,6 +254,42 @@ ssize_t qemu_net_queue_send_iov(NetQueue *queue,
     return ret;
 }
 
+/* Like qemu_net_queue_send_iov(), but for @count packets at once.  Returns
+ * the number of packets that were delivered or dropped.  If that is less
+ * than @count, the next packet has been queued and @sent_cb will be invoked
+ * for it; the caller must not send the remaining ones before that.
+ */
+int qemu_net_queue_send_iov_batch(NetQueue *queue,
+                                  NetClientState *sender,
+                                  unsigned flags,
+                                  const NetPacketIOV *pkts,
+                                  int count,
+                                  NetQueueDeliverBatchFunc *deliver_batch,
+                                  NetPacketSent *sent_cb)
+{
+    int ret;
+
+    if (queue->delivering || !qemu_can_send_packet(sender)) {
+        qemu_net_queue_append_iov(queue, sender, flags,
+                                  pkts[0].iov, pkts[0].iovcnt, sent_cb);
+        return 0;
+    }
+
+    queue->delivering = 1;
+    ret = deliver_batch(sender, flags, pkts, count, queue->opaque);
+    queue->delivering = 0;
+
+    if (ret < count) {
+        qemu_net_queue_append_iov(queue, sender, flags,
+                                  pkts[ret].iov, pkts[ret].iovcnt, sent_cb);
+        return ret;
+    }
+
+    qemu_net_queue_flush(queue);
+
+    return ret;
+}
+
 void qemu_net_queue_purge(NetQueue *queue, NetClientState *from)
 {
     NetPacket *packet, *next;
@@ -0,0 +1,686 @@
+/*
+ * Shared-memory ring network backend.
+ *
+ * Connects two QEMU processes on the same host through a pair of
+ * single-producer single-consumer packet rings in a memfd, with eventfd
+ * doorbells.  The side started with server=on creates the memory and the
+ * doorbells and hands them to the other side over a UNIX socket.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include <sys/mman.h>
+
+#include "clients.h"
+#include "net/eth.h"
+#include "net/net.h"
+#include "qapi/error.h"
+#include "qemu/atomic.h"
+#include "qemu/error-report.h"
+#include "qemu/event_notifier.h"
+#include "qemu/host-utils.h"
+#include "qemu/iov.h"
+#include "qemu/main-loop.h"
+#include "qemu/memfd.h"
+#include "io/channel.h"
+#include "io/channel-socket.h"
+#include "io/net-listener.h"
+
+#define SHM_NET_MAGIC           0x4e4d48535551ULL   /* "QUSHMN" */
+#define SHM_NET_VERSION         1
+
+#define SHM_NET_RING_SIZE       256
+#define SHM_NET_MAX_RING_SIZE   4096
+#define SHM_NET_MIN_MTU         68
+#define SHM_NET_DEFAULT_MTU     1500
+#define SHM_NET_MAX_MTU         65535
+#define SHM_NET_MAX_SLOT_SIZE   \
+    ROUND_UP(sizeof(uint32_t) + ETH_MAX_L2_HDR_LEN + SHM_NET_MAX_MTU, 64)
+#define SHM_NET_SLOTS_OFFSET    4096
+
+/* Maximum number of packets passed to the peer at once */
+#define SHM_NET_BATCH           64
+/* Maximum number of batches handled per doorbell */
+#define SHM_NET_BUDGET          4
+
+/*
+ * Ring indices.  The producer owns @head and the consumer owns @tail; they
+ * live on separate cache lines so that the two processes do not bounce a
+ * line on every packet.  A side that finds the ring empty (consumer) or
+ * full (producer) sets its waiting flag and is kicked by the other side.
+ */
+typedef struct ShmNetRing {
+    uint32_t head QEMU_ALIGNED(64);
+    uint32_t producer_waiting;
+    uint32_t tail QEMU_ALIGNED(64);
+    uint32_t consumer_waiting;
+} ShmNetRing;
+
+typedef struct ShmNetHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t ring_size;
+    uint32_t slot_size;
+    uint32_t reserved;
+    /* rings[0] carries packets from the server, rings[1] from the client */
+    ShmNetRing rings[2];
+} ShmNetHeader;
+
+QEMU_BUILD_BUG_ON(sizeof(ShmNetHeader) > SHM_NET_SLOTS_OFFSET);
+
+typedef struct ShmNetSlot {
+    uint32_t len;
+    uint8_t data[];
+} ShmNetSlot;
+
+/* Sent by the server with the memfd and the two doorbells */
+typedef struct ShmNetHello {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t ring_size;
+    uint64_t size;
+    uint32_t slot_size;
+    uint32_t reserved;
+} ShmNetHello;
+
+enum {
+    SHM_NET_FD_MEM,
+    SHM_NET_FD_SERVER_BELL,
+    SHM_NET_FD_CLIENT_BELL,
+    SHM_NET_NFDS
+};
+
+typedef struct ShmNetState {
+    NetClientState nc;
+    bool server;
+
+    QIOChannel *listen_ioc;
+    QIONetListener *listener;
+    QIOChannel *ioc;
+    guint ioc_read_tag;
+
+    void *mem;
+    size_t size;
+    int mem_fd;
+    uint32_t ring_size;
+    uint32_t slot_size;
+    ShmNetRing *tx;
+    ShmNetRing *rx;
+    uint8_t *tx_slots;
+    uint8_t *rx_slots;
+    /* Private copy of the packets being passed to the peer */
+    uint8_t *rx_buf;
+
+    /* Kicked by the peer, and used to kick the peer */
+    EventNotifier bell;
+    EventNotifier peer_bell;
+    bool connected;
+    bool read_poll;
+} ShmNetState;
+
+/* Slots hold a frame of up to @mtu bytes of payload, with VLAN tags. */
+static uint32_t shm_net_slot_size(uint32_t mtu)
+{
+    return ROUND_UP(sizeof(uint32_t) + ETH_MAX_L2_HDR_LEN + mtu, 64);
+}
+
+static size_t shm_net_slot_data(ShmNetState *s)
+{
+    return s->slot_size - sizeof(uint32_t);
+}
+
+static size_t shm_net_size(uint32_t ring_size, uint32_t slot_size)
+{
+    return SHM_NET_SLOTS_OFFSET + 2 * (size_t)ring_size * slot_size;
+}
+
+static ShmNetSlot *shm_net_slot(ShmNetState *s, uint8_t *slots, uint32_t idx)
+{
+    return (ShmNetSlot *)(slots + (size_t)(idx & (s->ring_size - 1)) *
+                          s->slot_size);
+}
+
+static void shm_net_kick(ShmNetState *s, uint32_t *waiting)
+{
+    if (qatomic_read(waiting) && qatomic_xchg(waiting, 0)) {
+        event_notifier_set(&s->peer_bell);
+    }
+}
+
+/*
+ * Copy up to @count packets into the TX ring and publish them at once.
+ * Returns the number of packets consumed, which includes packets that are
+ * too big for a slot and get dropped, or 0 if the ring is full.
+ */
+static int shm_net_tx(ShmNetState *s, const NetPacketIOV *pkts, int count)
+{
+    ShmNetRing *ring = s->tx;
+    uint32_t head = ring->head;
+    uint32_t space;
+    int i;
+
+    space = s->ring_size - (head - qatomic_load_acquire(&ring->tail));
+    if (!space) {
+        /* Ask the consumer for a kick, then check again for a race. */
+        qatomic_set(&ring->producer_waiting, 1);
+        smp_mb();
+        space = s->ring_size - (head - qatomic_read(&ring->tail));
+        if (!space) {
+            return 0;
+        }
+        qatomic_set(&ring->producer_waiting, 0);
+        smp_mb_acquire();
+    }
+
+    for (i = 0; i < count && space; i++) {
+        ShmNetSlot *slot;
+        size_t len = iov_size(pkts[i].iov, pkts[i].iovcnt);
+
+        if (len > shm_net_slot_data(s)) {
+            continue;
+        }
+        slot = shm_net_slot(s, s->tx_slots, head++);
+        slot->len = iov_to_buf(pkts[i].iov, pkts[i].iovcnt, 0,
+                               slot->data, len);
+        space--;
+    }
+
+    qatomic_store_release(&ring->head, head);
+    smp_mb();
+    shm_net_kick(s, &ring->consumer_waiting);
+
+    return i;
+}
+
+static int shm_net_receive_iov_batch(NetClientState *nc,
+                                     const NetPacketIOV *pkts, int count)
+{
+    ShmNetState *s = DO_UPCAST(ShmNetState, nc, nc);
+    int done = 0;
+
+    while (done < count) {
+        int n = shm_net_tx(s, pkts + done, count - done);
+
+        if (!n) {
+            break;
+        }
+        done += n;
+    }
+    return done;
+}
+
+static ssize_t shm_net_receive_iov(NetClientState *nc,
+                                   const struct iovec *iov, int iovcnt)
+{
+    ShmNetState *s = DO_UPCAST(ShmNetState, nc, nc);
+    NetPacketIOV pkt = { .iov = iov, .iovcnt = iovcnt };
+
+    if (!shm_net_tx(s, &pkt, 1)) {
+        return 0;
+    }
+    return iov_size(iov, iovcnt);
+}
+
+static ssize_t shm_net_receive(NetClientState *nc,
+                               const uint8_t *buf, size_t size)
+{
+    struct iovec iov = {
+        .iov_base = (void *)buf,
+        .iov_len = size,
+    };
+
+    return shm_net_receive_iov(nc, &iov, 1);
+}
+
+static void shm_net_send(ShmNetState *s);
+
+static void shm_net_send_completed(NetClientState *nc, ssize_t len)
+{
+    ShmNetState *s = DO_UPCAST(ShmNetState, nc, nc);
+
+    s->read_poll = true;
+    shm_net_send(s);
+}
+
+/*
+ * Pass the packets on the RX ring to the peer.  The other process can
+ * still write to a slot after it has published it, so each packet is
+ * copied out of the shared memory before the peer looks at it, and its
+ * length is read only once.  The net layer makes its own copy of any
+ * packet it has to queue, so the private buffer is free again when
+ * qemu_sendv_packet_batch_async() returns.
+ */
+static void shm_net_send(ShmNetState *s)
+{
+    ShmNetRing *ring = s->rx;
+    NetPacketIOV pkts[SHM_NET_BATCH];
+    struct iovec iov[SHM_NET_BATCH];
+    uint32_t tail, avail, i, n, sent;
+    int budget = SHM_NET_BUDGET;
+
+    if (!s->connected) {
+        return;
+    }
+
+    while (s->read_poll && budget--) {
+        tail = ring->tail;
+        avail = qatomic_load_acquire(&ring->head) - tail;
+        if (!avail) {
+            /* Ask the producer for a kick, then check again for a race. */
+            qatomic_set(&ring->consumer_waiting, 1);
+            smp_mb();
+            avail = qatomic_read(&ring->head) - tail;
+            if (!avail) {
+                return;
+            }
+            qatomic_set(&ring->consumer_waiting, 0);
+            smp_mb_acquire();
+        }
+        if (avail > s->ring_size) {
+            error_report("shm: %s: corrupted RX ring, disabling receive",
+                         s->nc.name);
+            s->read_poll = false;
+            return;
+        }
+
+        n = MIN(avail, SHM_NET_BATCH);
+        for (i = 0; i < n; i++) {
+            ShmNetSlot *slot = shm_net_slot(s, s->rx_slots, tail + i);
+            uint8_t *buf = s->rx_buf + i * shm_net_slot_data(s);
+            size_t len = MIN(qatomic_read(&slot->len), shm_net_slot_data(s));
+
+            memcpy(buf, slot->data, len);
+            iov[i].iov_base = buf;
+            iov[i].iov_len = len;
+            pkts[i].iov = &iov[i];
+            pkts[i].iovcnt = 1;
+        }
+
+        sent = qemu_sendv_packet_batch_async(&s->nc, pkts, n,
+                                             shm_net_send_completed);
+        if (sent < n) {
+            /*
+             * The peer does not receive anymore.  Packet number @sent is
+             * queued, leave the rest on the ring until
+             * shm_net_send_completed().
+             */
+            s->read_poll = false;
+            n = sent + 1;
+        }
+
+        qatomic_store_release(&ring->tail, tail + n);
+        smp_mb();
+        shm_net_kick(s, &ring->producer_waiting);
+    }
+
+    /* Out of budget: come back from the main loop. */
+    if (s->read_poll) {
+        event_notifier_set(&s->bell);
+    }
+}
+
+static void shm_net_bell(EventNotifier *e)
+{
+    ShmNetState *s = container_of(e, ShmNetState, bell);
+
+    event_notifier_test_and_clear(e);
+
+    /* The peer may have made room on the TX ring. */
+    qemu_flush_queued_packets(&s->nc);
+    shm_net_send(s);
+}
+
+static void shm_net_poll(NetClientState *nc, bool enable)
+{
+    ShmNetState *s = DO_UPCAST(ShmNetState, nc, nc);
+
+    s->read_poll = enable;
+    if (enable) {
+        shm_net_send(s);
+    }
+}
+
+static void shm_net_reset_rings(ShmNetState *s)
+{
+    ShmNetHeader *hdr = s->mem;
+
+    memset(hdr->rings, 0, sizeof(hdr->rings));
+    smp_wmb();
+}
+
+static void shm_net_map_rings(ShmNetState *s)
+{
+    ShmNetHeader *hdr = s->mem;
+    uint8_t *slots = (uint8_t *)s->mem + SHM_NET_SLOTS_OFFSET;
+    size_t ring_bytes = (size_t)s->ring_size * s->slot_size;
+    int me = s->server ? 0 : 1;
+
+    s->tx = &hdr->rings[me];
+    s->rx = &hdr->rings[!me];
+    s->tx_slots = slots + me * ring_bytes;
+    s->rx_slots = slots + !me * ring_bytes;
+}
+
+static void shm_net_disconnect(ShmNetState *s);
+
+static gboolean shm_net_hup(QIOChannel *ioc, GIOCondition condition,
+                            gpointer data)
+{
+    ShmNetState *s = data;
+    char buf[16];
+
+    /* Nothing is sent after the hello; anything else ends the session. */
+    if (qio_channel_read(ioc, buf, sizeof(buf), NULL) ==
+        QIO_CHANNEL_ERR_BLOCK) {
+        return G_SOURCE_CONTINUE;
+    }
+    s->ioc_read_tag = 0;
+    shm_net_disconnect(s);
+    return G_SOURCE_REMOVE;
+}
+
+static void shm_net_connected(ShmNetState *s)
+{
+    s->rx_buf = g_malloc(SHM_NET_BATCH * shm_net_slot_data(s));
+    s->connected = true;
+    s->read_poll = true;
+    s->nc.link_down = false;
+    event_notifier_set_handler(&s->bell, shm_net_bell);
+    qemu_set_info_str(&s->nc, "shm %s, ring %u, slot %u",
+                      s->server ? "server" : "client", s->ring_size,
+                      s->slot_size);
+
+    /* Pick up anything that was published before the handler was set. */
+    shm_net_send(s);
+}
+
+static void shm_net_listen(QIONetListener *listener,
+                           QIOChannelSocket *cioc,
+                           void *opaque);
+
+static void shm_net_disconnect(ShmNetState *s)
+{
+    if (s->ioc_read_tag) {
+        g_source_remove(s->ioc_read_tag);
+        s->ioc_read_tag = 0;
+    }
+    if (s->ioc) {
+        object_unref(OBJECT(s->ioc));
+        s->ioc = NULL;
+    }
+
+    s->nc.link_down = true;
+    qemu_purge_queued_packets(&s->nc);
+    qemu_set_info_str(&s->nc, "%s", "");
+
+    if (!s->connected) {
+        return;
+    }
+    s->connected = false;
+    event_notifier_set_handler(&s->bell, NULL);
+    g_free(s->rx_buf);
+    s->rx_buf = NULL;
+
+    if (s->server) {
+        /* Wait for a new client; it starts with empty rings. */
+        shm_net_reset_rings(s);
+        if (s->listener) {
+            qio_net_listener_set_client_func(s->listener, shm_net_listen,
+                                             s, NULL);
+        }
+    } else {
+        event_notifier_cleanup(&s->bell);
+        event_notifier_cleanup(&s->peer_bell);
+        munmap(s->mem, s->size);
+        s->mem = NULL;
+    }
+}
+
+static void shm_net_listen(QIONetListener *listener,
+                           QIOChannelSocket *cioc,
+                           void *opaque)
+{
+    ShmNetState *s = opaque;
+    ShmNetHello hello = {
+        .magic = SHM_NET_MAGIC,
+        .version = SHM_NET_VERSION,
+        .ring_size = s->ring_size,
+        .size = s->size,
+        .slot_size = s->slot_size,
+    };
+    struct iovec iov = { .iov_base = &hello, .iov_len = sizeof(hello) };
+    int fds[SHM_NET_NFDS] = {
+        [SHM_NET_FD_MEM] = s->mem_fd,
+        [SHM_NET_FD_SERVER_BELL] = event_notifier_get_fd(&s->bell),
+        [SHM_NET_FD_CLIENT_BELL] = event_notifier_get_fd(&s->peer_bell),
+    };
+    Error *err = NULL;
+
+    if (qio_channel_writev_full_all(QIO_CHANNEL(cioc), &iov, 1,
+                                    fds, SHM_NET_NFDS, 0, &err) < 0) {
+        error_reportf_err(err, "shm: %s: ", s->nc.name);
+        return;
+    }
+
+    object_ref(OBJECT(cioc));
+    qio_net_listener_set_client_func(s->listener, NULL, s, NULL);
+
+    s->ioc = QIO_CHANNEL(cioc);
+    qio_channel_set_name(s->ioc, "shm-server");
+    s->ioc_read_tag = qio_channel_add_watch(s->ioc, G_IO_IN, shm_net_hup,
+                                            s, NULL);
+    shm_net_connected(s);
+}
+
+static gboolean shm_net_hello(QIOChannel *ioc, GIOCondition condition,
+                              gpointer data)
+{
+    ShmNetState *s = data;
+    ShmNetHello hello;
+    struct iovec iov = { .iov_base = &hello, .iov_len = sizeof(hello) };
+    g_autofree int *fds = NULL;
+    size_t i, nfds = 0;
+    struct stat st;
+    ssize_t ret;
+
+    ret = qio_channel_readv_full(ioc, &iov, 1, &fds, &nfds, 0, NULL);
+    if (ret == QIO_CHANNEL_ERR_BLOCK) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (ret != sizeof(hello) || nfds != SHM_NET_NFDS ||
+        hello.magic != SHM_NET_MAGIC || hello.version != SHM_NET_VERSION ||
+        !is_power_of_2(hello.ring_size) ||
+        hello.ring_size > SHM_NET_MAX_RING_SIZE ||
+        hello.slot_size % 64 || hello.slot_size <= sizeof(uint32_t) ||
+        hello.slot_size > SHM_NET_MAX_SLOT_SIZE ||
+        hello.size != shm_net_size(hello.ring_size, hello.slot_size) ||
+        fstat(fds[SHM_NET_FD_MEM], &st) < 0 || st.st_size < hello.size) {
+        error_report("shm: %s: invalid handshake from server", s->nc.name);
+        goto fail;
+    }
+
+    s->mem = mmap(NULL, hello.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  fds[SHM_NET_FD_MEM], 0);
+    if (s->mem == MAP_FAILED) {
+        s->mem = NULL;
+        error_report("shm: %s: failed to map shared memory: %s", s->nc.name,
+                     strerror(errno));
+        goto fail;
+    }
+    close(fds[SHM_NET_FD_MEM]);
+
+    s->size = hello.size;
+    s->ring_size = hello.ring_size;
+    s->slot_size = hello.slot_size;
+    event_notifier_init_fd(&s->bell, fds[SHM_NET_FD_CLIENT_BELL]);
+    event_notifier_init_fd(&s->peer_bell, fds[SHM_NET_FD_SERVER_BELL]);
+    shm_net_map_rings(s);
+
+    /* From now on, only watch for the server going away. */
+    s->ioc_read_tag = qio_channel_add_watch(s->ioc, G_IO_IN, shm_net_hup,
+                                            s, NULL);
+    shm_net_connected(s);
+    return G_SOURCE_REMOVE;
+
+fail:
+    for (i = 0; i < nfds; i++) {
+        close(fds[i]);
+    }
+    s->ioc_read_tag = 0;
+    shm_net_disconnect(s);
+    return G_SOURCE_REMOVE;
+}
+
+static void shm_net_client_connected(QIOTask *task, gpointer opaque)
+{
+    ShmNetState *s = opaque;
+    Error *err = NULL;
+
+    if (qio_task_propagate_error(task, &err)) {
+        error_reportf_err(err, "shm: %s: ", s->nc.name);
+        qemu_set_info_str(&s->nc, "connection error");
+        object_unref(OBJECT(s->ioc));
+        s->ioc = NULL;
+        return;
+    }
+
+    qio_channel_set_name(s->ioc, "shm-client");
+    s->ioc_read_tag = qio_channel_add_watch(s->ioc, G_IO_IN, shm_net_hello,
+                                            s, NULL);
+}
+
+static void shm_net_cleanup(NetClientState *nc)
+{
+    ShmNetState *s = DO_UPCAST(ShmNetState, nc, nc);
+
+    shm_net_disconnect(s);
+
+    if (s->listener) {
+        qio_net_listener_disconnect(s->listener);
+        object_unref(OBJECT(s->listener));
+        s->listener = NULL;
+    }
+    if (s->listen_ioc) {
+        object_unref(OBJECT(s->listen_ioc));
+        s->listen_ioc = NULL;
+    }
+    if (s->server) {
+        event_notifier_cleanup(&s->bell);
+        event_notifier_cleanup(&s->peer_bell);
+        qemu_memfd_free(s->mem, s->size, s->mem_fd);
+        s->mem = NULL;
+        s->mem_fd = -1;
+    }
+}
+
+static NetClientInfo net_shm_info = {
+    .type = NET_CLIENT_DRIVER_SHM,
+    .size = sizeof(ShmNetState),
+    .receive = shm_net_receive,
+    .receive_iov = shm_net_receive_iov,
+    .receive_iov_batch = shm_net_receive_iov_batch,
+    .poll = shm_net_poll,
+    .cleanup = shm_net_cleanup,
+};
+
+static int shm_net_server_init(ShmNetState *s, SocketAddress *addr,
+                               uint32_t ring_size, uint32_t mtu, Error **errp)
+{
+    ShmNetHeader *hdr;
+    QIOChannelSocket *listen_sioc;
+    int ret;
+
+    s->ring_size = ring_size;
+    s->slot_size = shm_net_slot_size(mtu);
+    s->size = shm_net_size(ring_size, s->slot_size);
+    s->mem = qemu_memfd_alloc("qemu-shm-net", s->size, 0, &s->mem_fd, errp);
+    if (!s->mem) {
+        return -1;
+    }
+
+    hdr = s->mem;
+    hdr->magic = SHM_NET_MAGIC;
+    hdr->version = SHM_NET_VERSION;
+    hdr->ring_size = ring_size;
+    hdr->slot_size = s->slot_size;
+    shm_net_reset_rings(s);
+    shm_net_map_rings(s);
+
+    ret = event_notifier_init(&s->bell, 0);
+    if (ret == 0) {
+        ret = event_notifier_init(&s->peer_bell, 0);
+    }
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "failed to create doorbell eventfd");
+        return -1;
+    }
+
+    listen_sioc = qio_channel_socket_new();
+    s->listen_ioc = QIO_CHANNEL(listen_sioc);
+    if (qio_channel_socket_listen_sync(listen_sioc, addr, 1, errp) < 0) {
+        return -1;
+    }
+
+    s->listener = qio_net_listener_new();
+    qio_net_listener_set_client_func(s->listener, shm_net_listen, s, NULL);
+    qio_net_listener_add(s->listener, listen_sioc);
+    return 0;
+}
+
+/*
+ * The exported init function.
+ *
+ * ... -netdev shm,id=n0,path=/run/vm.sock,server=on
+ */
+int net_init_shm(const Netdev *netdev, const char *name,
+                 NetClientState *peer, Error **errp)
+{
+    const NetdevShmOptions *opts = &netdev->u.shm;
+    SocketAddress addr = {
+        .type = SOCKET_ADDRESS_TYPE_UNIX,
+        .u.q_unix.path = opts->path,
+    };
+    uint32_t ring_size = opts->has_ring_size ? opts->ring_size
+                                             : SHM_NET_RING_SIZE;
+    uint32_t mtu = opts->has_mtu ? opts->mtu : SHM_NET_DEFAULT_MTU;
+    NetClientState *nc;
+    ShmNetState *s;
+
+    assert(netdev->type == NET_CLIENT_DRIVER_SHM);
+
+    if (!is_power_of_2(ring_size) || ring_size > SHM_NET_MAX_RING_SIZE) {
+        error_setg(errp, "ring-size must be a power of 2 no larger than %d",
+                   SHM_NET_MAX_RING_SIZE);
+        return -1;
+    }
+    if (mtu < SHM_NET_MIN_MTU || mtu > SHM_NET_MAX_MTU) {
+        error_setg(errp, "mtu must be between %d and %d",
+                   SHM_NET_MIN_MTU, SHM_NET_MAX_MTU);
+        return -1;
+    }
+
+    nc = qemu_new_net_client(&net_shm_info, peer, "shm", name);
+    s = DO_UPCAST(ShmNetState, nc, nc);
+    s->server = opts->has_server && opts->server;
+    s->mem_fd = -1;
+    s->nc.link_down = true;
+
+    if (s->server) {
+        if (shm_net_server_init(s, &addr, ring_size, mtu, errp) < 0) {
+            qemu_del_net_client(nc);
+            return -1;
+        }
+    } else {
+        QIOChannelSocket *sioc = qio_channel_socket_new();
+
+        s->ioc = QIO_CHANNEL(sioc);
+        qio_channel_socket_connect_async(sioc, &addr,
+                                         shm_net_client_connected, s,
+                                         NULL, NULL);
+    }
+
+    return 0;
+}
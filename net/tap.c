@@ -47,12 +47,27 @@
 
 #include "net/vhost_net.h"
 
+/*
+ * Maximum and default number of packets read from the tap fd before passing
+ * them to the peer, see the rx-batch option
+ */
+#define TAP_RX_BATCH 8
+
+/* Maximum number of packets processed per tap_send() callback */
+#define TAP_RX_BUDGET 50
+
 typedef struct TAPState {
     NetClientState nc;
     int fd;
     char down_script[1024];
     char down_script_arg[128];
     uint8_t buf[NET_BUFSIZE];
+    /*
+     * Buffers for the rest of a batch, allocated the first time the fd has
+     * that many packets ready.  Idle queues and vhost never need them.
+     */
+    uint8_t *batch_buf[TAP_RX_BATCH - 1];
+    unsigned rx_batch;
     bool read_poll;
     bool write_poll;
     bool using_vnet_hdr;
@@ -131,6 +146,25 @@ static ssize_t tap_receive_iov(NetClientState *nc, const struct iovec *iov,
     return tap_write_packet(s, iovp, iovcnt);
 }
 
+/*
+ * The tap character device accepts exactly one packet per write() and has
+ * no multi-packet write interface for user space, so a batch still costs
+ * one writev() per packet.  This only saves the per-packet trip through
+ * the net queue; it stops at the first packet that would block.
+ */
+static int tap_receive_iov_batch(NetClientState *nc, const NetPacketIOV *pkts,
+                                 int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (tap_receive_iov(nc, pkts[i].iov, pkts[i].iovcnt) == 0) {
+            break;
+        }
+    }
+    return i;
+}
+
 static ssize_t tap_receive_raw(NetClientState *nc, const uint8_t *buf, size_t size)
 {
     TAPState *s = DO_UPCAST(TAPState, nc, nc);
@@ -179,18 +213,32 @@ static void tap_send_completed(NetClientState *nc, ssize_t len)
     tap_read_poll(s, true);
 }
 
-static void tap_send(void *opaque)
+static uint8_t *tap_rx_buf(TAPState *s, int n)
 {
-    TAPState *s = opaque;
-    int size;
-    int packets = 0;
+    if (n == 0) {
+        return s->buf;
+    }
+    if (!s->batch_buf[n - 1]) {
+        s->batch_buf[n - 1] = g_malloc(NET_BUFSIZE);
+    }
+    return s->batch_buf[n - 1];
+}
+
+/*
+ * Read up to @max packets from the tap fd and point @pkts at them.  Returns
+ * the number of packets read.
+ */
+static int tap_read_batch(TAPState *s, NetPacketIOV *pkts, struct iovec *iov,
+                          int max)
+{
+    bool pad = net_peer_needs_padding(&s->nc);
+    int n;
 
-    while (true) {
-        uint8_t *buf = s->buf;
-        uint8_t min_pkt[ETH_ZLEN];
-        size_t min_pktsz = sizeof(min_pkt);
+    for (n = 0; n < max; n++) {
+        uint8_t *buf = tap_rx_buf(s, n);
+        int size;
 
-        size = tap_read_packet(s->fd, s->buf, sizeof(s->buf));
+        size = tap_read_packet(s->fd, buf, NET_BUFSIZE);
         if (size <= 0) {
             break;
         }
@@ -200,29 +248,62 @@ static void tap_send(void *opaque)
             size -= s->host_vnet_hdr_len;
         }
 
-        if (net_peer_needs_padding(&s->nc)) {
-            if (eth_pad_short_frame(min_pkt, &min_pktsz, buf, size)) {
-                buf = min_pkt;
-                size = min_pktsz;
-            }
+        /* The buffer is big enough to pad short frames in place. */
+        if (pad && size < ETH_ZLEN) {
+            memset(buf + size, 0, ETH_ZLEN - size);
+            size = ETH_ZLEN;
         }
 
-        size = qemu_send_packet_async(&s->nc, buf, size, tap_send_completed);
-        if (size == 0) {
-            tap_read_poll(s, false);
+        iov[n].iov_base = buf;
+        iov[n].iov_len = size;
+        pkts[n].iov = &iov[n];
+        pkts[n].iovcnt = 1;
+    }
+
+    return n;
+}
+
+static void tap_send(void *opaque)
+{
+    TAPState *s = opaque;
+    NetPacketIOV pkts[TAP_RX_BATCH];
+    struct iovec iov[TAP_RX_BATCH];
+    int packets = 0;
+
+    /*
+     * When the host keeps receiving more packets while tap_send() is
+     * running we can hog the QEMU global mutex.  Limit the number of
+     * packets that are processed per tap_send() callback to prevent
+     * stalling the guest.
+     */
+    while (packets < TAP_RX_BUDGET) {
+        int n, sent, i;
+
+        n = tap_read_batch(s, pkts, iov,
+                           MIN(s->rx_batch, TAP_RX_BUDGET - packets));
+        if (!n) {
             break;
-        } else if (size < 0) {
+        }
+
+        sent = qemu_sendv_packet_batch_async(&s->nc, pkts, n,
+                                             tap_send_completed);
+        if (sent < n) {
+            /*
+             * Packet number @sent was queued.  The ones after it have
+             * already been read from the fd, so queue them behind it and
+             * stop reading until the peer drains the queue.
+             */
+            for (i = sent + 1; i < n; i++) {
+                qemu_sendv_packet_async(&s->nc, pkts[i].iov, pkts[i].iovcnt,
+                                        tap_send_completed);
+            }
+            tap_read_poll(s, false);
             break;
         }
 
-        /*
-         * When the host keeps receiving more packets while tap_send() is
-         * running we can hog the QEMU global mutex.  Limit the number of
-         * packets that are processed per tap_send() callback to prevent
-         * stalling the guest.
-         */
-        packets++;
-        if (packets >= 50) {
+        packets += n;
+        if (n < s->rx_batch) {
+            /* The fd has been drained. */
             break;
         }
     }
@@ -333,6 +414,7 @@ static void tap_exit_notify(Notifier *notifier, void *data)
 static void tap_cleanup(NetClientState *nc)
 {
     TAPState *s = DO_UPCAST(TAPState, nc, nc);
+    int i;
 
     if (s->vhost_net) {
         vhost_net_cleanup(s->vhost_net);
@@ -349,6 +431,11 @@ static void tap_cleanup(NetClientState *nc)
     tap_write_poll(s, false);
     close(s->fd);
     s->fd = -1;
+
+    for (i = 0; i < ARRAY_SIZE(s->batch_buf); i++) {
+        g_free(s->batch_buf[i]);
+        s->batch_buf[i] = NULL;
+    }
 }
 
 static void tap_poll(NetClientState *nc, bool enable)
@@ -381,6 +468,7 @@ static NetClientInfo net_tap_info = {
     .receive = tap_receive,
     .receive_raw = tap_receive_raw,
     .receive_iov = tap_receive_iov,
+    .receive_iov_batch = tap_receive_iov_batch,
     .poll = tap_poll,
     .cleanup = tap_cleanup,
     .has_ufo = tap_has_ufo,
@@ -694,6 +782,8 @@ static void net_init_tap_one(const NetdevTapOptions *tap, NetClientState *peer,
     TAPState *s = net_tap_fd_init(peer, model, name, fd, vnet_hdr);
     int vhostfd;
 
+    s->rx_batch = tap->has_rx_batch ? tap->rx_batch : TAP_RX_BATCH;
+
     tap_set_sndbuf(s->fd, tap, &err);
     if (err) {
         error_propagate(errp, err);
@@ -835,6 +925,12 @@ int net_init_tap(const Netdev *netdev, const char *name,
         return -1;
     }
 
+    if (tap->has_rx_batch &&
+        (tap->rx_batch < 1 || tap->rx_batch > TAP_RX_BATCH)) {
+        error_setg(errp, "rx-batch must be between 1 and %d", TAP_RX_BATCH);
+        return -1;
+    }
+
     if (tap->fd) {
         if (tap->ifname || tap->script || tap->downscript ||
             tap->has_vnet_hdr || tap->helper || tap->has_queues ||
@@ -86,6 +86,7 @@ enum {
     OPTION_BITMAPS = 275,
     OPTION_FORCE = 276,
     OPTION_SKIP_BROKEN = 277,
+    OPTION_BATCH = 278,
 };
 
 typedef enum OutputFormat {
@@ -4396,6 +4397,34 @@ static void bench_cb(void *opaque, int ret)
     }
 }
 
+/* Read test that hands each group of b->nrreq requests over as one batch */
+static void bench_batch(BenchData *b)
+{
+    g_autofree BdrvBatchRequest *reqs = g_new(BdrvBatchRequest, b->nrreq);
+
+    while (b->n > 0) {
+        int nb_reqs = MIN(b->n, b->nrreq);
+        int i, ret;
+
+        for (i = 0; i < nb_reqs; i++) {
+            reqs[i] = (BdrvBatchRequest) {
+                .offset = b->offset,
+                .bytes  = b->bufsize,
+                .qiov   = &b->qiov[i],
+            };
+            b->offset += b->step;
+            b->offset %= b->image_size;
+        }
+
+        ret = blk_preadv_batch(b->blk, reqs, nb_reqs);
+        if (ret < 0) {
+            error_report("Failed request: %s", strerror(-ret));
+            exit(EXIT_FAILURE);
+        }
+        b->n -= nb_reqs;
+    }
+}
+
 static int img_bench(int argc, char **argv)
 {
     int c, ret = 0;
@@ -4419,11 +4448,13 @@ static int img_bench(int argc, char **argv)
     struct timeval t1, t2;
     int i;
     bool force_share = false;
+    bool batch = false;
     size_t buf_size = 0;
 
     for (;;) {
         static const struct option long_options[] = {
             {"help", no_argument, 0, 'h'},
+            {"batch", no_argument, 0, OPTION_BATCH},
             {"flush-interval", required_argument, 0, OPTION_FLUSH_INTERVAL},
             {"image-opts", no_argument, 0, OPTION_IMAGE_OPTS},
             {"pattern", required_argument, 0, OPTION_PATTERN},
@@ -4559,6 +4590,9 @@ static int img_bench(int argc, char **argv)
         case OPTION_NO_DRAIN:
             drain_on_flush = false;
             break;
+        case OPTION_BATCH:
+            batch = true;
+            break;
         case OPTION_IMAGE_OPTS:
             image_opts = true;
             break;
@@ -4575,6 +4609,11 @@ static int img_bench(int argc, char **argv)
         ret = -1;
         goto out;
     }
+    if (is_write && batch) {
+        error_report("--batch is only available in read tests");
+        ret = -1;
+        goto out;
+    }
     if (flush_interval && flush_interval < depth) {
         error_report("Flush interval can't be smaller than depth");
         ret = -1;
@@ -4628,7 +4667,11 @@ static int img_bench(int argc, char **argv)
     }
 
     gettimeofday(&t1, NULL);
-    bench_cb(&data, 0);
+    if (batch) {
+        bench_batch(&data);
+    } else {
+        bench_cb(&data, 0);
+    }
 
     while (data.n > 0) {
         main_loop_wait(false);
@@ -185,6 +185,7 @@ DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "                one-insn-per-tb=on|off (one guest instruction per TCG translation block)\n"
     "                split-wx=on|off (enable TCG split w^x mapping)\n"
     "                tb-size=n (TCG translation block cache size)\n"
+    "                tb-tier-threshold=n (retranslate quick TCG translation blocks after n lookups, default 0, disabled)\n"
     "                dirty-ring-size=n (KVM dirty ring GFN count, default 0)\n"
     "                eager-split-size=n (KVM Eager Page Split chunk size, default 0, disabled. ARM only)\n"
     "                notify-vmexit=run|internal-error|disable,notify-window=n (enable notify VM exit and set notify window, x86 only)\n"
@@ -227,6 +228,16 @@ SRST
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
 
+    ``tb-tier-threshold=n``
+        When non-zero, the TCG accelerator first translates each block
+        without running the TCG optimizer, and does not chain direct
+        jumps into it. Once the block has been looked up ``n`` times it
+        is translated again with full optimization and replaces the
+        quick version. This reduces the time spent translating code that
+        runs only a few times, e.g. during guest boot, at the cost of
+        some extra translations for hot code. The default is 0
+        (disabled).
+
     ``thread=single|multi``
         Controls number of TCG threads. When the TCG is multi-threaded
         there will be one thread per vCPU therefore taking advantage of
@@ -2791,7 +2802,7 @@ DEF("netdev", HAS_ARG, QEMU_OPTION_netdev,
     "-netdev tap,id=str[,fd=h][,fds=x:y:...:z][,ifname=name][,script=file][,downscript=dfile]\n"
     "         [,br=bridge][,helper=helper][,sndbuf=nbytes][,vnet_hdr=on|off][,vhost=on|off]\n"
     "         [,vhostfd=h][,vhostfds=x:y:...:z][,vhostforce=on|off][,queues=n]\n"
-    "         [,poll-us=n]\n"
+    "         [,poll-us=n][,rx-batch=n]\n"
     "                configure a host TAP network backend with ID 'str'\n"
     "                connected to a bridge (default=" DEFAULT_BRIDGE_INTERFACE ")\n"
     "                use network scripts 'file' (default=" DEFAULT_NETWORK_SCRIPT ")\n"
@@ -2814,6 +2825,8 @@ DEF("netdev", HAS_ARG, QEMU_OPTION_netdev,
     "                use 'queues=n' to specify the number of queues to be created for multiqueue TAP\n"
     "                use 'poll-us=n' to specify the maximum number of microseconds that could be\n"
     "                spent on busy polling for vhost net\n"
+    "                use 'rx-batch=n' to read up to n (1-8, default 8) packets from the\n"
+    "                tap before passing them to the guest; each takes a 68 KiB buffer\n"
     "-netdev bridge,id=str[,br=bridge][,helper=helper]\n"
     "                configure a host TAP network backend with ID 'str' that is\n"
     "                connected to a bridge (default=" DEFAULT_BRIDGE_INTERFACE ")\n"
@@ -2882,6 +2895,27 @@ DEF("netdev", HAS_ARG, QEMU_OPTION_netdev,
     "                VALE port (created on the fly) called 'name' ('nmname' is name of the \n"
     "                netmap device, defaults to '/dev/netmap')\n"
 #endif
+#ifdef CONFIG_AF_XDP
+    "-netdev af-xdp,id=str,ifname=name[,mode=native|skb][,force-copy=on|off]\n"
+    "         [,queues=n][,start-queue=m][,inhibit=on|off][,sock-fds=x:y:...:z]\n"
+    "                attach to the existing network interface 'name' with AF_XDP socket\n"
+    "                use 'mode=MODE' to specify an XDP program attach mode\n"
+    "                use 'force-copy=on|off' to force XDP copy mode even if device supports zero-copy (default: off)\n"
+    "                use 'inhibit=on|off' to inhibit loading of a default XDP program (default: off)\n"
+    "                with inhibit=on,\n"
+    "                  use 'sock-fds' to provide file descriptors for already open AF_XDP sockets\n"
+    "                  added to a socket map in XDP program.  One socket per queue.\n"
+    "                use 'queues=n' to specify how many queues of a multiqueue interface should be used\n"
+    "                use 'start-queue=m' to specify the first queue that should be used\n"
+#endif
+#ifdef CONFIG_LINUX
+    "-netdev shm,id=str,path=path[,server=on|off][,ring-size=n][,mtu=n]\n"
+    "                connect to another QEMU process on the same host through packet rings\n"
+    "                in shared memory, set up over the unix socket 'path'\n"
+    "                use 'server=on' to create the shared memory and listen on 'path'\n"
+    "                use 'ring-size=n' to set the number of packet slots per direction (default: 256)\n"
+    "                use 'mtu=n' to set the largest packet payload a slot holds (default: 1500)\n"
+#endif
 #ifdef CONFIG_POSIX
     "-netdev vhost-user,id=str,chardev=dev[,vhostforce=on|off]\n"
     "                configure a vhost-user network, backed by a chardev 'dev'\n"
@@ -2927,6 +2961,12 @@ DEF("nic", HAS_ARG, QEMU_OPTION_nic,
 #ifdef CONFIG_NETMAP
     "netmap|"
 #endif
+#ifdef CONFIG_AF_XDP
+    "af-xdp|"
+#endif
+#ifdef CONFIG_LINUX
+    "shm|"
+#endif
 #ifdef CONFIG_POSIX
     "vhost-user|"
 #endif
@@ -3376,6 +3416,62 @@ SRST
         # launch QEMU instance
         |qemu_system| linux.img -nic vde,sock=/tmp/myswitch
 
+``-netdev af-xdp,id=str,ifname=name[,mode=native|skb][,force-copy=on|off][,queues=n][,start-queue=m][,inhibit=on|off][,sock-fds=x:y:...:z]``
+    Configure AF_XDP backend to connect to a network interface 'name'
+    using AF_XDP socket.  A specific program attach mode for a default
+    XDP program can be forced with 'mode', defaults to best-effort,
+    where the likely most performant mode will be in use.  Number of
+    queues 'n' should generally match the number or queues in the
+    interface, defaults to 1.  Queue 'start-queue + i' is mapped to the
+    i-th queue pair of a multiqueue virtio-net device.  Traffic arriving
+    on non-configured device queues will not be delivered to the network
+    backend.
+
+    .. parsed-literal::
+
+        # set number of queues to 4
+        ethtool -L eth0 combined 4
+        # launch QEMU instance
+        |qemu_system| linux.img -device virtio-net-pci,netdev=n1,mq=on \\
+            -netdev af-xdp,id=n1,ifname=eth0,queues=4
+
+    XDP program can also be loaded externally.  In this case 'inhibit'
+    option should be set to 'on' and 'sock-fds' provided with file
+    descriptors for already open but not bound XDP sockets already added
+    to a socket map for corresponding queues.  One socket per queue.
+
+    .. parsed-literal::
+
+        |qemu_system| linux.img -device virtio-net-pci,netdev=n1 \\
+            -netdev af-xdp,id=n1,ifname=eth0,queues=3,inhibit=on,sock-fds=15:16:17
+
+    For local testing, the backend can be attached to one end of a veth
+    pair in 'skb' mode.
+
+``-netdev shm,id=str,path=path[,server=on|off][,ring-size=n][,mtu=n]``
+    Connect two QEMU instances on the same host through a pair of
+    packet rings in shared memory.  The instance started with
+    'server=on' creates the memory and two eventfd doorbells, listens
+    on the unix socket 'path' and passes them to the instance that
+    connects to it.  Each packet is copied into the ring by the sender,
+    and out of it by the receiver before it reaches the device.
+    'ring-size' sets the number of packet slots per direction; it must
+    be a power of 2 and defaults to 256.  'mtu' sets the largest
+    payload, without the Ethernet and VLAN headers, that fits in a slot;
+    larger packets are dropped.  It defaults to 1500.  Both are set by
+    the server.  The link stays down until the two sides are
+    connected; the server accepts a new client when the current one
+    goes away.
+
+    .. parsed-literal::
+
+        # launch the first instance, which creates the shared memory
+        |qemu_system| vm1.img -device virtio-net-pci,netdev=n1 \\
+            -netdev shm,id=n1,path=/run/vm-link.sock,server=on
+        # launch the second instance
+        |qemu_system| vm2.img -device virtio-net-pci,netdev=n1 \\
+            -netdev shm,id=n1,path=/run/vm-link.sock
+
 ``-netdev vhost-user,chardev=id[,vhostforce=on|off][,queues=n]``
     Establish a vhost-user netdev, backed by a chardev id. The chardev
     should be a unix domain socket backed one. The vhost-user uses a
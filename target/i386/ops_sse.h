@@ -481,11 +481,38 @@ void glue(helper_pshufhw, SUFFIX)(Reg *d, Reg *s, int order)
         }                                                               \
     }
 
-#if SHIFT == 1
+/*
+ * Packed add/sub/mul/div go through the vector softfloat entry points,
+ * which check the hardfloat preconditions once per register.  The
+ * elements of a ZMMReg are stored in reverse order on big-endian hosts,
+ * so pass the lowest-addressed one.
+ */
+#if HOST_BIG_ENDIAN
+#define ZMM_S_VEC(r) (&(r)->ZMM_S((2 << SHIFT) - 1))
+#define ZMM_D_VEC(r) (&(r)->ZMM_D((1 << SHIFT) - 1))
+#else
+#define ZMM_S_VEC(r) (&(r)->ZMM_S(0))
+#define ZMM_D_VEC(r) (&(r)->ZMM_D(0))
+#endif
 
-#define SSE_HELPER_S(name, F)                                           \
-    SSE_HELPER_P(name, F)                                               \
+#define SSE_HELPER_PV(name)                                             \
+    void glue(helper_ ## name ## ps, SUFFIX)(CPUX86State *env,          \
+            Reg *d, Reg *v, Reg *s)                                     \
+    {                                                                   \
+        float32_ ## name ## _vec(ZMM_S_VEC(d), ZMM_S_VEC(v), ZMM_S_VEC(s), \
+                                 2 << SHIFT, &env->sse_status);         \
+    }                                                                   \
                                                                         \
+    void glue(helper_ ## name ## pd, SUFFIX)(CPUX86State *env,          \
+            Reg *d, Reg *v, Reg *s)                                     \
+    {                                                                   \
+        float64_ ## name ## _vec(ZMM_D_VEC(d), ZMM_D_VEC(v), ZMM_D_VEC(s), \
+                                 1 << SHIFT, &env->sse_status);         \
+    }
+
+#if SHIFT == 1
+
+#define SSE_HELPER_SS(name, F)                                          \
     void helper_ ## name ## ss(CPUX86State *env, Reg *d, Reg *v, Reg *s)\
     {                                                                   \
         int i;                                                          \
@@ -506,10 +533,18 @@ void glue(helper_pshufhw, SUFFIX)(Reg *d, Reg *s, int order)
 
 #else
 
-#define SSE_HELPER_S(name, F) SSE_HELPER_P(name, F)
+#define SSE_HELPER_SS(name, F)
 
 #endif
 
+#define SSE_HELPER_S(name, F)                                           \
+    SSE_HELPER_P(name, F)                                               \
+    SSE_HELPER_SS(name, F)
+
+#define SSE_HELPER_SV(name, F)                                          \
+    SSE_HELPER_PV(name)                                                 \
+    SSE_HELPER_SS(name, F)
+
 #define FPU_ADD(size, a, b) float ## size ## _add(a, b, &env->sse_status)
 #define FPU_SUB(size, a, b) float ## size ## _sub(a, b, &env->sse_status)
 #define FPU_MUL(size, a, b) float ## size ## _mul(a, b, &env->sse_status)
@@ -524,10 +559,10 @@ void glue(helper_pshufhw, SUFFIX)(Reg *d, Reg *s, int order)
 #define FPU_MAX(size, a, b)                                     \
     (float ## size ## _lt(b, a, &env->sse_status) ? (a) : (b))
 
-SSE_HELPER_S(add, FPU_ADD)
-SSE_HELPER_S(sub, FPU_SUB)
-SSE_HELPER_S(mul, FPU_MUL)
-SSE_HELPER_S(div, FPU_DIV)
+SSE_HELPER_SV(add, FPU_ADD)
+SSE_HELPER_SV(sub, FPU_SUB)
+SSE_HELPER_SV(mul, FPU_MUL)
+SSE_HELPER_SV(div, FPU_DIV)
 SSE_HELPER_S(min, FPU_MIN)
 SSE_HELPER_S(max, FPU_MAX)
 
@@ -2550,6 +2585,11 @@ SSE_HELPER_FMAP(helper_fma4pd,  ZMM_D, 1 << SHIFT, float64_muladd)
 #endif
 
 #undef SSE_HELPER_S
+#undef SSE_HELPER_SV
+#undef SSE_HELPER_SS
+#undef SSE_HELPER_PV
+#undef ZMM_S_VEC
+#undef ZMM_D_VEC
 
 #undef LANE_WIDTH
 #undef SHIFT
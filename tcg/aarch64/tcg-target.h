@@ -60,6 +60,7 @@ typedef enum {
 
 #define have_lse    (cpuinfo & CPUINFO_LSE)
 #define have_lse2   (cpuinfo & CPUINFO_LSE2)
+#define have_sve2   (cpuinfo & CPUINFO_SVE2)
 
 /* optional instructions */
 #define TCG_TARGET_HAS_div_i32          1
@@ -148,9 +149,9 @@ typedef enum {
 
 #define TCG_TARGET_HAS_andc_vec         1
 #define TCG_TARGET_HAS_orc_vec          1
-#define TCG_TARGET_HAS_nand_vec         0
-#define TCG_TARGET_HAS_nor_vec          0
-#define TCG_TARGET_HAS_eqv_vec          0
+#define TCG_TARGET_HAS_nand_vec         have_sve2
+#define TCG_TARGET_HAS_nor_vec          have_sve2
+#define TCG_TARGET_HAS_eqv_vec          have_sve2
 #define TCG_TARGET_HAS_not_vec          1
 #define TCG_TARGET_HAS_neg_vec          1
 #define TCG_TARGET_HAS_abs_vec          1
@@ -0,0 +1,114 @@
+/*
+ * HBitmap scanning benchmark
+ *
+ * Compares the accelerated word scanning kernels of util/hbitmap.c with
+ * the portable implementation, which is always the last one to run.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include "qemu/osdep.h"
+#include "qemu/units.h"
+#include "qemu/hbitmap.h"
+
+/* A 4 TiB disk tracked at 64 KiB granularity */
+#define BENCH_DISK_SIZE   (4 * TiB)
+#define BENCH_GRANULARITY 16
+
+typedef struct HBitmapBenchOpts {
+    const char *name;
+    uint64_t run;   /* bytes set in a row */
+    uint64_t hole;  /* bytes left clear after each run */
+} HBitmapBenchOpts;
+
+static HBitmap *bench_bitmap_new(const HBitmapBenchOpts *opts)
+{
+    HBitmap *hb = hbitmap_alloc(BENCH_DISK_SIZE, BENCH_GRANULARITY);
+    uint64_t offset;
+
+    for (offset = 0; offset < BENCH_DISK_SIZE;
+         offset += opts->run + opts->hole) {
+        hbitmap_set(hb, offset, MIN(opts->run, BENCH_DISK_SIZE - offset));
+    }
+    return hb;
+}
+
+/* Walk all dirty areas, as backup and block-status do */
+static uint64_t bench_scan(HBitmap *hb)
+{
+    int64_t start = 0, count;
+    uint64_t total = 0;
+
+    while (hbitmap_next_dirty_area(hb, start, BENCH_DISK_SIZE, INT64_MAX,
+                                   &start, &count)) {
+        total += count;
+        start += count;
+    }
+    return total;
+}
+
+/* Clear and dirty large ranges, which has to count the bits in them */
+static void bench_reset_set(HBitmap *hb)
+{
+    uint64_t offset;
+
+    for (offset = 0; offset < BENCH_DISK_SIZE; offset += 64 * GiB) {
+        hbitmap_reset(hb, offset, 32 * GiB);
+        hbitmap_set(hb, offset, 32 * GiB);
+    }
+}
+
+static const HBitmapBenchOpts bench_opts[] = {
+    { .name = "dense",  .run = 1 * GiB,   .hole = 64 * KiB },
+    { .name = "mixed",  .run = 1 * MiB,   .hole = 1 * MiB },
+    { .name = "sparse", .run = 64 * KiB,  .hole = 64 * MiB },
+};
+
+static void bench_one(const HBitmapBenchOpts *opts, int accel)
+{
+    HBitmap *hb = bench_bitmap_new(opts);
+    uint64_t expected = bench_scan(hb);
+    int i;
+
+    g_test_timer_start();
+    for (i = 0; i < 16; i++) {
+        g_assert_cmpint(bench_scan(hb), ==, expected);
+    }
+    g_test_timer_elapsed();
+    g_test_message("hbitmap(%s): kernel %d scan %.2f ms",
+                   opts->name, accel, g_test_timer_last() * 1000 / 16);
+
+    g_test_timer_start();
+    for (i = 0; i < 16; i++) {
+        bench_reset_set(hb);
+    }
+    g_test_timer_elapsed();
+    g_test_message("hbitmap(%s): kernel %d reset+set %.2f ms",
+                   opts->name, accel, g_test_timer_last() * 1000 / 16);
+
+    hbitmap_free(hb);
+}
+
+/*
+ * Kernels can only be selected in order, so run all bitmap layouts for
+ * one kernel before moving to the next.
+ */
+static void test_hbitmap_speed(void)
+{
+    int accel = 0;
+    int i;
+
+    do {
+        for (i = 0; i < ARRAY_SIZE(bench_opts); i++) {
+            bench_one(&bench_opts[i], accel);
+        }
+        accel++;
+    } while (test_hbitmap_next_accel());
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/hbitmap/benchmark/scan", test_hbitmap_speed);
+
+    return g_test_run();
+}
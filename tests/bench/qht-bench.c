@@ -418,6 +418,16 @@ static void pr_stats(void)
     tx = (s.rd + s.not_rd + s.in + s.not_in + s.rm + s.not_rm) / 1e6 / duration;
     printf(" Throughput:        %.2f MT/s\n", tx);
     printf(" Throughput/thread: %.2f MT/s/thread\n", tx / n_rw_threads);
+
+    /*
+     * Lookups alone, so that the cost of bucket probing can be compared
+     * across runs regardless of the update rate; with -R/-S this is the
+     * lookup throughput under concurrent resizing.
+     */
+    tx = (s.rd + s.not_rd) / 1e6 / duration;
+    printf(" Lookups:           %.2f MT/s%s\n", tx,
+           resize_rate ? " (with concurrent resizes)" : "");
+    printf(" Lookups/thread:    %.2f MT/s/thread\n", tx / n_rw_threads);
 }
 
 static void run_test(void)
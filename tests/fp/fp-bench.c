@@ -127,6 +127,8 @@ static enum op operation;
 static enum tester tester;
 static uint64_t n_completed_ops;
 static unsigned int duration = DEFAULT_DURATION_SECS;
+static unsigned int vec_len;
+static bool vec_elementwise;
 static int64_t ns_elapsed;
 /* disable optimizations with volatile */
 static volatile union fp res;
@@ -423,6 +425,146 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
     }
 }
 
+/*
+ * Vector benchmark: run @op over vectors of vec_len elements, either
+ * through the float*_OP_vec entry points or, with vec_elementwise, by
+ * calling the scalar function on each element (as target helpers used
+ * to do). Throughput is reported per element.
+ */
+#define MAX_VEC_LEN 64
+
+static void bench_vec(enum precision prec, enum op op)
+{
+    int64_t tf = get_clock() + duration * 1000000000LL;
+    int n_iter = OPS_PER_ITER / vec_len;
+
+    while (get_clock() < tf) {
+        union fp a[MAX_VEC_LEN], b[MAX_VEC_LEN];
+        float32 d32[MAX_VEC_LEN];
+        float64 d64[MAX_VEC_LEN];
+        int64_t t0;
+        int i, j;
+
+        for (j = 0; j < vec_len; j++) {
+            union fp ops[MAX_OPERANDS];
+
+            update_random_ops(2, prec);
+            fill_random(ops, 2, prec, false);
+            a[j] = ops[0];
+            b[j] = ops[1];
+        }
+
+        switch (prec) {
+        case PREC_FLOAT32:
+        {
+            float32 va[MAX_VEC_LEN], vb[MAX_VEC_LEN];
+
+            for (j = 0; j < vec_len; j++) {
+                va[j] = a[j].f32;
+                vb[j] = b[j].f32;
+            }
+            t0 = get_clock();
+            for (i = 0; i < n_iter; i++) {
+                if (vec_elementwise) {
+                    for (j = 0; j < vec_len; j++) {
+                        switch (op) {
+                        case OP_ADD:
+                            d32[j] = float32_add(va[j], vb[j], &soft_status);
+                            break;
+                        case OP_SUB:
+                            d32[j] = float32_sub(va[j], vb[j], &soft_status);
+                            break;
+                        case OP_MUL:
+                            d32[j] = float32_mul(va[j], vb[j], &soft_status);
+                            break;
+                        case OP_DIV:
+                            d32[j] = float32_div(va[j], vb[j], &soft_status);
+                            break;
+                        default:
+                            g_assert_not_reached();
+                        }
+                    }
+                } else {
+                    switch (op) {
+                    case OP_ADD:
+                        float32_add_vec(d32, va, vb, vec_len, &soft_status);
+                        break;
+                    case OP_SUB:
+                        float32_sub_vec(d32, va, vb, vec_len, &soft_status);
+                        break;
+                    case OP_MUL:
+                        float32_mul_vec(d32, va, vb, vec_len, &soft_status);
+                        break;
+                    case OP_DIV:
+                        float32_div_vec(d32, va, vb, vec_len, &soft_status);
+                        break;
+                    default:
+                        g_assert_not_reached();
+                    }
+                }
+                res.f32 = d32[i % vec_len];
+            }
+            break;
+        }
+        case PREC_FLOAT64:
+        {
+            float64 va[MAX_VEC_LEN], vb[MAX_VEC_LEN];
+
+            for (j = 0; j < vec_len; j++) {
+                va[j] = a[j].f64;
+                vb[j] = b[j].f64;
+            }
+            t0 = get_clock();
+            for (i = 0; i < n_iter; i++) {
+                if (vec_elementwise) {
+                    for (j = 0; j < vec_len; j++) {
+                        switch (op) {
+                        case OP_ADD:
+                            d64[j] = float64_add(va[j], vb[j], &soft_status);
+                            break;
+                        case OP_SUB:
+                            d64[j] = float64_sub(va[j], vb[j], &soft_status);
+                            break;
+                        case OP_MUL:
+                            d64[j] = float64_mul(va[j], vb[j], &soft_status);
+                            break;
+                        case OP_DIV:
+                            d64[j] = float64_div(va[j], vb[j], &soft_status);
+                            break;
+                        default:
+                            g_assert_not_reached();
+                        }
+                    }
+                } else {
+                    switch (op) {
+                    case OP_ADD:
+                        float64_add_vec(d64, va, vb, vec_len, &soft_status);
+                        break;
+                    case OP_SUB:
+                        float64_sub_vec(d64, va, vb, vec_len, &soft_status);
+                        break;
+                    case OP_MUL:
+                        float64_mul_vec(d64, va, vb, vec_len, &soft_status);
+                        break;
+                    case OP_DIV:
+                        float64_div_vec(d64, va, vb, vec_len, &soft_status);
+                        break;
+                    default:
+                        g_assert_not_reached();
+                    }
+                }
+                res.f64 = d64[i % vec_len];
+            }
+            break;
+        }
+        default:
+            g_assert_not_reached();
+        }
+        ns_elapsed += get_clock() - t0;
+        n_completed_ops += (uint64_t)n_iter * vec_len;
+    }
+}
+
 #define GEN_BENCH(name, type, prec, op, n_ops)          \
     static void __attribute__((flatten)) name(void)     \
     {                                                   \
@@ -488,6 +630,10 @@ static void run_bench(void)
 {
     bench_func_t f;
 
+    if (vec_len) {
+        bench_vec(precision, operation);
+        return;
+    }
     f = bench_funcs[operation][precision];
     g_assert(f);
     f();
@@ -524,6 +670,11 @@ static void usage_complete(int argc, char *argv[])
             "Default: even\n");
     fprintf(stderr, " -t = tester (%s). Default: %s\n",
             tester_list, tester_names[0]);
+    fprintf(stderr, " -v = vector length in elements, up to %d, for add/sub/"
+            "mul/div in single or double precision (soft tester only). "
+            "Default: 0 (scalar)\n", MAX_VEC_LEN);
+    fprintf(stderr, " -e = with -v, run the scalar op on each element instead "
+            "of the vector op. Default: disabled\n");
     fprintf(stderr, " -z = flush inputs to zero (soft tester only). "
             "Default: disabled\n");
     fprintf(stderr, " -Z = flush output to zero (soft tester only). "
@@ -615,7 +766,7 @@ static void parse_args(int argc, char *argv[])
     int rounding = ROUND_EVEN;
 
     for (;;) {
-        c = getopt(argc, argv, "d:ho:p:r:t:zZ");
+        c = getopt(argc, argv, "d:eho:p:r:t:v:zZ");
         if (c < 0) {
             break;
         }
@@ -623,6 +774,9 @@ static void parse_args(int argc, char *argv[])
         case 'd':
             duration = atoi(optarg);
             break;
+        case 'e':
+            vec_elementwise = true;
+            break;
         case 'h':
             usage_complete(argc, argv);
             exit(EXIT_SUCCESS);
@@ -661,6 +815,14 @@ static void parse_args(int argc, char *argv[])
             }
             tester = val;
             break;
+        case 'v':
+            vec_len = atoi(optarg);
+            if (vec_len > MAX_VEC_LEN) {
+                fprintf(stderr, "fatal: vector length %u exceeds %d\n",
+                        vec_len, MAX_VEC_LEN);
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 'z':
             soft_status.flush_inputs_to_zero = 1;
             break;
@@ -670,6 +832,16 @@ static void parse_args(int argc, char *argv[])
         }
     }
 
+    if (vec_len && (tester != TESTER_SOFT || operation > OP_DIV)) {
+        fprintf(stderr, "fatal: -v requires the soft tester and one of "
+                "add, sub, mul or div\n");
+        exit(EXIT_FAILURE);
+    }
+    if (vec_len && precision == PREC_QUAD) {
+        fprintf(stderr, "fatal: -v is not supported for quad precision\n");
+        exit(EXIT_FAILURE);
+    }
+
     /* set precision and rounding mode based on the tester */
     switch (tester) {
     case TESTER_HOST:
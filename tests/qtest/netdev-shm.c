@@ -0,0 +1,380 @@
+/*
+ * QTest testcase for netdev shm
+ *
+ * The test plays the client side of the shared-memory ring protocol,
+ * against a QEMU whose shm server is connected through a hub to a socket
+ * netdev, so that packets can be injected and checked on both ends.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include <sys/mman.h>
+#include <sys/un.h>
+#include <glib/gstdio.h>
+#include "libqtest.h"
+#include "qemu/atomic.h"
+#include "qemu/iov.h"
+
+/* Wire format, as defined in net/shm.c */
+#define SHM_NET_MAGIC           0x4e4d48535551ULL
+#define SHM_NET_VERSION         1
+#define SHM_NET_SLOTS_OFFSET    4096
+
+typedef struct ShmNetRing {
+    uint32_t head QEMU_ALIGNED(64);
+    uint32_t producer_waiting;
+    uint32_t tail QEMU_ALIGNED(64);
+    uint32_t consumer_waiting;
+} ShmNetRing;
+
+typedef struct ShmNetHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t ring_size;
+    uint32_t slot_size;
+    uint32_t reserved;
+    ShmNetRing rings[2];
+} ShmNetHeader;
+
+typedef struct ShmNetSlot {
+    uint32_t len;
+    uint8_t data[];
+} ShmNetSlot;
+
+typedef struct ShmNetHello {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t ring_size;
+    uint64_t size;
+    uint32_t slot_size;
+    uint32_t reserved;
+} ShmNetHello;
+
+enum {
+    SHM_NET_FD_MEM,
+    SHM_NET_FD_SERVER_BELL,
+    SHM_NET_FD_CLIENT_BELL,
+    SHM_NET_NFDS
+};
+
+#define RING_SIZE   8
+/* 1500 bytes of payload, plus Ethernet and two VLAN headers and the length */
+#define SLOT_SIZE   ROUND_UP(4 + 22 + 1500, 64)
+
+#define TIMEOUT     60
+
+typedef struct ShmClient {
+    QTestState *qts;
+    char *path;
+    int sock;                   /* socket netdev on the other hub port */
+    int conn;                   /* UNIX socket connection to the server */
+    int fds[SHM_NET_NFDS];
+    ShmNetHello hello;
+    ShmNetHeader *hdr;
+    ShmNetRing *tx;             /* client to server */
+    ShmNetRing *rx;             /* server to client */
+    uint8_t *tx_slots;
+    uint8_t *rx_slots;
+} ShmClient;
+
+static gchar *tmpdir;
+
+static ShmNetSlot *slot_at(ShmClient *c, uint8_t *slots, uint32_t idx)
+{
+    return (ShmNetSlot *)(slots + (idx & (c->hello.ring_size - 1)) *
+                          c->hello.slot_size);
+}
+
+static void recv_hello(ShmClient *c)
+{
+    char control[CMSG_SPACE(sizeof(int) * SHM_NET_NFDS)] = { 0 };
+    struct iovec iov = { .iov_base = &c->hello, .iov_len = sizeof(c->hello) };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+    struct cmsghdr *cmsg;
+    ssize_t ret;
+
+    ret = recvmsg(c->conn, &msg, 0);
+    g_assert_cmpint(ret, ==, sizeof(c->hello));
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    g_assert_nonnull(cmsg);
+    g_assert_cmpint(cmsg->cmsg_level, ==, SOL_SOCKET);
+    g_assert_cmpint(cmsg->cmsg_type, ==, SCM_RIGHTS);
+    g_assert_cmpint(cmsg->cmsg_len, ==, CMSG_LEN(sizeof(c->fds)));
+    memcpy(c->fds, CMSG_DATA(cmsg), sizeof(c->fds));
+}
+
+static void client_start(ShmClient *c)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int sv[2];
+    uint8_t *slots;
+    struct stat st;
+
+    g_assert_cmpint(socketpair(PF_UNIX, SOCK_STREAM, 0, sv), ==, 0);
+    c->sock = sv[0];
+    c->path = g_strdup_printf("%s/shm.sock", tmpdir);
+
+    c->qts = qtest_initf("-nodefaults -M none "
+                         "-netdev shm,id=shm0,path=%s,server=on,"
+                         "ring-size=%d,mtu=1500 "
+                         "-netdev socket,id=sock0,fd=%d "
+                         "-netdev hubport,id=hp0,hubid=0,netdev=shm0 "
+                         "-netdev hubport,id=hp1,hubid=0,netdev=sock0",
+                         c->path, RING_SIZE, sv[1]);
+    close(sv[1]);
+
+    c->conn = socket(AF_UNIX, SOCK_STREAM, 0);
+    g_assert_cmpint(c->conn, >=, 0);
+    g_strlcpy(addr.sun_path, c->path, sizeof(addr.sun_path));
+    g_assert_cmpint(connect(c->conn, (struct sockaddr *)&addr,
+                            sizeof(addr)), ==, 0);
+
+    recv_hello(c);
+    g_assert_cmphex(c->hello.magic, ==, SHM_NET_MAGIC);
+    g_assert_cmpint(c->hello.version, ==, SHM_NET_VERSION);
+    g_assert_cmpint(c->hello.ring_size, ==, RING_SIZE);
+    g_assert_cmpint(c->hello.slot_size, ==, SLOT_SIZE);
+    g_assert_cmpint(c->hello.size, ==,
+                    SHM_NET_SLOTS_OFFSET + 2 * RING_SIZE * SLOT_SIZE);
+    g_assert_cmpint(fstat(c->fds[SHM_NET_FD_MEM], &st), ==, 0);
+    g_assert_cmpint(st.st_size, >=, c->hello.size);
+
+    c->hdr = mmap(NULL, c->hello.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  c->fds[SHM_NET_FD_MEM], 0);
+    g_assert(c->hdr != MAP_FAILED);
+    g_assert_cmphex(c->hdr->magic, ==, SHM_NET_MAGIC);
+    g_assert_cmpint(c->hdr->slot_size, ==, SLOT_SIZE);
+
+    slots = (uint8_t *)c->hdr + SHM_NET_SLOTS_OFFSET;
+    c->rx = &c->hdr->rings[0];
+    c->tx = &c->hdr->rings[1];
+    c->rx_slots = slots;
+    c->tx_slots = slots + RING_SIZE * SLOT_SIZE;
+}
+
+static void client_stop(ShmClient *c)
+{
+    int i;
+
+    munmap(c->hdr, c->hello.size);
+    for (i = 0; i < SHM_NET_NFDS; i++) {
+        close(c->fds[i]);
+    }
+    close(c->conn);
+    close(c->sock);
+    qtest_quit(c->qts);
+    g_unlink(c->path);
+    g_free(c->path);
+}
+
+static void kick_server(ShmClient *c)
+{
+    uint64_t val = 1;
+
+    g_assert_cmpint(write(c->fds[SHM_NET_FD_SERVER_BELL], &val, sizeof(val)),
+                    ==, sizeof(val));
+}
+
+/* Publish a packet on the client to server ring. */
+static void client_send(ShmClient *c, const void *buf, uint32_t len)
+{
+    uint32_t head = c->tx->head;
+    ShmNetSlot *slot = slot_at(c, c->tx_slots, head);
+
+    memcpy(slot->data, buf, len);
+    slot->len = len;
+    qatomic_store_release(&c->tx->head, head + 1);
+    kick_server(c);
+}
+
+/* Wait for a packet on the server to client ring and consume it. */
+static uint32_t client_recv(ShmClient *c, void *buf, uint32_t size)
+{
+    uint32_t tail = c->rx->tail;
+    ShmNetSlot *slot;
+    uint32_t len;
+
+    g_test_timer_start();
+    while (qatomic_load_acquire(&c->rx->head) == tail) {
+        g_assert_cmpfloat(g_test_timer_elapsed(), <, TIMEOUT);
+        g_usleep(1000);
+    }
+
+    slot = slot_at(c, c->rx_slots, tail);
+    len = slot->len;
+    g_assert_cmpint(len, <=, size);
+    memcpy(buf, slot->data, len);
+    qatomic_store_release(&c->rx->tail, tail + 1);
+    kick_server(c);
+    return len;
+}
+
+/* The socket netdev frames packets with a big endian length. */
+static void sock_send(ShmClient *c, const void *buf, uint32_t len)
+{
+    uint32_t be_len = htonl(len);
+    struct iovec iov[] = {
+        { .iov_base = &be_len, .iov_len = sizeof(be_len) },
+        { .iov_base = (void *)buf, .iov_len = len },
+    };
+
+    g_assert_cmpint(iov_send(c->sock, iov, 2, 0, sizeof(be_len) + len), ==,
+                    sizeof(be_len) + len);
+}
+
+static uint32_t sock_recv(ShmClient *c, void *buf, uint32_t size)
+{
+    uint32_t len;
+
+    g_assert_cmpint(recv(c->sock, &len, sizeof(len), MSG_WAITALL), ==,
+                    sizeof(len));
+    len = ntohl(len);
+    g_assert_cmpint(len, <=, size);
+    g_assert_cmpint(recv(c->sock, buf, len, MSG_WAITALL), ==, len);
+    return len;
+}
+
+static void fill_packet(uint8_t *buf, uint32_t len, uint8_t seed)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = seed + i;
+    }
+}
+
+static void test_handshake(void)
+{
+    ShmClient c;
+    char *resp;
+
+    client_start(&c);
+
+    g_test_timer_start();
+    do {
+        resp = qtest_hmp(c.qts, "info network");
+        if (strstr(resp, "shm server, ring 8, slot 1536")) {
+            break;
+        }
+        g_free(resp);
+        resp = NULL;
+    } while (g_test_timer_elapsed() < TIMEOUT);
+    g_assert_nonnull(resp);
+    g_free(resp);
+
+    client_stop(&c);
+}
+
+static void test_client_to_server(void)
+{
+    uint8_t pkt[1514], buf[2048];
+    ShmClient c;
+    int i;
+
+    client_start(&c);
+
+    /* Go around the ring more than once. */
+    for (i = 0; i < 2 * RING_SIZE + 1; i++) {
+        uint32_t len = 60 + i * 61;
+
+        fill_packet(pkt, len, i);
+        client_send(&c, pkt, len);
+        g_assert_cmpint(sock_recv(&c, buf, sizeof(buf)), ==, len);
+        g_assert_cmpmem(buf, len, pkt, len);
+    }
+    g_assert_cmpint(c.tx->tail, ==, c.tx->head);
+
+    client_stop(&c);
+}
+
+static void test_server_to_client(void)
+{
+    uint8_t pkt[2048], buf[SLOT_SIZE];
+    ShmClient c;
+    int i;
+
+    client_start(&c);
+
+    for (i = 0; i < 2 * RING_SIZE + 1; i++) {
+        uint32_t len = 60 + i * 61;
+
+        fill_packet(pkt, len, i);
+        sock_send(&c, pkt, len);
+        g_assert_cmpint(client_recv(&c, buf, sizeof(buf)), ==, len);
+        g_assert_cmpmem(buf, len, pkt, len);
+    }
+
+    /* A packet that does not fit in a slot is dropped. */
+    fill_packet(pkt, 1600, 0xaa);
+    sock_send(&c, pkt, 1600);
+    fill_packet(pkt, 64, 0x55);
+    sock_send(&c, pkt, 64);
+    g_assert_cmpint(client_recv(&c, buf, sizeof(buf)), ==, 64);
+    g_assert_cmpmem(buf, 64, pkt, 64);
+    g_assert_cmpint(c.rx->head, ==, c.rx->tail);
+
+    client_stop(&c);
+}
+
+/* The server waits for a kick when the client lets its ring fill up. */
+static void test_ring_full(void)
+{
+    uint8_t pkt[128], buf[SLOT_SIZE];
+    ShmClient c;
+    int i;
+
+    client_start(&c);
+
+    for (i = 0; i < 2 * RING_SIZE; i++) {
+        fill_packet(pkt, sizeof(pkt), i);
+        sock_send(&c, pkt, sizeof(pkt));
+    }
+
+    g_test_timer_start();
+    while (qatomic_read(&c.rx->head) - c.rx->tail < RING_SIZE) {
+        g_assert_cmpfloat(g_test_timer_elapsed(), <, TIMEOUT);
+        g_usleep(1000);
+    }
+
+    /* The rest is held back by QEMU and arrives once there is room. */
+    for (i = 0; i < 2 * RING_SIZE; i++) {
+        fill_packet(pkt, sizeof(pkt), i);
+        g_assert_cmpint(client_recv(&c, buf, sizeof(buf)), ==, sizeof(pkt));
+        g_assert_cmpmem(buf, sizeof(pkt), pkt, sizeof(pkt));
+    }
+
+    client_stop(&c);
+}
+
+int main(int argc, char **argv)
+{
+    g_autoptr(GError) err = NULL;
+    int ret;
+
+    g_test_init(&argc, &argv, NULL);
+
+    tmpdir = g_dir_make_tmp("netdev-shm.XXXXXX", &err);
+    if (tmpdir == NULL) {
+        g_error("Can't create temporary directory in %s: %s",
+                g_get_tmp_dir(), err->message);
+    }
+
+    qtest_add_func("/netdev/shm/handshake", test_handshake);
+    qtest_add_func("/netdev/shm/client-to-server", test_client_to_server);
+    qtest_add_func("/netdev/shm/server-to-client", test_server_to_client);
+    qtest_add_func("/netdev/shm/ring-full", test_ring_full);
+
+    ret = g_test_run();
+
+    g_rmdir(tmpdir);
+    g_free(tmpdir);
+
+    return ret;
+}
@@ -142,6 +142,208 @@ static void nvmetest_pmr_reg_test(void *obj, void *data, QGuestAllocator *alloc)
     qpci_iounmap(pdev, pmr_bar);
 }
 
+#define NVME_TEST_QSIZE     8
+#define NVME_TEST_TIMEOUT   60
+
+typedef struct NvmeTestQueue {
+    uint64_t addr;
+    uint16_t tail;
+    uint16_t head;
+    uint16_t phase;
+} NvmeTestQueue;
+
+typedef struct NvmeTestCtrl {
+    QPCIDevice *pdev;
+    QPCIBar bar;
+    QTestState *qts;
+    NvmeTestQueue sq[2];
+    NvmeTestQueue cq[2];
+    uint64_t dbs;
+    uint16_t cid;
+} NvmeTestCtrl;
+
+static uint64_t nvmetest_alloc_page(QGuestAllocator *alloc, size_t size)
+{
+    return ROUND_UP(guest_alloc(alloc, size + 4096), 4096);
+}
+
+static void nvmetest_queue_init(NvmeTestCtrl *c, QGuestAllocator *alloc,
+                                uint16_t qid)
+{
+    c->sq[qid] = (NvmeTestQueue) {
+        .addr = nvmetest_alloc_page(alloc, NVME_TEST_QSIZE * sizeof(NvmeCmd)),
+    };
+    c->cq[qid] = (NvmeTestQueue) {
+        .addr = nvmetest_alloc_page(alloc, NVME_TEST_QSIZE * sizeof(NvmeCqe)),
+        .phase = 1,
+    };
+    qtest_memset(c->qts, c->cq[qid].addr, 0,
+                 NVME_TEST_QSIZE * sizeof(NvmeCqe));
+}
+
+/* Ring a doorbell, updating its shadow copy first if there is one */
+static void nvmetest_doorbell(NvmeTestCtrl *c, int db, uint16_t val)
+{
+    if (c->dbs) {
+        qtest_writel(c->qts, c->dbs + db * 4, val);
+    }
+    qpci_io_writel(c->pdev, c->bar, 0x1000 + db * 4, val);
+}
+
+/* Submit @cmd on queue @qid and return the status of its completion */
+static uint16_t nvmetest_submit(NvmeTestCtrl *c, uint16_t qid, NvmeCmd *cmd)
+{
+    NvmeTestQueue *sq = &c->sq[qid];
+    NvmeTestQueue *cq = &c->cq[qid];
+    uint64_t cqe_addr = cq->addr + cq->head * sizeof(NvmeCqe);
+    NvmeCqe cqe;
+
+    cmd->cid = cpu_to_le16(++c->cid);
+    qtest_memwrite(c->qts, sq->addr + sq->tail * sizeof(NvmeCmd), cmd,
+                   sizeof(*cmd));
+    sq->tail = (sq->tail + 1) % NVME_TEST_QSIZE;
+    nvmetest_doorbell(c, 2 * qid, sq->tail);
+
+    g_test_timer_start();
+    for (;;) {
+        qtest_memread(c->qts, cqe_addr, &cqe, sizeof(cqe));
+        if ((le16_to_cpu(cqe.status) & 1) == cq->phase) {
+            break;
+        }
+        g_assert_cmpfloat(g_test_timer_elapsed(), <, NVME_TEST_TIMEOUT);
+        g_usleep(1000);
+    }
+
+    g_assert_cmpint(le16_to_cpu(cqe.cid), ==, c->cid);
+    g_assert_cmpint(le16_to_cpu(cqe.sq_id), ==, qid);
+
+    cq->head = (cq->head + 1) % NVME_TEST_QSIZE;
+    if (!cq->head) {
+        cq->phase = !cq->phase;
+    }
+    nvmetest_doorbell(c, 2 * qid + 1, cq->head);
+
+    return le16_to_cpu(cqe.status) >> 1;
+}
+
+static void nvmetest_enable(NvmeTestCtrl *c, QNvme *nvme,
+                            QGuestAllocator *alloc)
+{
+    uint32_t cc = 0;
+
+    c->pdev = &nvme->dev;
+    c->qts = c->pdev->bus->qts;
+    qpci_device_enable(c->pdev);
+    c->bar = qpci_iomap(c->pdev, 0, NULL);
+
+    nvmetest_queue_init(c, alloc, 0);
+    qpci_io_writel(c->pdev, c->bar, NVME_REG_AQA,
+                   (NVME_TEST_QSIZE - 1) << 16 | (NVME_TEST_QSIZE - 1));
+    qpci_io_writeq(c->pdev, c->bar, NVME_REG_ASQ, c->sq[0].addr);
+    qpci_io_writeq(c->pdev, c->bar, NVME_REG_ACQ, c->cq[0].addr);
+
+    NVME_SET_CC_IOSQES(cc, 6);
+    NVME_SET_CC_IOCQES(cc, 4);
+    NVME_SET_CC_EN(cc, 1);
+    qpci_io_writel(c->pdev, c->bar, NVME_REG_CC, cc);
+
+    g_test_timer_start();
+    while (!NVME_CSTS_RDY(qpci_io_readl(c->pdev, c->bar, NVME_REG_CSTS))) {
+        g_assert_cmpfloat(g_test_timer_elapsed(), <, NVME_TEST_TIMEOUT);
+        g_usleep(1000);
+    }
+}
+
+static void nvmetest_create_io_queues(NvmeTestCtrl *c, QGuestAllocator *alloc)
+{
+    NvmeCreateCq ccq = {
+        .opcode = NVME_ADM_CMD_CREATE_CQ,
+        .cqid = cpu_to_le16(1),
+        .qsize = cpu_to_le16(NVME_TEST_QSIZE - 1),
+        .cq_flags = cpu_to_le16(NVME_CQ_PC),
+    };
+    NvmeCreateSq csq = {
+        .opcode = NVME_ADM_CMD_CREATE_SQ,
+        .sqid = cpu_to_le16(1),
+        .qsize = cpu_to_le16(NVME_TEST_QSIZE - 1),
+        .sq_flags = cpu_to_le16(NVME_SQ_PC),
+        .cqid = cpu_to_le16(1),
+    };
+
+    nvmetest_queue_init(c, alloc, 1);
+    ccq.prp1 = cpu_to_le64(c->cq[1].addr);
+    csq.prp1 = cpu_to_le64(c->sq[1].addr);
+    g_assert_cmpint(nvmetest_submit(c, 0, (NvmeCmd *)&ccq), ==, NVME_SUCCESS);
+    g_assert_cmpint(nvmetest_submit(c, 0, (NvmeCmd *)&csq), ==, NVME_SUCCESS);
+}
+
+/*
+ * Read from the namespace through an I/O queue pair.  Queues wrap around
+ * more than once, so that the completion phase flips.
+ */
+static void nvmetest_io_read(NvmeTestCtrl *c, QGuestAllocator *alloc)
+{
+    uint64_t data = nvmetest_alloc_page(alloc, 4096);
+    uint8_t buf[512];
+    int i;
+
+    for (i = 0; i < 2 * NVME_TEST_QSIZE + 1; i++) {
+        NvmeRwCmd rw = {
+            .opcode = NVME_CMD_READ,
+            .nsid = cpu_to_le32(1),
+            .dptr.prp1 = cpu_to_le64(data),
+            .slba = cpu_to_le64(i),
+            .nlb = 0,
+        };
+
+        qtest_memset(c->qts, data, 0xff, sizeof(buf));
+        g_assert_cmpint(nvmetest_submit(c, 1, (NvmeCmd *)&rw), ==,
+                        NVME_SUCCESS);
+        qtest_memread(c->qts, data, buf, sizeof(buf));
+        g_assert_cmpint(buf[0], ==, 0);
+        g_assert_cmpint(buf[sizeof(buf) - 1], ==, 0);
+    }
+}
+
+/* I/O queues serviced in an iothread, with MMIO doorbells */
+static void nvmetest_iothread_test(void *obj, void *data,
+                                   QGuestAllocator *alloc)
+{
+    NvmeTestCtrl c = {};
+
+    nvmetest_enable(&c, obj, alloc);
+    nvmetest_create_io_queues(&c, alloc);
+    nvmetest_io_read(&c, alloc);
+    qpci_iounmap(c.pdev, c.bar);
+}
+
+/*
+ * Same with shadow doorbells and ioeventfd, where the iothread polls the
+ * shadow submission queue tail.
+ */
+static void nvmetest_iothread_dbbuf_test(void *obj, void *data,
+                                         QGuestAllocator *alloc)
+{
+    NvmeTestCtrl c = {};
+    uint64_t dbs = nvmetest_alloc_page(alloc, 4096);
+    uint64_t eis = nvmetest_alloc_page(alloc, 4096);
+    NvmeCmd cmd = {
+        .opcode = NVME_ADM_CMD_DBBUF_CONFIG,
+        .dptr.prp1 = cpu_to_le64(dbs),
+        .dptr.prp2 = cpu_to_le64(eis),
+    };
+
+    nvmetest_enable(&c, obj, alloc);
+    qtest_memset(c.qts, dbs, 0, 4096);
+    qtest_memset(c.qts, eis, 0, 4096);
+    g_assert_cmpint(nvmetest_submit(&c, 0, &cmd), ==, NVME_SUCCESS);
+    c.dbs = dbs;
+
+    nvmetest_create_io_queues(&c, alloc);
+    nvmetest_io_read(&c, alloc);
+    qpci_iounmap(c.pdev, c.bar);
+}
+
 static void nvme_register_nodes(void)
 {
     QOSGraphEdgeOptions opts = {
@@ -168,6 +370,18 @@ static void nvme_register_nodes(void)
     });
 
     qos_add_test("reg-read", "nvme", nvmetest_reg_read_test, NULL);
+
+    qos_add_test("iothread", "nvme", nvmetest_iothread_test,
+                 &(QOSGraphTestOptions) {
+        .edge.before_cmd_line = "-object iothread,id=thread0",
+        .edge.extra_device_opts = "iothread=thread0",
+    });
+
+    qos_add_test("iothread-dbbuf", "nvme", nvmetest_iothread_dbbuf_test,
+                 &(QOSGraphTestOptions) {
+        .edge.before_cmd_line = "-object iothread,id=thread0",
+        .edge.extra_device_opts = "iothread=thread0,ioeventfd=on",
+    });
 }
 
 libqos_init(nvme_register_nodes);
@@ -9,6 +9,7 @@
 
 #include "qemu/osdep.h"
 #include "libqtest-single.h"
+#include "qemu/bswap.h"
 #include "qemu/iov.h"
 #include "qemu/module.h"
 #include "qapi/qmp/qdict.h"
@@ -16,6 +17,14 @@
 #include "libqos/qgraph.h"
 #include "libqos/virtio-net.h"
 
+#ifdef CONFIG_LINUX
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <linux/if_packet.h>
+#include <linux/if_tun.h>
+#endif
+
 #ifndef ETH_P_RARP
 #define ETH_P_RARP 0x8035
 #endif
@@ -284,6 +293,253 @@ static void *virtio_net_test_setup(GString *cmd_line, void *arg)
     return sv;
 }
 
+#ifdef CONFIG_LINUX
+
+#define GRO_RX_BUFS     8
+#define GRO_RX_BUF_SIZE 4096
+#define GRO_SEG_PAYLOAD 1000
+#define GRO_ETH_LEN     14
+#define GRO_IP_LEN      20
+#define GRO_TCP_LEN     20
+#define GRO_SPORT       12345
+#define GRO_DPORT       80
+
+/*
+ * GRO needs a backend with a vnet header, i.e. a real tap device.  The test
+ * injects segments into it through a packet socket, which passes them to
+ * QEMU with a partial checksum, as a local TCP sender would.
+ */
+typedef struct GroTap {
+    int tap_fd;
+    int packet_fd;
+} GroTap;
+
+static void gro_tap_cleanup(void *opaque)
+{
+    GroTap *t = opaque;
+
+    if (t->packet_fd >= 0) {
+        close(t->packet_fd);
+    }
+    qos_invalidate_command_line();
+    if (t->tap_fd >= 0) {
+        close(t->tap_fd);
+    }
+    g_free(t);
+}
+
+static bool gro_tap_open(GroTap *t)
+{
+    struct ifreq ifr = {};
+    struct sockaddr_ll sll = {
+        .sll_family = AF_PACKET,
+    };
+    g_autofree char *ipv6 = NULL;
+    int one = 1;
+    int sock;
+    bool up;
+
+    t->tap_fd = open("/dev/net/tun", O_RDWR);
+    if (t->tap_fd < 0) {
+        return false;
+    }
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_VNET_HDR;
+    if (ioctl(t->tap_fd, TUNSETIFF, &ifr) < 0) {
+        return false;
+    }
+
+    /* Keep the host from sending IPv6 neighbour discovery to the guest */
+    ipv6 = g_strdup_printf("/proc/sys/net/ipv6/conf/%s/disable_ipv6",
+                           ifr.ifr_name);
+    g_file_set_contents(ipv6, "1", 1, NULL);
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        return false;
+    }
+    up = ioctl(sock, SIOCGIFFLAGS, &ifr) == 0;
+    ifr.ifr_flags |= IFF_UP;
+    up = up && ioctl(sock, SIOCSIFFLAGS, &ifr) == 0;
+    close(sock);
+    if (!up) {
+        return false;
+    }
+
+    t->packet_fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (t->packet_fd < 0) {
+        return false;
+    }
+    sll.sll_ifindex = if_nametoindex(ifr.ifr_name);
+    return setsockopt(t->packet_fd, SOL_PACKET, PACKET_VNET_HDR,
+                      &one, sizeof(one)) == 0 &&
+           bind(t->packet_fd, (struct sockaddr *)&sll, sizeof(sll)) == 0;
+}
+
+static void *virtio_net_test_setup_gro(GString *cmd_line, void *arg)
+{
+    GroTap *t = g_new(GroTap, 1);
+
+    t->tap_fd = -1;
+    t->packet_fd = -1;
+    if (gro_tap_open(t)) {
+        g_string_append_printf(cmd_line, " -netdev tap,id=hs0,fd=%d ",
+                               t->tap_fd);
+    } else {
+        /* gro_test() skips, but the device still needs a netdev */
+        if (t->packet_fd >= 0) {
+            close(t->packet_fd);
+            t->packet_fd = -1;
+        }
+        g_string_append(cmd_line, " -netdev hubport,hubid=0,id=hs0 ");
+    }
+
+    g_test_queue_destroy(gro_tap_cleanup, t);
+    return t;
+}
+
+static uint16_t gro_ip_checksum(const uint8_t *ip)
+{
+    uint32_t sum = 0;
+    int i;
+
+    for (i = 0; i < GRO_IP_LEN; i += 2) {
+        sum += (ip[i] << 8) | ip[i + 1];
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return ~sum;
+}
+
+/* Send one full-sized segment of a bulk TCP flow to the guest */
+static void gro_send_segment(int fd, uint32_t seq)
+{
+    uint8_t pkt[sizeof(struct virtio_net_hdr) + GRO_ETH_LEN + GRO_IP_LEN +
+                GRO_TCP_LEN + GRO_SEG_PAYLOAD] = {};
+    struct virtio_net_hdr *vnet = (struct virtio_net_hdr *)pkt;
+    uint8_t *eth = pkt + sizeof(*vnet);
+    uint8_t *ip = eth + GRO_ETH_LEN;
+    uint8_t *tcp = ip + GRO_IP_LEN;
+    static const uint8_t macs[] = {
+        0x52, 0x54, 0x00, 0x12, 0x34, 0x56,     /* guest */
+        0x52, 0x54, 0x00, 0x12, 0x34, 0x57,
+    };
+    ssize_t ret;
+
+    /* The packet socket takes the header in native endianness */
+    vnet->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+    vnet->gso_type = VIRTIO_NET_HDR_GSO_NONE;
+    vnet->csum_start = GRO_ETH_LEN + GRO_IP_LEN;
+    vnet->csum_offset = 16;
+
+    memcpy(eth, macs, sizeof(macs));
+    stw_be_p(eth + 12, 0x0800);
+
+    ip[0] = 0x45;
+    stw_be_p(ip + 2, GRO_IP_LEN + GRO_TCP_LEN + GRO_SEG_PAYLOAD);
+    stw_be_p(ip + 4, seq / GRO_SEG_PAYLOAD);
+    stw_be_p(ip + 6, 0x4000);                   /* DF */
+    ip[8] = 64;
+    ip[9] = IPPROTO_TCP;
+    stl_be_p(ip + 12, 0x0a000202);              /* 10.0.2.2 */
+    stl_be_p(ip + 16, 0x0a00020f);              /* 10.0.2.15 */
+    stw_be_p(ip + 10, gro_ip_checksum(ip));
+
+    stw_be_p(tcp, GRO_SPORT);
+    stw_be_p(tcp + 2, GRO_DPORT);
+    stl_be_p(tcp + 4, seq);
+    stl_be_p(tcp + 8, 1);
+    stw_be_p(tcp + 12, (GRO_TCP_LEN / 4) << 12 | 0x10);    /* ACK */
+    stw_be_p(tcp + 14, 0xffff);
+    memset(tcp + GRO_TCP_LEN, seq / GRO_SEG_PAYLOAD, GRO_SEG_PAYLOAD);
+
+    ret = send(fd, pkt, sizeof(pkt), 0);
+    g_assert_cmpint(ret, ==, sizeof(pkt));
+}
+
+static bool gro_is_test_flow(const uint8_t *eth, uint32_t len)
+{
+    const uint8_t *ip = eth + GRO_ETH_LEN;
+    const uint8_t *tcp = ip + GRO_IP_LEN;
+
+    return len >= GRO_ETH_LEN + GRO_IP_LEN + GRO_TCP_LEN &&
+           lduw_be_p(eth + 12) == 0x0800 && ip[9] == IPPROTO_TCP &&
+           lduw_be_p(tcp) == GRO_SPORT && lduw_be_p(tcp + 2) == GRO_DPORT;
+}
+
+/* Back-to-back segments of a flow reach the guest as one GSO packet */
+static void gro_test(void *obj, void *data, QGuestAllocator *t_alloc)
+{
+    QVirtioNet *net_if = obj;
+    QVirtioDevice *dev = net_if->vdev;
+    QVirtQueue *vq = net_if->queues[0];
+    QTestState *qts = global_qtest;
+    GroTap *t = data;
+    uint64_t req_addr[GRO_RX_BUFS];
+    uint32_t free_head[GRO_RX_BUFS];
+    uint8_t buffer[GRO_RX_BUF_SIZE];
+    struct virtio_net_hdr *vnet = (struct virtio_net_hdr *)buffer;
+    const uint8_t *eth = buffer + VNET_HDR_SIZE;
+    QDict *rsp;
+    int i;
+
+    if (t->packet_fd < 0) {
+        g_test_skip("cannot create a tap device");
+        return;
+    }
+
+    for (i = 0; i < GRO_RX_BUFS; i++) {
+        req_addr[i] = guest_alloc(t_alloc, GRO_RX_BUF_SIZE);
+        free_head[i] = qvirtqueue_add(qts, vq, req_addr[i], GRO_RX_BUF_SIZE,
+                                      true, false);
+        qvirtqueue_kick(qts, dev, vq, free_head[i]);
+    }
+
+    /* Have QEMU find both segments at once when the guest runs again */
+    rsp = qmp("{ 'execute' : 'stop'}");
+    qobject_unref(rsp);
+
+    gro_send_segment(t->packet_fd, 1000);
+    gro_send_segment(t->packet_fd, 1000 + GRO_SEG_PAYLOAD);
+
+    rsp = qmp("{ 'execute' : 'query-status'}");
+    qobject_unref(rsp);
+    rsp = qmp("{ 'execute' : 'cont'}");
+    qobject_unref(rsp);
+
+    /* Skip whatever else the host sent, up to the first segment of the flow */
+    for (i = 0; i < GRO_RX_BUFS; i++) {
+        gint64 start_time = g_get_monotonic_time();
+        uint32_t desc_idx, len;
+
+        while (!qvirtqueue_get_buf(qts, vq, &desc_idx, &len)) {
+            qtest_clock_step(qts, 100);
+            g_assert(g_get_monotonic_time() - start_time <=
+                     QVIRTIO_NET_TIMEOUT_US);
+        }
+        g_assert_cmpint(desc_idx, ==, free_head[i]);
+        g_assert_cmpint(len, <=, sizeof(buffer));
+
+        memread(req_addr[i], buffer, len);
+        if (len > VNET_HDR_SIZE &&
+            gro_is_test_flow(eth, len - VNET_HDR_SIZE)) {
+            break;
+        }
+    }
+    g_assert_cmpint(i, <, GRO_RX_BUFS);
+
+    g_assert_cmpint(vnet->gso_type, ==, VIRTIO_NET_HDR_GSO_TCPV4);
+    g_assert_cmpint(le16_to_cpu(vnet->gso_size), ==, GRO_SEG_PAYLOAD);
+    g_assert_cmpint(lduw_be_p(eth + GRO_ETH_LEN + 2), ==,
+                    GRO_IP_LEN + GRO_TCP_LEN + 2 * GRO_SEG_PAYLOAD);
+
+    for (i = 0; i < GRO_RX_BUFS; i++) {
+        guest_free(t_alloc, req_addr[i]);
+    }
+}
+
+#endif /* CONFIG_LINUX */
+
 #endif /* _WIN32 */
 
 static void large_tx(void *obj, void *data, QGuestAllocator *t_alloc)
@@ -329,6 +585,13 @@ static void register_virtio_net_test(void)
     qos_add_test("announce-self", "virtio-net", announce_self, &opts);
 #endif
 
+#ifdef CONFIG_LINUX
+    opts.before = virtio_net_test_setup_gro;
+    opts.edge.extra_device_opts = "gro=on";
+    qos_add_test("gro", "virtio-net", gro_test, &opts);
+    opts.edge.extra_device_opts = NULL;
+#endif
+
     /* These tests do not need a loopback backend.  */
     opts.before = virtio_net_test_setup_nosocket;
     opts.arg = (gpointer)UINT_MAX;
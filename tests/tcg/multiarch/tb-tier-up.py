@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+#
+# Check that -tb-tier-threshold replaces hot translation blocks
+#
+# The binary is run twice with -d in_asm, once without and once with
+# tiered translation.  With tiering, every TB that is looked up more
+# often than the threshold is translated a second time, so more start
+# addresses must show up more than once in the log.
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+import argparse
+import collections
+import os
+import shlex
+import subprocess
+import sys
+from tempfile import TemporaryDirectory
+
+THRESHOLD = 16
+
+
+def get_args():
+    parser = argparse.ArgumentParser(description="TB tier-up test")
+    parser.add_argument("--qemu", help="Qemu binary for test",
+                        required=True)
+    parser.add_argument("--qargs", help="Qemu arguments for test")
+    parser.add_argument("--binary", help="Guest binary to run",
+                        required=True)
+    return parser.parse_args()
+
+
+def retranslated(qemu, qargs, binary, logfile, extra):
+    """Return how many TB start addresses were translated more than once"""
+    cmd = [qemu] + shlex.split(qargs or "") + extra + \
+        ["-d", "in_asm", "-D", logfile, binary]
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+
+    starts = collections.Counter()
+    with open(logfile, encoding="utf-8", errors="replace") as log:
+        expect_start = False
+        for line in log:
+            if line.startswith("IN:"):
+                expect_start = True
+            elif expect_start and line.startswith("0x"):
+                starts[line.split(":")[0]] += 1
+                expect_start = False
+    return sum(1 for n in starts.values() if n > 1)
+
+
+def main():
+    args = get_args()
+    with TemporaryDirectory(prefix="tb-tier-up") as tmp:
+        base = retranslated(args.qemu, args.qargs, args.binary,
+                            os.path.join(tmp, "base.log"), [])
+        tier = retranslated(args.qemu, args.qargs, args.binary,
+                            os.path.join(tmp, "tier.log"),
+                            ["-tb-tier-threshold", str(THRESHOLD)])
+
+    print(f"TBs translated more than once: {base} without tiering, "
+          f"{tier} with -tb-tier-threshold {THRESHOLD}")
+    if tier <= base:
+        print("FAIL: no TB was replaced after reaching the threshold")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
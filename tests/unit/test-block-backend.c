@@ -25,8 +25,12 @@
 #include "qemu/osdep.h"
 #include "block/block.h"
 #include "sysemu/block-backend.h"
+#include "block/block_int.h"
 #include "qapi/error.h"
 #include "qemu/main-loop.h"
+#include "qemu/units.h"
+
+#define BATCH_TEST_SIZE (1 * MiB)
 
 static void test_drain_aio_error_flush_cb(void *opaque, int ret)
 {
@@ -70,6 +74,203 @@ static void test_drain_all_aio_error(void)
     blk_unref(blk);
 }
 
+typedef struct BDRVBatchTestState {
+    int preadv_calls;
+    int batch_calls;
+    int batch_reqs;
+    int nowait_calls;
+} BDRVBatchTestState;
+
+/* Every 4k block reads as its index, truncated to a byte */
+static void batch_test_fill(QEMUIOVector *qiov, int64_t offset, int64_t bytes)
+{
+    int64_t done;
+
+    for (done = 0; done < bytes; done += 4 * KiB) {
+        qemu_iovec_memset(qiov, done, (uint8_t)((offset + done) >> 12),
+                          MIN(4 * KiB, bytes - done));
+    }
+}
+
+static int coroutine_fn batch_test_co_preadv(BlockDriverState *bs,
+                                             int64_t offset, int64_t bytes,
+                                             QEMUIOVector *qiov,
+                                             BdrvRequestFlags flags)
+{
+    BDRVBatchTestState *s = bs->opaque;
+
+    s->preadv_calls++;
+    batch_test_fill(qiov, offset, bytes);
+    return 0;
+}
+
+static int coroutine_fn batch_test_co_preadv_batch(BlockDriverState *bs,
+                                                   BdrvBatchRequest *reqs,
+                                                   int nb_reqs)
+{
+    BDRVBatchTestState *s = bs->opaque;
+    int i;
+
+    s->batch_calls++;
+    s->batch_reqs += nb_reqs;
+    for (i = 0; i < nb_reqs; i++) {
+        g_assert_cmpint(reqs[i].qiov_offset, ==, 0);
+        g_assert_cmpint(reqs[i].qiov->size, ==, reqs[i].bytes);
+        batch_test_fill(reqs[i].qiov, reqs[i].offset, reqs[i].bytes);
+        reqs[i].ret = 0;
+    }
+    return 0;
+}
+
+/* Only the first half of the image completes without a coroutine */
+static int batch_test_preadv_nowait(BlockDriverState *bs, int64_t offset,
+                                    int64_t bytes, QEMUIOVector *qiov)
+{
+    BDRVBatchTestState *s = bs->opaque;
+
+    s->nowait_calls++;
+    if (offset >= BATCH_TEST_SIZE / 2) {
+        return -EAGAIN;
+    }
+    batch_test_fill(qiov, offset, bytes);
+    return 0;
+}
+
+static int64_t coroutine_fn batch_test_co_getlength(BlockDriverState *bs)
+{
+    return BATCH_TEST_SIZE;
+}
+
+static void batch_test_refresh_limits(BlockDriverState *bs, Error **errp)
+{
+    bs->bl.max_transfer = 64 * KiB;
+}
+
+static BlockDriver bdrv_batch_test = {
+    .format_name            = "batch-test",
+    .instance_size          = sizeof(BDRVBatchTestState),
+
+    .bdrv_co_preadv         = batch_test_co_preadv,
+    .bdrv_co_preadv_batch   = batch_test_co_preadv_batch,
+    .bdrv_preadv_nowait     = batch_test_preadv_nowait,
+    .bdrv_co_getlength      = batch_test_co_getlength,
+    .bdrv_refresh_limits    = batch_test_refresh_limits,
+};
+
+static void test_preadv_batch(void)
+{
+    BlockBackend *blk = blk_new(qemu_get_aio_context(),
+                                BLK_PERM_ALL, BLK_PERM_ALL);
+    BlockDriverState *bs;
+    BDRVBatchTestState *s;
+    struct {
+        int64_t offset;
+        int64_t bytes;
+        int ret;
+    } layout[] = {
+        { 0,                        4 * KiB,    0 },    /* batched */
+        { 64 * KiB,                 64 * KiB,   0 },    /* batched */
+        { 256 * KiB,                128 * KiB,  0 },    /* too large */
+        { BATCH_TEST_SIZE - 4 * KiB, 8 * KiB,   -EIO }, /* past the end */
+    };
+    BdrvBatchRequest reqs[ARRAY_SIZE(layout)];
+    QEMUIOVector qiov[ARRAY_SIZE(layout)];
+    int i, j, ret;
+
+    bs = bdrv_new_open_driver(&bdrv_batch_test, "batch-test", BDRV_O_RDWR,
+                              &error_abort);
+    s = bs->opaque;
+    blk_insert_bs(blk, bs, &error_abort);
+
+    for (i = 0; i < ARRAY_SIZE(layout); i++) {
+        qemu_iovec_init_buf(&qiov[i], g_malloc0(layout[i].bytes),
+                            layout[i].bytes);
+        reqs[i] = (BdrvBatchRequest) {
+            .offset = layout[i].offset,
+            .bytes = layout[i].bytes,
+            .qiov = &qiov[i],
+            .ret = 1,
+        };
+    }
+
+    ret = blk_preadv_batch(blk, reqs, ARRAY_SIZE(reqs));
+    g_assert_cmpint(ret, ==, -EIO);
+
+    /* The first two are aligned and small enough to go in one batch */
+    g_assert_cmpint(s->batch_calls, ==, 1);
+    g_assert_cmpint(s->batch_reqs, ==, 2);
+    /* The third one is split at max_transfer */
+    g_assert_cmpint(s->preadv_calls, ==, 2);
+
+    for (i = 0; i < ARRAY_SIZE(layout); i++) {
+        uint8_t *buf = qiov[i].local_iov.iov_base;
+
+        g_assert_cmpint(reqs[i].ret, ==, layout[i].ret);
+        for (j = 0; j < layout[i].bytes; j++) {
+            uint8_t expected = layout[i].ret ? 0 :
+                               (uint8_t)((layout[i].offset + j) >> 12);
+            g_assert_cmpint(buf[j], ==, expected);
+        }
+        g_free(buf);
+    }
+
+    blk_unref(blk);
+    bdrv_unref(bs);
+}
+
+static void test_aio_preadv_nowait_cb(void *opaque, int ret)
+{
+    int *result = opaque;
+
+    *result = ret;
+}
+
+static void test_aio_preadv_nowait(void)
+{
+    BlockBackend *blk = blk_new(qemu_get_aio_context(),
+                                BLK_PERM_ALL, BLK_PERM_ALL);
+    BlockDriverState *bs;
+    BDRVBatchTestState *s;
+    uint8_t buf[4 * KiB];
+    QEMUIOVector qiov;
+    int result;
+
+    bs = bdrv_new_open_driver(&bdrv_batch_test, "batch-test", BDRV_O_RDWR,
+                              &error_abort);
+    s = bs->opaque;
+    blk_insert_bs(blk, bs, &error_abort);
+    qemu_iovec_init_buf(&qiov, buf, sizeof(buf));
+
+    /* Completed by the driver right away, but the callback comes later */
+    result = -EINPROGRESS;
+    blk_aio_preadv(blk, 64 * KiB, &qiov, 0, test_aio_preadv_nowait_cb,
+                   &result);
+    g_assert_cmpint(result, ==, -EINPROGRESS);
+    g_assert_cmpint(s->nowait_calls, ==, 1);
+    g_assert_cmpint(s->preadv_calls, ==, 0);
+    g_assert_cmpint(buf[0], ==, 16);
+
+    while (result == -EINPROGRESS) {
+        aio_poll(qemu_get_aio_context(), true);
+    }
+    g_assert_cmpint(result, ==, 0);
+
+    /* The driver refuses, so the request is retried in a coroutine */
+    result = -EINPROGRESS;
+    blk_aio_preadv(blk, BATCH_TEST_SIZE / 2, &qiov, 0,
+                   test_aio_preadv_nowait_cb, &result);
+    while (result == -EINPROGRESS) {
+        aio_poll(qemu_get_aio_context(), true);
+    }
+    g_assert_cmpint(result, ==, 0);
+    g_assert_cmpint(s->nowait_calls, ==, 2);
+    g_assert_cmpint(s->preadv_calls, ==, 1);
+    g_assert_cmpint(buf[0], ==, (BATCH_TEST_SIZE / 2) >> 12);
+
+    blk_unref(blk);
+    bdrv_unref(bs);
+}
+
 int main(int argc, char **argv)
 {
     bdrv_init();
@@ -80,6 +281,9 @@ int main(int argc, char **argv)
     g_test_add_func("/block-backend/drain_aio_error", test_drain_aio_error);
     g_test_add_func("/block-backend/drain_all_aio_error",
                     test_drain_all_aio_error);
+    g_test_add_func("/block-backend/preadv_batch", test_preadv_batch);
+    g_test_add_func("/block-backend/aio_preadv_nowait",
+                    test_aio_preadv_nowait);
 
     return g_test_run();
 }
@@ -449,6 +449,49 @@ static void test_lifecycle(void)
     g_assert(done); /* expect done to be true (second time) */
 }
 
+static void *pool_stats_thread(void *opaque)
+{
+    bool done = false;
+    int i;
+
+    qemu_coroutine_pool_set_thread_local();
+    for (i = 0; i < 2; i++) {
+        qemu_coroutine_enter(qemu_coroutine_create_small(set_and_exit, &done));
+        g_assert(done);
+        done = false;
+    }
+    return NULL;
+}
+
+/*
+ * Check the pool counters of small-stack coroutines, created in a thread
+ * that keeps its coroutines to itself
+ */
+static void test_pool_stats(void)
+{
+    CoroutinePoolStats before, after;
+    QemuThread thread;
+
+    qemu_coroutine_get_pool_stats(COROUTINE_STACK_SMALL, &before);
+    g_assert_cmpint(before.stack_size, <, COROUTINE_STACK_SIZE);
+
+    qemu_thread_create(&thread, "pool-stats", pool_stats_thread, NULL,
+                       QEMU_THREAD_JOINABLE);
+    qemu_thread_join(&thread);
+
+    /* The second coroutine reuses the first, which is freed on exit */
+    qemu_coroutine_get_pool_stats(COROUTINE_STACK_SMALL, &after);
+    if (CONFIG_COROUTINE_POOL) {
+        g_assert_cmpint(after.misses, ==, before.misses + 1);
+        g_assert_cmpint(after.hits, ==, before.hits + 1);
+        g_assert_cmpint(after.frees, ==, before.frees + 1);
+    } else {
+        g_assert_cmpint(after.misses, ==, before.misses + 2);
+        g_assert_cmpint(after.frees, ==, before.frees + 2);
+    }
+    g_assert_cmpint(after.pooled, ==, before.pooled);
+}
+
 
 #define RECORD_SIZE 10 /* Leave some room for expansion */
 struct coroutine_position {
@@ -650,6 +693,7 @@ int main(int argc, char **argv)
     }
 
     g_test_add_func("/basic/lifecycle", test_lifecycle);
+    g_test_add_func("/basic/pool-stats", test_pool_stats);
     g_test_add_func("/basic/yield", test_yield);
     g_test_add_func("/basic/nesting", test_nesting);
     g_test_add_func("/basic/self", test_self);
@@ -793,6 +793,46 @@ static void test_hbitmap_serialize_zeroes(TestHBitmapData *data,
     }
 }
 
+static void test_hbitmap_meta(TestHBitmapData *data,
+                              const void *unused)
+{
+    HBitmap *meta, *other;
+    int64_t start, count;
+
+    hbitmap_test_init(data, L3, 0);
+    meta = hbitmap_create_meta(data->hb, 64);
+    g_assert_cmpint(hbitmap_count(meta), ==, 0);
+
+    /* Setting one bit marks its whole chunk */
+    hbitmap_test_set(data, L2 + 1, 1);
+    g_assert(hbitmap_next_dirty_area(meta, 0, L3, INT64_MAX, &start, &count));
+    g_assert_cmpint(start, ==, L2);
+    g_assert_cmpint(count, ==, 64);
+
+    /* Setting an already set bit does not change anything */
+    hbitmap_reset_all(meta);
+    hbitmap_test_set(data, L2 + 1, 1);
+    g_assert_cmpint(hbitmap_count(meta), ==, 0);
+
+    hbitmap_test_reset(data, L2, 2);
+    g_assert_cmpint(hbitmap_count(meta), ==, 64);
+
+    /* Merging into an operand only marks the bits of the other one */
+    hbitmap_reset_all(meta);
+    other = hbitmap_alloc(L3, 0);
+    hbitmap_set(other, 3 * 64, 10);
+    hbitmap_merge(data->hb, other, data->hb);
+    g_assert(hbitmap_next_dirty_area(meta, 0, L3, INT64_MAX, &start, &count));
+    g_assert_cmpint(start, ==, 3 * 64);
+    g_assert_cmpint(count, ==, 64);
+    hbitmap_free(other);
+
+    hbitmap_reset_all(data->hb);
+    g_assert_cmpint(hbitmap_count(meta), ==, L3);
+
+    hbitmap_free_meta(data->hb);
+}
+
 static void hbitmap_test_add(const char *testpath,
                                    void (*test_func)(TestHBitmapData *data, const void *user_data))
 {
@@ -901,6 +941,33 @@ static void test_hbitmap_next_x_do(TestHBitmapData *data, int granularity)
     test_hbitmap_next_x_check(data, 0);
 }
 
+/* Compare every accelerated word scanning kernel against the shadow bitmap */
+static void test_hbitmap_next_x_accel(TestHBitmapData *data,
+                                      const void *unused)
+{
+    hbitmap_test_init(data, L3, 0);
+
+    do {
+        hbitmap_test_reset_all(data);
+
+        /* Dense runs that cross blocks of words, with holes in them */
+        hbitmap_test_set(data, 0, L2 + 3);
+        hbitmap_test_reset(data, L1 * 5 + 1, L1 * 2);
+        hbitmap_test_set(data, L2 * 2 + 7, L1 * 9);
+        hbitmap_test_set(data, L3 - L1 - 3, L1 + 3);
+        hbitmap_test_reset(data, L3 - 2, 1);
+
+        test_hbitmap_next_x_check(data, 0);
+        test_hbitmap_next_x_check(data, L1 * 5);
+        test_hbitmap_next_x_check(data, L1 * 7 + 1);
+        test_hbitmap_next_x_check(data, L2);
+        test_hbitmap_next_x_check(data, L2 * 2 + 7);
+        test_hbitmap_next_x_check(data, L3 - L1 - 3);
+        test_hbitmap_next_x_check_range(data, 1, L1 * 5);
+        test_hbitmap_next_x_check_range(data, L2 * 2 + 8, L1 * 8);
+    } while (test_hbitmap_next_accel());
+}
+
 static void test_hbitmap_next_x_0(TestHBitmapData *data, const void *unused)
 {
     test_hbitmap_next_x_do(data, 0);
@@ -1094,6 +1161,8 @@ int main(int argc, char **argv)
     hbitmap_test_add("/hbitmap/serialize/zeroes",
                      test_hbitmap_serialize_zeroes);
 
+    hbitmap_test_add("/hbitmap/meta", test_hbitmap_meta);
+
     hbitmap_test_add("/hbitmap/iter/iter_and_reset",
                      test_hbitmap_iter_and_reset);
 
@@ -1101,6 +1170,8 @@ int main(int argc, char **argv)
                      test_hbitmap_next_x_0);
     hbitmap_test_add("/hbitmap/next_zero/next_x_4",
                      test_hbitmap_next_x_4);
+    hbitmap_test_add("/hbitmap/next_zero/next_x_accel",
+                     test_hbitmap_next_x_accel);
     hbitmap_test_add("/hbitmap/next_zero/next_x_after_truncate",
                      test_hbitmap_next_x_after_truncate);
 
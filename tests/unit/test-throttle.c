@@ -671,6 +671,110 @@ static void test_accounting(void)
                                 (64.0 / 13)));
 }
 
+/* credits must account exactly what was spent and never overfill a bucket */
+static void test_credit_accuracy(void)
+{
+    ThrottleConfig cfg;
+    ThrottleState ts1, ts2;
+    ThrottleCredit credit = { 0 };
+    ThrottleCredit more[3] = { 0 };
+    int64_t now;
+    int i;
+
+    throttle_config_init(&cfg);
+    cfg.buckets[THROTTLE_OPS_TOTAL].avg = 100;
+    cfg.buckets[THROTTLE_BPS_TOTAL].avg = 1000000;
+
+    throttle_init(&ts1);
+    throttle_config(&ts1, QEMU_CLOCK_VIRTUAL, &cfg);
+    throttle_init(&ts2);
+    throttle_config(&ts2, QEMU_CLOCK_VIRTUAL, &cfg);
+    now = ts1.previous_leak;
+
+    /* half of each bucket is reserved for a single user */
+    g_assert(throttle_credit_reserve(&ts1, &credit, now, 1));
+    g_assert(double_cmp(ts1.cfg.buckets[THROTTLE_OPS_TOTAL].level, 5));
+    g_assert(double_cmp(ts1.cfg.buckets[THROTTLE_BPS_TOTAL].level, 50000));
+    g_assert(double_cmp(credit.units[THROTTLE_OPS_TOTAL], 5));
+    g_assert(double_cmp(credit.units[THROTTLE_BPS_TOTAL], 50000));
+
+    /* a request larger than the credit is not accounted at all */
+    g_assert(!throttle_credit_consume(&credit, false, 64 * 1024));
+    g_assert(double_cmp(credit.units[THROTTLE_OPS_TOTAL], 5));
+
+    for (i = 0; i < 3; i++) {
+        g_assert(throttle_credit_consume(&credit, i & 1, 4096));
+        throttle_account(&ts2, i & 1, 4096);
+    }
+
+    /* what was not spent goes back to the bucket */
+    throttle_credit_release(&ts1, &credit);
+    g_assert(!credit.limited);
+    g_assert(!throttle_credit_consume(&credit, false, 512));
+    for (i = 0; i < BUCKETS_COUNT; i++) {
+        if (cfg.buckets[i].avg) {
+            g_assert(double_cmp(ts1.cfg.buckets[i].level,
+                                ts2.cfg.buckets[i].level));
+        }
+    }
+
+    /* reservations stop once the bucket is full */
+    for (i = 0; i < ARRAY_SIZE(more); i++) {
+        if (!throttle_credit_reserve(&ts1, &more[i], now, 1)) {
+            break;
+        }
+    }
+    g_assert_cmpint(i, ==, 2);
+    g_assert(ts1.cfg.buckets[THROTTLE_OPS_TOTAL].level <= 10);
+    g_assert(!throttle_must_wait(&ts1, QEMU_CLOCK_VIRTUAL, false));
+
+    /* without limits there is nothing to reserve */
+    throttle_init(&ts2);
+    g_assert(!throttle_credit_reserve(&ts2, &credit, now, 1));
+}
+
+/* all users sharing a throttle state get the same credit */
+static void test_credit_fairness(void)
+{
+    ThrottleConfig cfg;
+    ThrottleState ts;
+    ThrottleCredit credit[4] = { 0 };
+    int64_t now;
+    int i, n, spent = 0;
+
+    throttle_config_init(&cfg);
+    cfg.buckets[THROTTLE_OPS_READ].avg = 1000;
+    cfg.buckets[THROTTLE_OPS_WRITE].avg = 1000;
+
+    throttle_init(&ts);
+    throttle_config(&ts, QEMU_CLOCK_VIRTUAL, &cfg);
+    now = ts.previous_leak;
+
+    for (i = 0; i < ARRAY_SIZE(credit); i++) {
+        g_assert(throttle_credit_reserve(&ts, &credit[i], now,
+                                         ARRAY_SIZE(credit)));
+        g_assert(double_cmp(credit[i].units[THROTTLE_OPS_READ], 12.5));
+    }
+
+    /* half of the bucket is left to requests accounted under the lock */
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_OPS_READ].level, 50));
+
+    for (i = 0; i < ARRAY_SIZE(credit); i++) {
+        for (n = 0; throttle_credit_consume(&credit[i], false, 4096); n++) {
+            /* reads don't touch the write credit */
+            g_assert(double_cmp(credit[i].units[THROTTLE_OPS_WRITE], 12.5));
+        }
+        g_assert_cmpint(n, ==, 12);
+        spent += n;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(credit); i++) {
+        throttle_credit_release(&ts, &credit[i]);
+    }
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_OPS_READ].level, spent));
+    g_assert(double_cmp(ts.cfg.buckets[THROTTLE_OPS_WRITE].level, 0));
+}
+
 static void test_groups(void)
 {
     ThrottleConfig cfg1, cfg2;
@@ -764,6 +868,8 @@ int main(int argc, char **argv)
                     test_iops_size_is_missing_limit);
     g_test_add_func("/throttle/config_functions",   test_config_functions);
     g_test_add_func("/throttle/accounting",         test_accounting);
+    g_test_add_func("/throttle/credit/accuracy",    test_credit_accuracy);
+    g_test_add_func("/throttle/credit/fairness",    test_credit_fairness);
     g_test_add_func("/throttle/groups",             test_groups);
     return g_test_run();
 }
@@ -35,6 +35,7 @@
 
 #define INDIRECTION_TABLE_SIZE 128
 #define HASH_CALCULATION_BUFFER_SIZE 36
+#define FLOW_TABLE_SIZE 1024
 
 struct rss_config_t {
     __u8 redirect;
@@ -97,6 +98,23 @@ struct {
     __uint(max_entries, INDIRECTION_TABLE_SIZE);
 } tap_rss_map_indirection_table SEC(".maps");
 
+struct flow_key_t {
+    __u8 src[16];
+    __u8 dst[16];
+    __be16 src_port;
+    __be16 dst_port;
+    __u8 ip_proto;
+    __u8 is_ipv6;
+    __u16 reserved;
+} __attribute__((packed));
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(key_size, sizeof(struct flow_key_t));
+    __uint(value_size, sizeof(__u16));
+    __uint(max_entries, FLOW_TABLE_SIZE);
+} tap_rss_map_flow_table SEC(".maps");
+
 static inline void net_rx_rss_add_chunk(__u8 *rss_input, size_t *bytes_written,
                                         const void *ptr, size_t size) {
     __builtin_memcpy(&rss_input[*bytes_written], ptr, size);
@@ -377,146 +395,139 @@ error:
     return err;
 }
 
-static inline __u32 calculate_rss_hash(struct __sk_buff *skb,
+static inline __u32 calculate_rss_hash(struct packet_hash_info_t *packet_info,
         struct rss_config_t *config, struct toeplitz_key_data_t *toe)
 {
     __u8 rss_input[HASH_CALCULATION_BUFFER_SIZE] = {};
     size_t bytes_written = 0;
     __u32 result = 0;
-    int err = 0;
-    struct packet_hash_info_t packet_info = {};
 
-    err = parse_packet(skb, &packet_info);
-    if (err) {
-        return 0;
-    }
-
-    if (packet_info.is_ipv4) {
-        if (packet_info.is_tcp &&
+    if (packet_info->is_ipv4) {
+        if (packet_info->is_tcp &&
             config->hash_types & VIRTIO_NET_RSS_HASH_TYPE_TCPv4) {
 
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.in_src,
-                                 sizeof(packet_info.in_src));
+                                 &packet_info->in_src,
+                                 sizeof(packet_info->in_src));
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.in_dst,
-                                 sizeof(packet_info.in_dst));
+                                 &packet_info->in_dst,
+                                 sizeof(packet_info->in_dst));
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.src_port,
-                                 sizeof(packet_info.src_port));
+                                 &packet_info->src_port,
+                                 sizeof(packet_info->src_port));
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.dst_port,
-                                 sizeof(packet_info.dst_port));
-        } else if (packet_info.is_udp &&
+                                 &packet_info->dst_port,
+                                 sizeof(packet_info->dst_port));
+        } else if (packet_info->is_udp &&
                    config->hash_types & VIRTIO_NET_RSS_HASH_TYPE_UDPv4) {
 
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.in_src,
-                                 sizeof(packet_info.in_src));
+                                 &packet_info->in_src,
+                                 sizeof(packet_info->in_src));
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.in_dst,
-                                 sizeof(packet_info.in_dst));
+                                 &packet_info->in_dst,
+                                 sizeof(packet_info->in_dst));
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.src_port,
-                                 sizeof(packet_info.src_port));
+                                 &packet_info->src_port,
+                                 sizeof(packet_info->src_port));
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.dst_port,
-                                 sizeof(packet_info.dst_port));
+                                 &packet_info->dst_port,
+                                 sizeof(packet_info->dst_port));
         } else if (config->hash_types & VIRTIO_NET_RSS_HASH_TYPE_IPv4) {
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.in_src,
-                                 sizeof(packet_info.in_src));
+                                 &packet_info->in_src,
+                                 sizeof(packet_info->in_src));
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.in_dst,
-                                 sizeof(packet_info.in_dst));
+                                 &packet_info->in_dst,
+                                 sizeof(packet_info->in_dst));
         }
-    } else if (packet_info.is_ipv6) {
-        if (packet_info.is_tcp &&
+    } else if (packet_info->is_ipv6) {
+        if (packet_info->is_tcp &&
             config->hash_types & VIRTIO_NET_RSS_HASH_TYPE_TCPv6) {
 
-            if (packet_info.is_ipv6_ext_src &&
+            if (packet_info->is_ipv6_ext_src &&
                 config->hash_types & VIRTIO_NET_RSS_HASH_TYPE_TCP_EX) {
 
                 net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                     &packet_info.in6_ext_src,
-                                     sizeof(packet_info.in6_ext_src));
+                                     &packet_info->in6_ext_src,
+                                     sizeof(packet_info->in6_ext_src));
             } else {
                 net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                     &packet_info.in6_src,
-                                     sizeof(packet_info.in6_src));
+                                     &packet_info->in6_src,
+                                     sizeof(packet_info->in6_src));
             }
-            if (packet_info.is_ipv6_ext_dst &&
+            if (packet_info->is_ipv6_ext_dst &&
                 config->hash_types & VIRTIO_NET_RSS_HASH_TYPE_TCP_EX) {
 
                 net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                     &packet_info.in6_ext_dst,
-                                     sizeof(packet_info.in6_ext_dst));
+                                     &packet_info->in6_ext_dst,
+                                     sizeof(packet_info->in6_ext_dst));
             } else {
                 net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                     &packet_info.in6_dst,
-                                     sizeof(packet_info.in6_dst));
+                                     &packet_info->in6_dst,
+                                     sizeof(packet_info->in6_dst));
             }
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.src_port,
-                                 sizeof(packet_info.src_port));
+                                 &packet_info->src_port,
+                                 sizeof(packet_info->src_port));
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.dst_port,
-                                 sizeof(packet_info.dst_port));
-        } else if (packet_info.is_udp &&
+                                 &packet_info->dst_port,
+                                 sizeof(packet_info->dst_port));
+        } else if (packet_info->is_udp &&
                    config->hash_types & VIRTIO_NET_RSS_HASH_TYPE_UDPv6) {
 
-            if (packet_info.is_ipv6_ext_src &&
+            if (packet_info->is_ipv6_ext_src &&
                config->hash_types & VIRTIO_NET_RSS_HASH_TYPE_UDP_EX) {
 
                 net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                     &packet_info.in6_ext_src,
-                                     sizeof(packet_info.in6_ext_src));
+                                     &packet_info->in6_ext_src,
+                                     sizeof(packet_info->in6_ext_src));
             } else {
                 net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                     &packet_info.in6_src,
-                                     sizeof(packet_info.in6_src));
+                                     &packet_info->in6_src,
+                                     sizeof(packet_info->in6_src));
             }
-            if (packet_info.is_ipv6_ext_dst &&
+            if (packet_info->is_ipv6_ext_dst &&
                config->hash_types & VIRTIO_NET_RSS_HASH_TYPE_UDP_EX) {
 
                 net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                     &packet_info.in6_ext_dst,
-                                     sizeof(packet_info.in6_ext_dst));
+                                     &packet_info->in6_ext_dst,
+                                     sizeof(packet_info->in6_ext_dst));
             } else {
                 net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                     &packet_info.in6_dst,
-                                     sizeof(packet_info.in6_dst));
+                                     &packet_info->in6_dst,
+                                     sizeof(packet_info->in6_dst));
             }
 
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.src_port,
-                                 sizeof(packet_info.src_port));
+                                 &packet_info->src_port,
+                                 sizeof(packet_info->src_port));
             net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                 &packet_info.dst_port,
-                                 sizeof(packet_info.dst_port));
+                                 &packet_info->dst_port,
+                                 sizeof(packet_info->dst_port));
 
         } else if (config->hash_types & VIRTIO_NET_RSS_HASH_TYPE_IPv6) {
-            if (packet_info.is_ipv6_ext_src &&
+            if (packet_info->is_ipv6_ext_src &&
                config->hash_types & VIRTIO_NET_RSS_HASH_TYPE_IP_EX) {
 
                 net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                     &packet_info.in6_ext_src,
-                                     sizeof(packet_info.in6_ext_src));
+                                     &packet_info->in6_ext_src,
+                                     sizeof(packet_info->in6_ext_src));
             } else {
                 net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                     &packet_info.in6_src,
-                                     sizeof(packet_info.in6_src));
+                                     &packet_info->in6_src,
+                                     sizeof(packet_info->in6_src));
             }
-            if (packet_info.is_ipv6_ext_dst &&
+            if (packet_info->is_ipv6_ext_dst &&
                 config->hash_types & VIRTIO_NET_RSS_HASH_TYPE_IP_EX) {
 
                 net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                     &packet_info.in6_ext_dst,
-                                     sizeof(packet_info.in6_ext_dst));
+                                     &packet_info->in6_ext_dst,
+                                     sizeof(packet_info->in6_ext_dst));
             } else {
                 net_rx_rss_add_chunk(rss_input, &bytes_written,
-                                     &packet_info.in6_dst,
-                                     sizeof(packet_info.in6_dst));
+                                     &packet_info->in6_dst,
+                                     sizeof(packet_info->in6_dst));
             }
         }
     }
@@ -528,6 +539,41 @@ static inline __u32 calculate_rss_hash(struct __sk_buff *skb,
     return result;
 }
 
+static inline int lookup_flow(struct packet_hash_info_t *packet_info,
+                               __u16 *queue)
+{
+    struct flow_key_t key = {};
+    __u16 *value;
+
+    if (!packet_info->is_tcp && !packet_info->is_udp) {
+        return 0;
+    }
+
+    if (packet_info->is_ipv4) {
+        __builtin_memcpy(key.src, &packet_info->in_src,
+                         sizeof(packet_info->in_src));
+        __builtin_memcpy(key.dst, &packet_info->in_dst,
+                         sizeof(packet_info->in_dst));
+    } else {
+        __builtin_memcpy(key.src, &packet_info->in6_src,
+                         sizeof(packet_info->in6_src));
+        __builtin_memcpy(key.dst, &packet_info->in6_dst,
+                         sizeof(packet_info->in6_dst));
+        key.is_ipv6 = 1;
+    }
+    key.src_port = packet_info->src_port;
+    key.dst_port = packet_info->dst_port;
+    key.ip_proto = packet_info->is_tcp ? IPPROTO_TCP : IPPROTO_UDP;
+
+    value = bpf_map_lookup_elem(&tap_rss_map_flow_table, &key);
+    if (!value) {
+        return 0;
+    }
+
+    *queue = *value;
+    return 1;
+}
+
 SEC("tun_rss_steering")
 int tun_rss_steering_prog(struct __sk_buff *skb)
 {
@@ -542,11 +588,23 @@ int tun_rss_steering_prog(struct __sk_buff *skb)
     toe = bpf_map_lookup_elem(&tap_rss_map_toeplitz_key, &key);
 
     if (config && toe) {
+        struct packet_hash_info_t packet_info = {};
+        __u16 flow_queue;
+
         if (!config->redirect) {
             return config->default_queue;
         }
 
-        hash = calculate_rss_hash(skb, config, toe);
+        if (parse_packet(skb, &packet_info)) {
+            return config->default_queue;
+        }
+
+        /* Flows steered by the guest take precedence over the hash. */
+        if (lookup_flow(&packet_info, &flow_queue)) {
+            return flow_queue;
+        }
+
+        hash = calculate_rss_hash(&packet_info, config, toe);
         if (hash) {
             __u32 table_idx = hash % config->indirections_len;
             __u16 *queue = 0;
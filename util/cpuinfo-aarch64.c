@@ -13,6 +13,12 @@
 #  include <asm/hwcap.h>
 #  include "elf.h"
 # endif
+# ifndef AT_HWCAP2
+#  define AT_HWCAP2 26
+# endif
+# ifndef HWCAP2_SVE2
+#  define HWCAP2_SVE2 (1 << 1)
+# endif
 #endif
 #ifdef CONFIG_DARWIN
 # include <sys/sysctl.h>
@@ -57,6 +63,9 @@ unsigned __attribute__((constructor)) cpuinfo_init(void)
     info |= (hwcap & HWCAP_ATOMICS ? CPUINFO_LSE : 0);
     info |= (hwcap & HWCAP_USCAT ? CPUINFO_LSE2 : 0);
     info |= (hwcap & HWCAP_AES ? CPUINFO_AES: 0);
+
+    unsigned long hwcap2 = qemu_getauxval(AT_HWCAP2);
+    info |= (hwcap2 & HWCAP2_SVE2 ? CPUINFO_SVE2 : 0);
 #endif
 #ifdef CONFIG_DARWIN
     info |= sysctl_for_bool("hw.optional.arm.FEAT_LSE") * CPUINFO_LSE;
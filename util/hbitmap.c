@@ -101,6 +101,157 @@ struct HBitmap {
     uint64_t sizes[HBITMAP_LEVELS];
 };
 
+/*
+ * Word scanning kernels.  hbitmap_next_zero and hb_count_between have to
+ * look at every word of the last level in the range they are given, so
+ * they are the only place where vector instructions pay off.  The search
+ * for set bits already skips empty words through the upper levels.
+ */
+
+/* Return the index of the first word in [pos, end) that is not all ones. */
+static size_t hb_find_not_ones_int(const unsigned long *words,
+                                   size_t pos, size_t end)
+{
+    while (pos < end && words[pos] == (unsigned long)-1) {
+        pos++;
+    }
+    return pos;
+}
+
+/* Return the number of bits set in the @n words at @words. */
+static uint64_t hb_popcount_int(const unsigned long *words, size_t n)
+{
+    uint64_t count = 0;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        count += ctpopl(words[i]);
+    }
+    return count;
+}
+
+#ifdef CONFIG_AVX2_OPT
+#include <immintrin.h>
+#include "host/cpuinfo.h"
+
+#define HB_WORDS_PER_VEC (sizeof(__m256i) / sizeof(unsigned long))
+
+static uint64_t __attribute__((target("popcnt")))
+hb_popcount_popcnt(const unsigned long *words, size_t n)
+{
+    uint64_t count = 0;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        count += __builtin_popcountl(words[i]);
+    }
+    return count;
+}
+
+static size_t __attribute__((target("avx2")))
+hb_find_not_ones_avx2(const unsigned long *words, size_t pos, size_t end)
+{
+    const __m256i ones = _mm256_set1_epi8(-1);
+
+    /* Check two vectors at a time, then locate the word with scalar code. */
+    while (pos + 2 * HB_WORDS_PER_VEC <= end) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)&words[pos]);
+        __m256i b = _mm256_loadu_si256((const __m256i *)
+                                       &words[pos + HB_WORDS_PER_VEC]);
+
+        if (!_mm256_testc_si256(_mm256_and_si256(a, b), ones)) {
+            break;
+        }
+        pos += 2 * HB_WORDS_PER_VEC;
+    }
+    return hb_find_not_ones_int(words, pos, end);
+}
+
+static uint64_t __attribute__((target("avx2")))
+hb_popcount_avx2(const unsigned long *words, size_t n)
+{
+    /* Nibble lookup table, summed per 64-bit lane with VPSADBW */
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                         1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3,
+                                         1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    uint64_t lanes[4];
+    size_t i;
+
+    for (i = 0; i + HB_WORDS_PER_VEC <= n; i += HB_WORDS_PER_VEC) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)&words[i]);
+        __m256i lo = _mm256_and_si256(v, low_mask);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+        __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo),
+                                      _mm256_shuffle_epi8(lut, hi));
+
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt,
+                                                    _mm256_setzero_si256()));
+    }
+
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           hb_popcount_popcnt(words + i, n - i);
+}
+
+static unsigned used_accel;
+static size_t (*hb_find_not_ones)(const unsigned long *, size_t, size_t) =
+    hb_find_not_ones_int;
+static uint64_t (*hb_popcount)(const unsigned long *, size_t) =
+    hb_popcount_int;
+
+static unsigned __attribute__((noinline))
+select_accel_cpuinfo(unsigned info)
+{
+    /* Array is sorted in order of algorithm preference. */
+    static const struct {
+        unsigned bit;
+        size_t (*find_not_ones)(const unsigned long *, size_t, size_t);
+        uint64_t (*popcount)(const unsigned long *, size_t);
+    } all[] = {
+        { CPUINFO_AVX2,   hb_find_not_ones_avx2, hb_popcount_avx2 },
+        { CPUINFO_POPCNT, hb_find_not_ones_int,  hb_popcount_popcnt },
+        { CPUINFO_ALWAYS, hb_find_not_ones_int,  hb_popcount_int },
+    };
+
+    for (unsigned i = 0; i < ARRAY_SIZE(all); ++i) {
+        if (info & all[i].bit) {
+            hb_find_not_ones = all[i].find_not_ones;
+            hb_popcount = all[i].popcount;
+            return all[i].bit;
+        }
+    }
+    return 0;
+}
+
+static void __attribute__((constructor)) init_accel(void)
+{
+    used_accel = select_accel_cpuinfo(cpuinfo_init());
+}
+
+bool test_hbitmap_next_accel(void)
+{
+    /*
+     * Accumulate the accelerators that we've already tested, and
+     * remove them from the set to test this round.  We'll get back
+     * a zero from select_accel_cpuinfo when there are no more.
+     */
+    unsigned used = select_accel_cpuinfo(cpuinfo & ~used_accel);
+    used_accel |= used;
+    return used;
+}
+#else
+#define hb_find_not_ones hb_find_not_ones_int
+#define hb_popcount      hb_popcount_int
+
+bool test_hbitmap_next_accel(void)
+{
+    return false;
+}
+#endif /* CONFIG_AVX2_OPT */
+
 /* Advance hbi to the next nonzero word and return it.  hbi->pos
  * is updated.  Returns zero if we reach the end of the bitmap.
  */
@@ -245,10 +396,7 @@ int64_t hbitmap_next_zero(const HBitmap *hb, int64_t start, int64_t count)
     assert((start >> hb->granularity) < hb->size);
 
     if (cur == (unsigned long)-1) {
-        do {
-            pos++;
-        } while (pos < sz && last_lev[pos] == (unsigned long)-1);
-
+        pos = hb_find_not_ones(last_lev, pos + 1, sz);
         if (pos >= sz) {
             return -1;
         }
@@ -349,60 +497,34 @@ uint64_t hbitmap_count(const HBitmap *hb)
     return hb->count << hb->granularity;
 }
 
-/**
- * hbitmap_iter_next_word:
- * @hbi: HBitmapIter to operate on.
- * @p_cur: Location where to store the next non-zero word.
- *
- * Return the index of the next nonzero word that is set in @hbi's
- * associated HBitmap, and set *p_cur to the content of that word
- * (bits before the index that was passed to hbitmap_iter_init are
- * trimmed on the first call).  Return -1, and set *p_cur to zero,
- * if all remaining words are zero.
+/* Count the number of set bits between start and last, not accounting for
+ * the granularity.  Blocks of words that the 2nd-last level reports as
+ * empty are skipped, the others are counted a block at a time.
  */
-static size_t hbitmap_iter_next_word(HBitmapIter *hbi, unsigned long *p_cur)
+static uint64_t hb_count_between(HBitmap *hb, uint64_t start, uint64_t last)
 {
-    unsigned long cur = hbi->cur[HBITMAP_LEVELS - 1];
+    const unsigned long *lev = hb->levels[HBITMAP_LEVELS - 1];
+    const unsigned long *up = hb->levels[HBITMAP_LEVELS - 2];
+    size_t pos = start >> BITS_PER_LEVEL;
+    size_t lastpos = last >> BITS_PER_LEVEL;
+    unsigned long first_mask = ~0UL << (start & (BITS_PER_LONG - 1));
+    unsigned long last_mask =
+        ~0UL >> (BITS_PER_LONG - 1 - (last & (BITS_PER_LONG - 1)));
+    uint64_t count;
 
-    if (cur == 0) {
-        cur = hbitmap_iter_skip_words(hbi);
-        if (cur == 0) {
-            *p_cur = 0;
-            return -1;
-        }
+    if (pos == lastpos) {
+        return ctpopl(lev[pos] & first_mask & last_mask);
     }
 
-    /* The next call will resume work from the next word.  */
-    hbi->cur[HBITMAP_LEVELS - 1] = 0;
-    *p_cur = cur;
-    return hbi->pos;
-}
+    count = ctpopl(lev[pos] & first_mask) + ctpopl(lev[lastpos] & last_mask);
+    for (pos++; pos < lastpos; ) {
+        size_t blk = pos >> BITS_PER_LEVEL;
+        size_t blk_end = MIN((blk + 1) << BITS_PER_LEVEL, lastpos);
 
-/* Count the number of set bits between start and end, not accounting for
- * the granularity.  Also an example of how to use hbitmap_iter_next_word.
- */
-static uint64_t hb_count_between(HBitmap *hb, uint64_t start, uint64_t last)
-{
-    HBitmapIter hbi;
-    uint64_t count = 0;
-    uint64_t end = last + 1;
-    unsigned long cur;
-    size_t pos;
-
-    hbitmap_iter_init(&hbi, hb, start << hb->granularity);
-    for (;;) {
-        pos = hbitmap_iter_next_word(&hbi, &cur);
-        if (pos >= (end >> BITS_PER_LEVEL)) {
-            break;
+        if (up[blk]) {
+            count += hb_popcount(&lev[pos], blk_end - pos);
         }
-        count += ctpopl(cur);
-    }
-
-    if (pos == (end >> BITS_PER_LEVEL)) {
-        /* Drop bits representing the END-th and subsequent items.  */
-        int bit = end & (BITS_PER_LONG - 1);
-        cur &= (1UL << bit) - 1;
-        count += ctpopl(cur);
+        pos = blk_end;
     }
 
     return count;
@@ -594,6 +716,10 @@ void hbitmap_reset_all(HBitmap *hb)
 
     hb->levels[0][0] = 1UL << (BITS_PER_LONG - 1);
     hb->count = 0;
+
+    if (hb->meta) {
+        hbitmap_set(hb->meta, 0, hb->orig_size);
+    }
 }
 
 bool hbitmap_is_serializable(const HBitmap *hb)
@@ -791,6 +917,32 @@ void hbitmap_free(HBitmap *hb)
     g_free(hb);
 }
 
+HBitmap *hbitmap_create_meta(HBitmap *hb, int chunk_size)
+{
+    assert(is_power_of_2(chunk_size));
+    assert(!hb->meta);
+    hb->meta = hbitmap_alloc(hb->orig_size,
+                             hb->granularity + ctz32(chunk_size));
+    return hb->meta;
+}
+
+void hbitmap_free_meta(HBitmap *hb)
+{
+    assert(hb->meta);
+    hbitmap_free(hb->meta);
+    hb->meta = NULL;
+}
+
+void hbitmap_transfer_meta(HBitmap *dst, HBitmap *src)
+{
+    assert(!dst->meta);
+    dst->meta = src->meta;
+    src->meta = NULL;
+    if (dst->meta) {
+        hbitmap_set(dst->meta, 0, dst->orig_size);
+    }
+}
+
 HBitmap *hbitmap_alloc(uint64_t size, int granularity)
 {
     HBitmap *hb = g_new0(struct HBitmap, 1);
@@ -929,6 +1081,22 @@ void hbitmap_merge(const HBitmap *a, const HBitmap *b, HBitmap *result)
         return;
     }
 
+    if (result->meta) {
+        /* Only the bits of the other operand can change an aliased result */
+        const HBitmap *src = result == a ? b : result == b ? a : NULL;
+        int64_t start = 0, count;
+
+        if (src) {
+            while (hbitmap_next_dirty_area(src, start, src->orig_size,
+                                           INT64_MAX, &start, &count)) {
+                hbitmap_set(result->meta, start, count);
+                start += count;
+            }
+        } else {
+            hbitmap_set(result->meta, 0, result->orig_size);
+        }
+    }
+
     /* This merge is O(size), as BITS_PER_LONG and HBITMAP_LEVELS are constant.
      * It may be possible to improve running times for sparsely populated maps
      * by using hbitmap_iter_next, but this is suboptimal for dense maps.
@@ -31,62 +31,138 @@ enum {
     POOL_INITIAL_MAX_SIZE = 64,
 };
 
-/** Free list to speed up creation */
-static QSLIST_HEAD(, Coroutine) release_pool = QSLIST_HEAD_INITIALIZER(pool);
-static unsigned int pool_max_size = POOL_INITIAL_MAX_SIZE;
-static unsigned int release_pool_size;
+static const size_t coroutine_stack_sizes[COROUTINE_STACK__MAX] = {
+    [COROUTINE_STACK_DEFAULT] = COROUTINE_STACK_SIZE,
+    [COROUTINE_STACK_SMALL] = COROUTINE_SMALL_STACK_SIZE,
+};
 
 typedef QSLIST_HEAD(, Coroutine) CoroutineQSList;
-QEMU_DEFINE_STATIC_CO_TLS(CoroutineQSList, alloc_pool);
-QEMU_DEFINE_STATIC_CO_TLS(unsigned int, alloc_pool_size);
-QEMU_DEFINE_STATIC_CO_TLS(Notifier, coroutine_pool_cleanup_notifier);
+
+/** Free lists to speed up creation, one per stack size */
+static CoroutineQSList release_pool[COROUTINE_STACK__MAX];
+static unsigned int pool_max_size = POOL_INITIAL_MAX_SIZE;
+static unsigned int release_pool_size[COROUTINE_STACK__MAX];
+
+/*
+ * Only written by the owning thread, and read by
+ * qemu_coroutine_get_pool_stats() under pool_stats_lock.
+ */
+typedef struct CoroutinePoolCounters {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long frees;
+} CoroutinePoolCounters;
+
+typedef struct CoroutineThreadPool {
+    CoroutineQSList list[COROUTINE_STACK__MAX];
+    unsigned int size[COROUTINE_STACK__MAX];
+    CoroutinePoolCounters stats[COROUTINE_STACK__MAX];
+
+    /*
+     * Keep terminated coroutines in this thread, see
+     * qemu_coroutine_pool_set_thread_local()
+     */
+    bool local;
+
+    Notifier cleanup_notifier;
+    QLIST_ENTRY(CoroutineThreadPool) next;
+} CoroutineThreadPool;
+
+QEMU_DEFINE_STATIC_CO_TLS(CoroutineThreadPool, alloc_pool);
+
+/* Protects thread_pools and exited_stats */
+static QemuMutex pool_stats_lock;
+static QLIST_HEAD(, CoroutineThreadPool) thread_pools =
+    QLIST_HEAD_INITIALIZER(thread_pools);
+/* Counters of the threads that have already exited */
+static CoroutinePoolStats exited_stats[COROUTINE_STACK__MAX];
+
+static void __attribute__((__constructor__)) coroutine_pool_init(void)
+{
+    qemu_mutex_init(&pool_stats_lock);
+}
+
+static void coroutine_pool_stat_inc(unsigned long *counter)
+{
+    qatomic_set(counter, *counter + 1);
+}
 
 static void coroutine_pool_cleanup(Notifier *n, void *value)
 {
+    CoroutineThreadPool *pool = container_of(n, CoroutineThreadPool,
+                                             cleanup_notifier);
     Coroutine *co;
     Coroutine *tmp;
-    CoroutineQSList *alloc_pool = get_ptr_alloc_pool();
+    int i;
 
-    QSLIST_FOREACH_SAFE(co, alloc_pool, pool_next, tmp) {
-        QSLIST_REMOVE_HEAD(alloc_pool, pool_next);
-        qemu_coroutine_delete(co);
+    for (i = 0; i < COROUTINE_STACK__MAX; i++) {
+        QSLIST_FOREACH_SAFE(co, &pool->list[i], pool_next, tmp) {
+            QSLIST_REMOVE_HEAD(&pool->list[i], pool_next);
+            qemu_coroutine_delete(co);
+            pool->stats[i].frees++;
+        }
+        pool->size[i] = 0;
+    }
+
+    qemu_mutex_lock(&pool_stats_lock);
+    QLIST_REMOVE(pool, next);
+    for (i = 0; i < COROUTINE_STACK__MAX; i++) {
+        exited_stats[i].hits += pool->stats[i].hits;
+        exited_stats[i].misses += pool->stats[i].misses;
+        exited_stats[i].frees += pool->stats[i].frees;
     }
+    qemu_mutex_unlock(&pool_stats_lock);
 }
 
-Coroutine *qemu_coroutine_create(CoroutineEntry *entry, void *opaque)
+static CoroutineThreadPool *coroutine_get_thread_pool(void)
 {
+    CoroutineThreadPool *pool = get_ptr_alloc_pool();
+
+    /* Slow path; a good place to register the destructor, too.  */
+    if (unlikely(!pool->cleanup_notifier.notify)) {
+        pool->cleanup_notifier.notify = coroutine_pool_cleanup;
+        qemu_thread_atexit_add(&pool->cleanup_notifier);
+
+        qemu_mutex_lock(&pool_stats_lock);
+        QLIST_INSERT_HEAD(&thread_pools, pool, next);
+        qemu_mutex_unlock(&pool_stats_lock);
+    }
+    return pool;
+}
+
+static Coroutine *coroutine_create(CoroutineStackClass stack_class,
+                                   CoroutineEntry *entry, void *opaque)
+{
+    CoroutineThreadPool *pool = coroutine_get_thread_pool();
+    CoroutineQSList *alloc_pool = &pool->list[stack_class];
     Coroutine *co = NULL;
 
     if (CONFIG_COROUTINE_POOL) {
-        CoroutineQSList *alloc_pool = get_ptr_alloc_pool();
-
         co = QSLIST_FIRST(alloc_pool);
-        if (!co) {
-            if (release_pool_size > POOL_MIN_BATCH_SIZE) {
-                /* Slow path; a good place to register the destructor, too.  */
-                Notifier *notifier = get_ptr_coroutine_pool_cleanup_notifier();
-                if (!notifier->notify) {
-                    notifier->notify = coroutine_pool_cleanup;
-                    qemu_thread_atexit_add(notifier);
-                }
-
-                /* This is not exact; there could be a little skew between
-                 * release_pool_size and the actual size of release_pool.  But
-                 * it is just a heuristic, it does not need to be perfect.
-                 */
-                set_alloc_pool_size(qatomic_xchg(&release_pool_size, 0));
-                QSLIST_MOVE_ATOMIC(alloc_pool, &release_pool);
-                co = QSLIST_FIRST(alloc_pool);
-            }
+        if (!co && !pool->local &&
+            release_pool_size[stack_class] > POOL_MIN_BATCH_SIZE) {
+            /* This is not exact; there could be a little skew between
+             * release_pool_size and the actual size of release_pool.  But
+             * it is just a heuristic, it does not need to be perfect.
+             */
+            qatomic_set(&pool->size[stack_class],
+                        qatomic_xchg(&release_pool_size[stack_class], 0));
+            QSLIST_MOVE_ATOMIC(alloc_pool, &release_pool[stack_class]);
+            co = QSLIST_FIRST(alloc_pool);
         }
         if (co) {
             QSLIST_REMOVE_HEAD(alloc_pool, pool_next);
-            set_alloc_pool_size(get_alloc_pool_size() - 1);
+            qatomic_set(&pool->size[stack_class],
+                        pool->size[stack_class] - 1);
         }
     }
 
-    if (!co) {
-        co = qemu_coroutine_new();
+    if (co) {
+        coroutine_pool_stat_inc(&pool->stats[stack_class].hits);
+    } else {
+        co = qemu_coroutine_new(coroutine_stack_sizes[stack_class]);
+        co->stack_class = stack_class;
+        coroutine_pool_stat_inc(&pool->stats[stack_class].misses);
     }
 
     co->entry = entry;
@@ -95,24 +171,53 @@ Coroutine *qemu_coroutine_create(CoroutineEntry *entry, void *opaque)
     return co;
 }
 
+Coroutine *qemu_coroutine_create(CoroutineEntry *entry, void *opaque)
+{
+    return coroutine_create(COROUTINE_STACK_DEFAULT, entry, opaque);
+}
+
+Coroutine *qemu_coroutine_create_small(CoroutineEntry *entry, void *opaque)
+{
+    return coroutine_create(COROUTINE_STACK_SMALL, entry, opaque);
+}
+
+static bool coroutine_pool_put_local(CoroutineThreadPool *pool, Coroutine *co)
+{
+    CoroutineStackClass stack_class = co->stack_class;
+
+    if (pool->size[stack_class] < qatomic_read(&pool_max_size)) {
+        QSLIST_INSERT_HEAD(&pool->list[stack_class], co, pool_next);
+        qatomic_set(&pool->size[stack_class], pool->size[stack_class] + 1);
+        return true;
+    }
+    return false;
+}
+
 static void coroutine_delete(Coroutine *co)
 {
+    CoroutineThreadPool *pool = coroutine_get_thread_pool();
+    CoroutineStackClass stack_class = co->stack_class;
+
     co->caller = NULL;
 
     if (CONFIG_COROUTINE_POOL) {
-        if (release_pool_size < qatomic_read(&pool_max_size) * 2) {
-            QSLIST_INSERT_HEAD_ATOMIC(&release_pool, co, pool_next);
-            qatomic_inc(&release_pool_size);
+        if (pool->local && coroutine_pool_put_local(pool, co)) {
+            return;
+        }
+        if (release_pool_size[stack_class] <
+            qatomic_read(&pool_max_size) * 2) {
+            QSLIST_INSERT_HEAD_ATOMIC(&release_pool[stack_class], co,
+                                      pool_next);
+            qatomic_inc(&release_pool_size[stack_class]);
             return;
         }
-        if (get_alloc_pool_size() < qatomic_read(&pool_max_size)) {
-            QSLIST_INSERT_HEAD(get_ptr_alloc_pool(), co, pool_next);
-            set_alloc_pool_size(get_alloc_pool_size() + 1);
+        if (!pool->local && coroutine_pool_put_local(pool, co)) {
             return;
         }
     }
 
     qemu_coroutine_delete(co);
+    coroutine_pool_stat_inc(&pool->stats[stack_class].frees);
 }
 
 void qemu_aio_coroutine_enter(AioContext *ctx, Coroutine *co)
@@ -230,3 +335,29 @@ void qemu_coroutine_dec_pool_size(unsigned int removing_pool_size)
 {
     qatomic_sub(&pool_max_size, removing_pool_size);
 }
+
+void qemu_coroutine_pool_set_thread_local(void)
+{
+    coroutine_get_thread_pool()->local = true;
+}
+
+void qemu_coroutine_get_pool_stats(CoroutineStackClass stack_class,
+                                   CoroutinePoolStats *stats)
+{
+    CoroutineThreadPool *pool;
+
+    assert(stack_class < COROUTINE_STACK__MAX);
+
+    qemu_mutex_lock(&pool_stats_lock);
+    *stats = exited_stats[stack_class];
+    stats->pooled = qatomic_read(&release_pool_size[stack_class]);
+    QLIST_FOREACH(pool, &thread_pools, next) {
+        stats->hits += qatomic_read(&pool->stats[stack_class].hits);
+        stats->misses += qatomic_read(&pool->stats[stack_class].misses);
+        stats->frees += qatomic_read(&pool->stats[stack_class].frees);
+        stats->pooled += qatomic_read(&pool->size[stack_class]);
+    }
+    qemu_mutex_unlock(&pool_stats_lock);
+
+    stats->stack_size = coroutine_stack_sizes[stack_class];
+}
@@ -70,6 +70,7 @@
 #include "qemu/atomic.h"
 #include "qemu/rcu.h"
 #include "qemu/memalign.h"
+#include "qemu/host-utils.h"
 
 //#define QHT_DEBUG
 
@@ -79,15 +80,21 @@
  *
  * Note that systems with smaller cache lines will be fine (the struct is
  * almost 64-bytes); systems with larger cache lines might suffer from
- * some false sharing.
+ * some false sharing.  For the common hosts with 128-byte cache lines we
+ * use buckets of that size instead, which also halves the number of
+ * chained buckets walked on a lookup.
  */
+#if defined(_ARCH_PPC64) || (defined(__aarch64__) && defined(CONFIG_DARWIN))
+#define QHT_BUCKET_ALIGN 128
+#else
 #define QHT_BUCKET_ALIGN 64
+#endif
 
 /* define these to keep sizeof(qht_bucket) within QHT_BUCKET_ALIGN */
 #if HOST_LONG_BITS == 32
-#define QHT_BUCKET_ENTRIES 6
+#define QHT_BUCKET_ENTRIES (QHT_BUCKET_ALIGN == 128 ? 12 : 6)
 #else /* 64-bit */
-#define QHT_BUCKET_ENTRIES 4
+#define QHT_BUCKET_ENTRIES (QHT_BUCKET_ALIGN == 128 ? 8 : 4)
 #endif
 
 enum qht_iter_type {
@@ -552,26 +559,79 @@ bool qht_reset_size(struct qht *ht, size_t n_elems)
     return !!new;
 }
 
+/*
+ * Return a bitmask of the entries of @b whose hash equals @hash.
+ *
+ * Lookups run under the bucket's seqlock, so when the number of entries
+ * fits a host vector we compare all the hashes at once, after a single
+ * (not necessarily single-copy atomic) load.  A torn read of hashes[]
+ * is caught by seqlock_read_retry, exactly like a stale one.  TSAN would
+ * flag that load as a race, so keep the per-entry atomic reads there.
+ */
+#if (QHT_BUCKET_ENTRIES == 4 || QHT_BUCKET_ENTRIES == 8) && !defined(CONFIG_TSAN)
+typedef uint32_t qht_hashes_vec
+    __attribute__((vector_size(QHT_BUCKET_ENTRIES * sizeof(uint32_t))));
+typedef int32_t qht_match_vec
+    __attribute__((vector_size(QHT_BUCKET_ENTRIES * sizeof(int32_t))));
+
+static const qht_match_vec qht_match_bits = {
+    1 << 0, 1 << 1, 1 << 2, 1 << 3,
+#if QHT_BUCKET_ENTRIES == 8
+    1 << 4, 1 << 5, 1 << 6, 1 << 7,
+#endif
+};
+
+static inline unsigned int qht_bucket_match(const struct qht_bucket *b,
+                                            uint32_t hash)
+{
+    qht_hashes_vec v;
+    qht_match_vec m;
+    unsigned int mask = 0;
+    int i;
+
+    memcpy(&v, b->hashes, sizeof(v));
+    m = v == ((qht_hashes_vec){} + hash);
+    m &= qht_match_bits;
+    for (i = 0; i < QHT_BUCKET_ENTRIES; i++) {
+        mask |= m[i];
+    }
+    return mask;
+}
+#else
+static inline unsigned int qht_bucket_match(const struct qht_bucket *b,
+                                            uint32_t hash)
+{
+    unsigned int mask = 0;
+    int i;
+
+    for (i = 0; i < QHT_BUCKET_ENTRIES; i++) {
+        mask |= (qatomic_read(&b->hashes[i]) == hash) << i;
+    }
+    return mask;
+}
+#endif
+
 static inline
 void *qht_do_lookup(const struct qht_bucket *head, qht_lookup_func_t func,
                     const void *userp, uint32_t hash)
 {
     const struct qht_bucket *b = head;
-    int i;
 
     do {
-        for (i = 0; i < QHT_BUCKET_ENTRIES; i++) {
-            if (qatomic_read(&b->hashes[i]) == hash) {
-                /* The pointer is dereferenced before seqlock_read_retry,
-                 * so (unlike qht_insert__locked) we need to use
-                 * qatomic_rcu_read here.
-                 */
-                void *p = qatomic_rcu_read(&b->pointers[i]);
-
-                if (likely(p) && likely(func(p, userp))) {
-                    return p;
-                }
+        unsigned int mask = qht_bucket_match(b, hash);
+
+        while (mask) {
+            int i = ctz32(mask);
+            /* The pointer is dereferenced before seqlock_read_retry,
+             * so (unlike qht_insert__locked) we need to use
+             * qatomic_rcu_read here.
+             */
+            void *p = qatomic_rcu_read(&b->pointers[i]);
+
+            if (likely(p) && likely(func(p, userp))) {
+                return p;
             }
+            mask &= mask - 1;
         }
         b = qatomic_rcu_read(&b->next);
     } while (b);
@@ -87,6 +87,29 @@ static int64_t throttle_do_compute_wait(double limit, double extra)
     return wait;
 }
 
+/* compute the size of the buckets of a leaky bucket
+ *
+ * @bkt:               the leaky bucket we operate on
+ * @bucket_size:       I/O before throttling to bkt->avg
+ * @burst_bucket_size: I/O before throttling to bkt->max
+ */
+static void throttle_bucket_sizes(LeakyBucket *bkt, double *bucket_size,
+                                  double *burst_bucket_size)
+{
+    if (!bkt->max) {
+        /* If bkt->max is 0 we still want to allow short bursts of I/O
+         * from the guest, otherwise every other request will be throttled
+         * and performance will suffer considerably. */
+        *bucket_size = (double) bkt->avg / 10;
+        *burst_bucket_size = 0;
+    } else {
+        /* If we have a burst limit then we have to wait until all I/O
+         * at burst rate has finished before throttling to bkt->avg */
+        *bucket_size = bkt->max * bkt->burst_length;
+        *burst_bucket_size = (double) bkt->max / 10;
+    }
+}
+
 /* This function compute the wait time in ns that a leaky bucket should trigger
  *
  * @bkt: the leaky bucket we operate on
@@ -102,18 +125,7 @@ int64_t throttle_compute_wait(LeakyBucket *bkt)
         return 0;
     }
 
-    if (!bkt->max) {
-        /* If bkt->max is 0 we still want to allow short bursts of I/O
-         * from the guest, otherwise every other request will be throttled
-         * and performance will suffer considerably. */
-        bucket_size = (double) bkt->avg / 10;
-        burst_bucket_size = 0;
-    } else {
-        /* If we have a burst limit then we have to wait until all I/O
-         * at burst rate has finished before throttling to bkt->avg */
-        bucket_size = bkt->max * bkt->burst_length;
-        burst_bucket_size = (double) bkt->max / 10;
-    }
+    throttle_bucket_sizes(bkt, &bucket_size, &burst_bucket_size);
 
     /* If the main bucket is full then we have to wait */
     extra = bkt->level - bucket_size;
@@ -444,6 +456,49 @@ bool throttle_schedule_timer(ThrottleState *ts,
     return true;
 }
 
+/* Check whether the next request must wait, without arming any timer
+ *
+ * @clock_type: the clock used by the timers of this throttle state
+ * @is_write:   the type of operation (read/write)
+ * @ret:        true if the request would be throttled
+ */
+bool throttle_must_wait(ThrottleState *ts,
+                        QEMUClockType clock_type,
+                        bool is_write)
+{
+    int64_t next_timestamp;
+
+    return throttle_compute_timer(ts,
+                                  is_write,
+                                  qemu_clock_get_ns(clock_type),
+                                  &next_timestamp);
+}
+
+static const BucketType bucket_types_size[2][2] = {
+    { THROTTLE_BPS_TOTAL, THROTTLE_BPS_READ },
+    { THROTTLE_BPS_TOTAL, THROTTLE_BPS_WRITE }
+};
+static const BucketType bucket_types_units[2][2] = {
+    { THROTTLE_OPS_TOTAL, THROTTLE_OPS_READ },
+    { THROTTLE_OPS_TOTAL, THROTTLE_OPS_WRITE }
+};
+
+/* compute the number of operations that a request of a given size counts as
+ *
+ * @op_size: the size of an operation in bytes, or 0
+ * @size:    the size of the request
+ * @ret:     the number of operations
+ */
+static double throttle_size_to_units(uint64_t op_size, uint64_t size)
+{
+    /* if op_size is defined and smaller than size we compute unit count */
+    if (op_size && size > op_size) {
+        return (double) size / op_size;
+    }
+
+    return 1.0;
+}
+
 /* do the accounting for this operation
  *
  * @is_write: the type of operation (read/write)
@@ -451,22 +506,9 @@ bool throttle_schedule_timer(ThrottleState *ts,
  */
 void throttle_account(ThrottleState *ts, bool is_write, uint64_t size)
 {
-    const BucketType bucket_types_size[2][2] = {
-        { THROTTLE_BPS_TOTAL, THROTTLE_BPS_READ },
-        { THROTTLE_BPS_TOTAL, THROTTLE_BPS_WRITE }
-    };
-    const BucketType bucket_types_units[2][2] = {
-        { THROTTLE_OPS_TOTAL, THROTTLE_OPS_READ },
-        { THROTTLE_OPS_TOTAL, THROTTLE_OPS_WRITE }
-    };
-    double units = 1.0;
+    double units = throttle_size_to_units(ts->cfg.op_size, size);
     unsigned i;
 
-    /* if cfg.op_size is defined and smaller than size we compute unit count */
-    if (ts->cfg.op_size && size > ts->cfg.op_size) {
-        units = (double) size / ts->cfg.op_size;
-    }
-
     for (i = 0; i < 2; i++) {
         LeakyBucket *bkt;
 
@@ -484,6 +526,152 @@ void throttle_account(ThrottleState *ts, bool is_write, uint64_t size)
     }
 }
 
+/* Reserve a share of the units that can still be performed before
+ * throttling starts, and account them in advance.
+ *
+ * Each bucket hands out at most 1 / (2 * @shares) of its size, so that
+ * @shares users reserving at the same time get the same amount and half
+ * of the bucket is left for the requests that are not accounted through a
+ * ThrottleCredit.
+ *
+ * @credit: the credit to fill, which must be empty
+ * @now:    the current clock timestamp
+ * @shares: the number of users that may hold a credit at the same time
+ * @ret:    true if some credit has been reserved
+ */
+bool throttle_credit_reserve(ThrottleState *ts, ThrottleCredit *credit,
+                             int64_t now, unsigned shares)
+{
+    double grant[BUCKETS_COUNT];
+    unsigned limited = 0;
+    int i;
+
+    assert(!credit->limited);
+    assert(shares > 0);
+
+    /* leak proportionally to the time elapsed */
+    throttle_do_leak(ts, now);
+
+    for (i = 0; i < BUCKETS_COUNT; i++) {
+        LeakyBucket *bkt = &ts->cfg.buckets[i];
+        double bucket_size, burst_bucket_size, slice, room;
+
+        if (!bkt->avg) {
+            continue;
+        }
+
+        throttle_bucket_sizes(bkt, &bucket_size, &burst_bucket_size);
+        slice = bucket_size;
+        room = bucket_size - bkt->level;
+        if (bkt->burst_length > 1) {
+            slice = MIN(slice, burst_bucket_size);
+            room = MIN(room, burst_bucket_size - bkt->burst_level);
+        }
+
+        /* No request fits in less than one unit, don't bother */
+        grant[i] = MIN(slice / (2 * shares), room);
+        if (grant[i] < 1) {
+            return false;
+        }
+        limited |= 1U << i;
+    }
+
+    if (!limited) {
+        return false;
+    }
+
+    for (i = 0; i < BUCKETS_COUNT; i++) {
+        LeakyBucket *bkt = &ts->cfg.buckets[i];
+
+        if (limited & (1U << i)) {
+            bkt->level += grant[i];
+            if (bkt->burst_length > 1) {
+                bkt->burst_level += grant[i];
+            }
+            credit->units[i] = grant[i];
+        }
+    }
+    credit->limited = limited;
+    credit->op_size = ts->cfg.op_size;
+
+    return true;
+}
+
+static bool throttle_credit_covers(ThrottleCredit *credit, BucketType type,
+                                   double amount)
+{
+    return !(credit->limited & (1U << type)) || credit->units[type] >= amount;
+}
+
+static void throttle_credit_take(ThrottleCredit *credit, BucketType type,
+                                 double amount)
+{
+    if (credit->limited & (1U << type)) {
+        credit->units[type] -= amount;
+    }
+}
+
+/* Account an operation against a credit that was reserved before.
+ * The ThrottleState is not touched, so this doesn't need the lock that
+ * protects it.
+ *
+ * @is_write: the type of operation (read/write)
+ * @size:     the size of the operation
+ * @ret:      false if the credit is not enough for this operation, in
+ *            which case nothing is accounted
+ */
+bool throttle_credit_consume(ThrottleCredit *credit, bool is_write,
+                             uint64_t size)
+{
+    double units;
+    unsigned i;
+
+    if (!credit->limited) {
+        return false;
+    }
+
+    units = throttle_size_to_units(credit->op_size, size);
+
+    for (i = 0; i < 2; i++) {
+        if (!throttle_credit_covers(credit, bucket_types_size[is_write][i],
+                                    size) ||
+            !throttle_credit_covers(credit, bucket_types_units[is_write][i],
+                                    units)) {
+            return false;
+        }
+    }
+
+    for (i = 0; i < 2; i++) {
+        throttle_credit_take(credit, bucket_types_size[is_write][i], size);
+        throttle_credit_take(credit, bucket_types_units[is_write][i], units);
+    }
+
+    return true;
+}
+
+/* Give the unused part of a credit back to the buckets it was reserved
+ * from, and leave the credit empty.
+ *
+ * @credit: the credit to return
+ */
+void throttle_credit_release(ThrottleState *ts, ThrottleCredit *credit)
+{
+    int i;
+
+    for (i = 0; i < BUCKETS_COUNT; i++) {
+        LeakyBucket *bkt = &ts->cfg.buckets[i];
+
+        if (credit->limited & (1U << i)) {
+            bkt->level = MAX(bkt->level - credit->units[i], 0);
+            if (bkt->burst_length > 1) {
+                bkt->burst_level = MAX(bkt->burst_level - credit->units[i], 0);
+            }
+        }
+    }
+
+    memset(credit, 0, sizeof(*credit));
+}
+
 /* return a ThrottleConfig based on the options in a ThrottleLimits
  *
  * @arg:    the ThrottleLimits object to read from